@@ -0,0 +1,93 @@
+#include <rhd_batch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-r] [-s] [-c n_ch] [-f fs] [-b fl:fh] [-t n_taps] "
+          "[-w feat_win] [-l chunk_len] [-j n_threads] in out\n"
+          "  -r  raw RHD2164 DDR transfers instead of frames\n"
+          "  -s  offset binary samples instead of two's complement\n",
+          name);
+}
+
+// Reprocess a recording: decode, convert to uV, band-pass and optionally
+// reduce to RMS features, on every core
+int main(int argc, char **argv) {
+  rhd_batch_cfg_t cfg;
+  rhd_batch_default_cfg(&cfg);
+  float fs = 2000, fl = 0, fh = 0;
+  int n_taps = 101;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "rsc:f:b:t:w:l:j:")) != -1) {
+    switch (opt) {
+    case 'r':
+      cfg.input = RHD_BATCH_RAW;
+      break;
+    case 's':
+      cfg.twos_comp = false;
+      break;
+    case 'c':
+      cfg.n_ch = atoi(optarg);
+      break;
+    case 'f':
+      fs = atof(optarg);
+      break;
+    case 'b':
+      if (sscanf(optarg, "%f:%f", &fl, &fh) != 2) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 't':
+      n_taps = atoi(optarg);
+      break;
+    case 'w':
+      cfg.feat_win = atoi(optarg);
+      break;
+    case 'l':
+      cfg.chunk_len = atoi(optarg);
+      break;
+    case 'j':
+      cfg.n_threads = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - optind != 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  float taps[RHD_BATCH_MAX_TAPS];
+  if (fh > 0) {
+    if (rhd_batch_fir_bandpass(taps, n_taps, fs, fl, fh) != 0) {
+      fprintf(stderr, "invalid filter\n");
+      return 1;
+    }
+    cfg.taps = taps;
+    cfg.n_taps = n_taps;
+  }
+
+  struct timespec t0, t1;
+  rhd_batch_stats_t stats;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  if (rhd_batch_file(&cfg, argv[optind], argv[optind + 1], &stats) != 0) {
+    perror("rhd_batch_file");
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  double dt = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+  printf("%llu frames -> %llu rows of %zu ch, %u chunks (%u stolen) on %d "
+         "threads in %.3f s, %.1f Mframes/s\n",
+         (unsigned long long)stats.n_frames, (unsigned long long)stats.n_out,
+         stats.n_ch, stats.n_chunks, stats.n_stolen, stats.n_threads, dt,
+         stats.n_frames / dt * 1e-6);
+  return 0;
+}
@@ -0,0 +1,48 @@
+#include <rhd.h>
+#include <rhd_sim.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static rhd_sim_t sim;
+static FILE *out;
+
+// Simulated RHD2164 whose received words are appended to the recording, as
+// a raw logger would do on a real rig
+static int record_rw(uint16_t *tx_buf, uint16_t *rx_buf, size_t len) {
+  int ret = rhd_sim_xfer(&sim, tx_buf, rx_buf, len);
+  fwrite(rx_buf, sizeof(uint16_t), len, out);
+  return ret;
+}
+
+static uint16_t noise(void *ctx, int ch) {
+  return 0x8000 + (rand() % 2001) - 1000 + 200 * ch;
+}
+
+// Record raw DDR transfers of a simulated RHD2164 for the batch tool
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "build/session.raw";
+  int n_frames = argc > 2 ? atoi(argv[2]) : 200000;
+
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_set_signal(&sim, noise, NULL);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, true, rhd_sim_rw);
+  rhd_setup(&dev, 2000, 20, 500, false, 0);
+
+  out = fopen(path, "wb");
+  if (out == NULL) {
+    perror("fopen");
+    return 1;
+  }
+  dev.rw = record_rw;
+  uint16_t buf[64];
+  for (int i = 0; i < n_frames; i++) {
+    rhd_sample_all(&dev, buf);
+  }
+  fclose(out);
+
+  printf("%d frames (%d words each) recorded to %s\n", n_frames,
+         dev.engine->n_rx, path);
+  return 0;
+}
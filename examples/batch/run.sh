@@ -0,0 +1,7 @@
+gcc examples/batch/record.c -o build/rhd_record -lrhd
+gcc -O3 examples/batch/batch.c -o build/rhd_batch -lrhd
+./build/rhd_record build/session.raw 200000
+./build/rhd_batch -r -s -b 20:450 -j 1 build/session.raw build/session_serial.f32
+./build/rhd_batch -r -s -b 20:450 build/session.raw build/session.f32
+cmp build/session_serial.f32 build/session.f32 && echo "identical to the serial run"
+./build/rhd_batch -r -s -b 20:450 -w 200 build/session.raw build/session_rms.f32
@@ -0,0 +1,67 @@
+#include <rhd.h>
+#include <rhd_event.h>
+#include <rhd_sim.h>
+#include <stdio.h>
+#include <time.h>
+
+#define N_FRAMES 200000
+
+static uint32_t state = 1;
+static uint32_t n_conv;
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Noise with a spike on one channel every 1000 frames
+static uint16_t spiky(void *ctx, int ch) {
+  state = state * 1103515245 + 12345;
+  int v = (int)((state >> 16) % 347) - 173;
+  if ((n_conv++ / 64) % 1000 == 500 && ch == 5) {
+    v -= 3000;
+  }
+  return (uint16_t)(int16_t)v;
+}
+
+int main() {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_set_signal(&sim, spiky, NULL);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, true, rhd_sim_rw);
+
+  static uint16_t frames[N_FRAMES][64];
+  for (int i = 0; i < N_FRAMES; i++) {
+    rhd2164_sample_all_burst(&dev, frames[i]);
+  }
+
+  for (int snip = 0; snip <= 16; snip += 16) {
+    rhd_event_cfg_t cfg;
+    rhd_event_det_t det;
+    rhd_event_t ev[64];
+    static int16_t snippets[64 * RHD_EVENT_MAX_SNIP];
+    rhd_event_default_cfg(&cfg);
+    cfg.snip_len = snip;
+    cfg.snip_pre = snip / 4;
+    if (rhd_event_init(&det, &cfg) != 0) {
+      return 1;
+    }
+
+    double t0 = now_s();
+    for (int i = 0; i < N_FRAMES; i++) {
+      rhd_event_process(&det, frames[i], ev, snippets, 64);
+    }
+    double dt = now_s() - t0;
+
+    double bytes_in = (double)N_FRAMES * 64 * sizeof(uint16_t);
+    double bytes_out =
+        det.n_events * (sizeof(rhd_event_t) + snip * sizeof(int16_t));
+    printf("snippet %2d %6.1f ns/frame %8lu events, output %.5f%% of input\n",
+           snip, 1e9 * dt / N_FRAMES, (unsigned long)det.n_events,
+           100 * bytes_out / bytes_in);
+  }
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <rhd.hpp>
+
+#define N_FRAMES 200000
+
+// Loopback transport: answers every transfer with a fixed DDR pattern, so the
+// benchmark only measures the driver's own encode/decode overhead.
+static uint16_t pattern[128];
+
+static int loop_rw(uint16_t *tx, uint16_t *rx, size_t len) {
+  std::memcpy(rx, pattern, len * sizeof(uint16_t));
+  return len;
+}
+
+struct LoopTransport {
+  int rw(uint16_t *tx, uint16_t *rx, size_t len) {
+    std::memcpy(rx, pattern, len * sizeof(uint16_t));
+    return len;
+  }
+};
+
+template <class F> static void bench(const char *name, F &&sample) {
+  uint16_t buf[64];
+  uint32_t sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < N_FRAMES; i++) {
+    sample(buf);
+    sink += buf[i & 63];
+  }
+  auto dt = std::chrono::steady_clock::now() - t0;
+  double ns = std::chrono::duration<double, std::nano>(dt).count() / N_FRAMES;
+  std::printf("%-28s %8.1f ns/frame (%u)\n", name, ns, sink & 1);
+}
+
+int main() {
+  for (int i = 0; i < 128; i++) {
+    pattern[i] = 0x9C35 + 0x1F3 * i;
+  }
+
+  rhd_device_t dev;
+  dev.rw = loop_rw;
+  dev.double_bits = true;
+  LoopTransport t;
+  rhd::Device<LoopTransport, true> cpp_dev(t);
+
+  bench("C rhd2164_sample_all", [&](uint16_t *b) { rhd2164_sample_all(&dev, b); });
+  bench("C rhd2164_sample_all_burst",
+        [&](uint16_t *b) { rhd2164_sample_all_burst(&dev, b); });
+  bench("C++ Device<_, true>", [&](uint16_t *b) { cpp_dev.sample_all(b); });
+  return 0;
+}
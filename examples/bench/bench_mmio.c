@@ -0,0 +1,75 @@
+#include <rhd.h>
+#include <rhd_mmio.h>
+#include <rhd_sim.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define N_FRAMES 2000
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, rhd_mmio_t *mmio, double dt) {
+  printf("%-12s %8.1f us/frame %8.1f MMIO/frame %6.1f doorbells/frame "
+         "%8.1f polls/frame\n",
+         name, 1e6 * dt / N_FRAMES, (double)mmio->n_mmio / N_FRAMES,
+         (double)mmio->n_burst / N_FRAMES, (double)mmio->n_poll / N_FRAMES);
+  mmio->n_mmio = 0;
+  mmio->n_burst = 0;
+  mmio->n_poll = 0;
+}
+
+int main() {
+  rhd_mmio_cfg_t cfg;
+  rhd_mmio_default_cfg(&cfg);
+  cfg.yield_polls = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 0 : 16;
+
+  // Shared region, the fake peer being a simulated RHD2164 in a child process
+  size_t size = rhd_mmio_region_size(&cfg) + sizeof(int);
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  volatile int *stop = (volatile int *)((char *)base + size - sizeof(int));
+
+  pid_t peer = fork();
+  if (peer == 0) {
+    rhd_sim_t sim;
+    rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+    rhd_sim_bind(&sim);
+    rhd_mmio_serve(&cfg, base, rhd_sim_rw, stop);
+    return 0;
+  }
+
+  rhd_mmio_t mmio;
+  rhd_device_t dev;
+  uint16_t buf[64];
+  rhd_mmio_attach(&mmio, base, size, &cfg);
+  rhd_mmio_bind(&mmio);
+  rhd_init(&dev, true, rhd_mmio_rw);
+  rhd_setup(&dev, 1000, 20, 500, true, 20);
+
+  mmio.n_mmio = 0;
+  mmio.n_burst = 0;
+  mmio.n_poll = 0;
+
+  double t0 = now_s();
+  for (int i = 0; i < N_FRAMES; i++) {
+    rhd2164_sample_all(&dev, buf);
+  }
+  report("per-command", &mmio, now_s() - t0);
+
+  t0 = now_s();
+  for (int i = 0; i < N_FRAMES; i++) {
+    rhd2164_sample_all_burst(&dev, buf);
+  }
+  report("burst", &mmio, now_s() - t0);
+
+  *stop = 1;
+  waitpid(peer, NULL, 0);
+  return 0;
+}
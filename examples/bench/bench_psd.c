@@ -0,0 +1,43 @@
+#include <rhd.h>
+#include <rhd_psd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N_FRAMES 200000
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main() {
+  static uint16_t frames[1024][64];
+  for (int i = 0; i < 1024; i++) {
+    for (int c = 0; c < 64; c++) {
+      frames[i][c] = rand() % 2000 - 1000;
+    }
+  }
+
+  for (uint32_t decim = 1; decim <= 16; decim *= 4) {
+    rhd_psd_cfg_t cfg;
+    rhd_psd_t psd;
+    rhd_psd_default_cfg(&cfg);
+    cfg.fs = 20000;
+    cfg.decim = decim;
+    if (rhd_psd_init(&psd, &cfg) != 0) {
+      return 1;
+    }
+
+    double t0 = now_s();
+    for (int i = 0; i < N_FRAMES; i++) {
+      rhd_psd_push(&psd, frames[i % 1024]);
+    }
+    double dt = now_s() - t0;
+    printf("decim %2u nfft %u %6.1f ns/frame, %lu PSDs\n", decim, cfg.nfft,
+           1e9 * dt / N_FRAMES, (unsigned long)psd.n_published);
+    rhd_psd_free(&psd);
+  }
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <pthread.h>
+#include <rhd.h>
+#include <rhd_frame.h>
+#include <rhd_ring.h>
+#include <rhd_sim.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+
+#define N_FRAMES 20000
+#define CAPACITY 256
+
+static uint16_t frames[CAPACITY * 64];
+static rhd_frame_hdr_t hdrs[CAPACITY];
+static rhd_ring_t ring;
+static volatile int done;
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *consume(void *arg) {
+  int id = (int)(long)arg;
+  uint32_t sum = 0;
+  while (!done) {
+    const uint16_t *f = rhd_ring_read(&ring, id, NULL);
+    if (f == NULL) {
+      sched_yield();
+      continue;
+    }
+    // Touch the frame in place, as a real consumer would
+    for (int i = 0; i < 64; i++) {
+      sum += f[i];
+    }
+    rhd_ring_release(&ring, id);
+  }
+  return (void *)(long)sum;
+}
+
+int main() {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, true, rhd_sim_rw);
+
+  for (int n_cons = 0; n_cons <= 4; n_cons = n_cons ? 2 * n_cons : 1) {
+    pthread_t th[4];
+    rhd_pacer_t pacer;
+    rhd_pacer_init(&pacer, 0, NULL);
+    rhd_ring_init(&ring, frames, hdrs, 64, CAPACITY);
+    done = 0;
+    for (int i = 0; i < n_cons; i++) {
+      int id = rhd_ring_attach(&ring, RHD_RING_LOSSY);
+      pthread_create(&th[i], NULL, consume, (void *)(long)id);
+    }
+
+    double t0 = now_s();
+    for (int i = 0; i < N_FRAMES; i++) {
+      rhd_ring_sample(&ring, &dev, &pacer, rhd2164_sample_all_burst);
+    }
+    double dt = now_s() - t0;
+
+    done = 1;
+    uint64_t n_lost = 0;
+    for (int i = 0; i < n_cons; i++) {
+      pthread_join(th[i], NULL);
+      n_lost += ring.consumers[i].n_lost;
+    }
+    printf("%d consumers %8.1f ns/frame (producer) %8.1f lost/consumer\n",
+           n_cons, 1e9 * dt / N_FRAMES,
+           n_cons ? (double)n_lost / n_cons : 0.0);
+  }
+  return 0;
+}
@@ -0,0 +1,39 @@
+#include <rhd.h>
+#include <rhd_spatial.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N_FRAMES 102400
+#define BLOCK 1024
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main() {
+  static uint16_t frames[BLOCK * 64];
+  static float out[BLOCK * 64];
+  for (int i = 0; i < BLOCK * 64; i++) {
+    frames[i] = rand();
+  }
+
+  const char *names[4] = {"mono", "bipolar row", "bipolar col", "laplacian"};
+  rhd_spatial_grid_t grid;
+  rhd_spatial_grid_init(&grid, 8, 8, 0, false);
+  for (int op = RHD_SPATIAL_MONO; op <= RHD_SPATIAL_LAPLACIAN; op++) {
+    rhd_spatial_t sf;
+    rhd_spatial_init(&sf, &grid, op, true, true);
+    rhd_spatial_set_bad(&sf, 27, true);
+
+    double t0 = now_s();
+    for (int i = 0; i < N_FRAMES; i += BLOCK) {
+      rhd_spatial_apply(&sf, frames, 64, BLOCK, out);
+    }
+    double dt = now_s() - t0;
+    printf("CAR + %-12s %6.1f ns/frame\n", names[op], 1e9 * dt / N_FRAMES);
+  }
+  return 0;
+}
@@ -0,0 +1,12 @@
+gcc -O3 examples/bench/bench_mmio.c -o build/bench_mmio -lrhd
+./build/bench_mmio
+g++ -std=c++14 -O3 examples/bench/bench_frame.cpp -o build/bench_frame -lrhd
+./build/bench_frame
+gcc -O3 examples/bench/bench_ring.c -o build/bench_ring -lrhd -lpthread
+./build/bench_ring
+gcc -O3 examples/bench/bench_event.c -o build/bench_event -lrhd -lm
+./build/bench_event
+gcc -O3 examples/bench/bench_spatial.c -o build/bench_spatial -lrhd
+./build/bench_spatial
+gcc -O3 examples/bench/bench_psd.c -o build/bench_psd -lrhd -lm
+./build/bench_psd
@@ -0,0 +1,33 @@
+#include <rhd_net.h>
+#include <stdio.h>
+#include <string.h>
+
+static void on_frame(void *ctx, const rhd_frame_hdr_t *hdr,
+                     const uint16_t *samples, size_t frame_len) {
+  unsigned long *n = (unsigned long *)ctx;
+  if (++*n % 2000 == 0) {
+    printf("frame %u ch 5 = 0x%04x\n", hdr->seq, samples[5]);
+  }
+}
+
+// Receive the server's stream, over UDP port 5000 or with `tcp` over TCP
+int main(int argc, char **argv) {
+  rhd_net_rx_t rx;
+  int ret = argc > 1 && strcmp(argv[1], "tcp") == 0
+                ? rhd_net_rx_tcp(&rx, 0, "127.0.0.1", 5001)
+                : rhd_net_rx_udp(&rx, 0, 5000);
+  if (ret != 0) {
+    perror("socket");
+    return 1;
+  }
+
+  unsigned long n = 0;
+  while (rhd_net_rx_poll(&rx, on_frame, &n, 2000) > 0) {
+  }
+
+  printf("%lu frames, %llu packets, %llu packets lost, %llu frames lost\n", n,
+         (unsigned long long)rx.n_pkts, (unsigned long long)rx.n_lost_pkts,
+         (unsigned long long)rx.gap.n_missing);
+  rhd_net_rx_close(&rx);
+  return 0;
+}
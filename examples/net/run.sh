@@ -0,0 +1,8 @@
+gcc examples/net/server.c -o build/rhd_net_server -lrhd
+gcc examples/net/client.c -o build/rhd_net_client -lrhd
+./build/rhd_net_client &
+sleep 0.2
+./build/rhd_net_server &
+sleep 0.2
+./build/rhd_net_client tcp
+wait
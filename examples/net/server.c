@@ -0,0 +1,43 @@
+#include <rhd.h>
+#include <rhd_frame.h>
+#include <rhd_net.h>
+#include <rhd_sim.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Stream a simulated RHD2164 at 2 kHz, to UDP 127.0.0.1:5000 and to any TCP
+// client connected to port 5001
+int main(int argc, char **argv) {
+  int n_frames = argc > 1 ? atoi(argv[1]) : 20000;
+
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, true, rhd_sim_rw);
+  rhd_setup(&dev, 2000, 20, 500, true, 20);
+
+  // 8 frames (1168 bytes) per datagram, 4 datagrams per sendmmsg
+  rhd_net_tx_t tx;
+  rhd_net_tx_init(&tx, 0, 64, 8, 4);
+  rhd_net_tx_udp(&tx, "127.0.0.1", 5000);
+  if (rhd_net_tx_tcp_listen(&tx, 5001) != 0) {
+    perror("listen");
+    return 1;
+  }
+
+  rhd_pacer_t pacer;
+  rhd_pacer_init(&pacer, 500000, NULL);
+  uint16_t buf[64];
+  rhd_frame_hdr_t hdr;
+  for (int i = 0; i < n_frames; i++) {
+    rhd_frame_sample(&dev, &pacer, rhd2164_sample_all_burst, buf, &hdr);
+    rhd_net_tx_push(&tx, &hdr, buf);
+  }
+  rhd_net_tx_flush(&tx);
+
+  printf("%d frames, %llu packets, %llu send calls\n", n_frames,
+         (unsigned long long)tx.n_pkts, (unsigned long long)tx.n_syscalls);
+  rhd_net_tx_close(&tx);
+  return 0;
+}
@@ -35,6 +35,7 @@ def build_cffi(
     c_files: str,
     libraries=[],
     out_path="./",
+    extra_files=[],
 ):
     """
     This function takes care of the building phase of CFFI Out-of-line API mode.
@@ -44,6 +45,7 @@ def build_cffi(
     It requires the paths to `librhd` sources (.h, .c).
     `args` allows to pass in an arbitrary list of other paths, which will be included in the CFFI build.
     For example, it's recommended to pass in your custom `rw` functor implementation.
+    `extra_files` are other `librhd` sources (.h, .c) the build needs but Python does not call.
     """
 
     ffibuilder = FFI()
@@ -71,13 +73,17 @@ def build_cffi(
     for i, f in enumerate(c_files):
         shutil.copy(f, "./")
         c_files[i] = f.split("/")[-1]
+    extra_files = list(extra_files)
+    for i, f in enumerate(extra_files):
+        shutil.copy(f, "./")
+        extra_files[i] = f.split("/")[-1]
 
     c_src = """
     #include "rhd.h"
     """ + "\n".join(
         [f'#include "{h}"' for h in h_files]
     )
-    sources = ["rhd.c", *c_files]
+    sources = ["rhd.c", *c_files, *[f for f in extra_files if f.endswith(".c")]]
 
     if len(libraries) == 0:
         ffibuilder.set_source(
@@ -105,7 +111,7 @@ def build_cffi(
             shutil.copy(f, out_path)
             os.remove(f)
 
-    for f in ["rhd.h", "rhd.c", *h_files, *c_files]:
+    for f in ["rhd.h", "rhd.c", *h_files, *c_files, *extra_files]:
         os.remove(f)
 
 
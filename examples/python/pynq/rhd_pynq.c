@@ -1,9 +1,9 @@
 #include "rhd_pynq.h"
+#include "../../../src/rhd_frame.h"
 #include <pynq_api.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/time.h>
 
 // AXI gpio 0: 0x4120 | 1 channel | 24 bits | control signals
 // AXI gpio 1: 0x4121 | 2 channels | 1 bit | spi_start, spi_done
@@ -74,23 +74,19 @@ int rhd_pynq_rw(uint16_t *tx, uint16_t *rx, size_t len) {
   return len;
 }
 
-uint32_t get_timestamp_us() {
-  // https://stackoverflow.com/a/5833240
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return tv.tv_sec * (uint32_t)1000000 + tv.tv_usec;
-}
-
 uint16_t *rhd_pynq_sampling(rhd_device_t *dev, uint32_t nsamples,
                             uint32_t dt_micro) {
+  return rhd_pynq_sampling_hdr(dev, nsamples, dt_micro, NULL);
+}
+
+uint16_t *rhd_pynq_sampling_hdr(rhd_device_t *dev, uint32_t nsamples,
+                                uint32_t dt_micro, rhd_frame_hdr_t *hdr) {
   uint16_t *bigbuf = (uint16_t *)malloc(64 * nsamples * sizeof(uint16_t));
+  rhd_pacer_t pacer;
+  rhd_pacer_init(&pacer, dt_micro * 1000ULL, NULL);
   for (uint32_t i = 0; i < nsamples; i++) {
-    uint32_t t0 = get_timestamp_us();
-    rhd_sample_all(dev);
-    memcpy(bigbuf + (i * 64), dev->sample_buf, 64 * sizeof(uint16_t));
-    while (get_timestamp_us() - t0 < dt_micro) {
-      ;
-    }
+    rhd_frame_sample(dev, &pacer, rhd2164_sample_all, bigbuf + (i * 64),
+                     hdr != NULL ? &hdr[i] : NULL);
   }
   return bigbuf;
 }
@@ -1,4 +1,5 @@
 #include "../../../src/rhd.h"
+#include "../../../src/rhd_frame.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -49,3 +50,18 @@ uint16_t *rhd_pynq_sampling(rhd_device_t *dev, uint32_t nsamples,
                             uint32_t dt_micro);
 
 // CFFI END
+
+// C only, CFFI does not declare `rhd_frame_hdr_t`
+
+/**
+ * @brief Same as `rhd_pynq_sampling`, also filling one header per frame with
+ * its timestamp, sequence number, transport error flag and lateness.
+ *
+ * @param dev
+ * @param nsamples
+ * @param dt_micro
+ * @param hdr `nsamples` headers, parallel to the returned samples
+ * @return uint16_t*
+ */
+uint16_t *rhd_pynq_sampling_hdr(rhd_device_t *dev, uint32_t nsamples,
+                                uint32_t dt_micro, rhd_frame_hdr_t *hdr);
@@ -43,5 +43,6 @@ if __name__ == "__main__":
         os.path.dirname(__file__) + "/rhd_pynq.c",
         ["pynq", "cma", "pthread"],
         os.path.dirname(__file__),
+        ["src/rhd_frame.h", "src/rhd_frame.c"],
     )
     test()
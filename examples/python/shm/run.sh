@@ -0,0 +1,5 @@
+gcc examples/python/shm/shm_producer.c -o build/rhd_shm_producer -lrhd
+./build/rhd_shm_producer &
+sleep 0.5
+python3 examples/python/shm/shm_reader.py
+wait
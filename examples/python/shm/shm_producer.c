@@ -0,0 +1,31 @@
+#include <rhd.h>
+#include <rhd_frame.h>
+#include <rhd_shm.h>
+#include <rhd_sim.h>
+#include <stdio.h>
+
+// Publish a simulated RHD2164 at 2 kHz into the "/rhd0" shared memory ring
+int main() {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, true, rhd_sim_rw);
+  rhd_setup(&dev, 2000, 20, 500, true, 20);
+
+  // 1 second of frames
+  rhd_shm_t *shm = rhd_shm_create("/rhd0", 64, 2048);
+  if (shm == NULL) {
+    perror("rhd_shm_create");
+    return 1;
+  }
+
+  rhd_pacer_t pacer;
+  rhd_pacer_init(&pacer, 500000, NULL);
+  for (int i = 0; i < 20000; i++) {
+    rhd_shm_sample(shm, &dev, &pacer, rhd2164_sample_all_burst);
+  }
+
+  rhd_shm_destroy(shm);
+  return 0;
+}
@@ -0,0 +1,47 @@
+import sys
+import os
+
+sys.path.append(os.path.dirname(__file__) + "/../")  # patch PATHs
+
+import cffi_utils
+from cffi import FFI
+
+
+def open_librhd():
+    """
+    Declare the consumer API of `rhd_shm.h` and load `librhd` in ABI mode.
+    No compilation is needed on the consumer's side.
+    """
+    ffi = FFI()
+    ffi.cdef(cffi_utils.read_cffi_h_to_str("src/rhd_shm.h"))
+    lib = ffi.dlopen("librhd.so")
+    return ffi, lib
+
+
+def read_frames(name="/rhd0", n_frames=10000, batch=64):
+    ffi, lib = open_librhd()
+
+    shm = lib.rhd_shm_attach(name.encode("ascii"))
+    if shm == ffi.NULL:
+        print(f"{name} does not exist, start the producer first")
+        return
+
+    frame_len = lib.rhd_shm_frame_len(shm)
+    samples = ffi.new("uint16_t[]", batch * frame_len)
+    seq = ffi.new("uint32_t[]", batch)
+
+    n = 0
+    while n < n_frames:
+        if not lib.rhd_shm_wait(shm, 1000000):
+            break
+        got = lib.rhd_shm_read(shm, samples, ffi.NULL, seq, ffi.NULL, batch)
+        n += got
+        if got > 0 and n % 2000 < got:
+            print(f"frame {seq[got - 1]} ch 5 = {samples[(got - 1) * frame_len + 5]:#06x}")
+
+    print(f"{n} frames read, {lib.rhd_shm_lost(shm)} lost")
+    lib.rhd_shm_detach(shm)
+
+
+if __name__ == "__main__":
+    read_frames()
@@ -27,13 +27,57 @@ static int rhd_duplicate_bits(uint8_t val);
  */
 static void rhd_unsplit_u16(uint16_t data, uint8_t *a, uint8_t *b);
 
-static const uint16_t RHD_ADC_CH_CMD_DOUBLE[32] = {
-    0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F, 0xC0, 0xC3, 0xCC,
-    0xCF, 0xF0, 0xF3, 0xFC, 0xFF, 0x300, 0x303, 0x30C, 0x30F, 0x330, 0x333,
-    0x33C, 0x33F, 0x3C0, 0x3C3, 0x3CC, 0x3CF, 0x3F0, 0x3F3, 0x3FC, 0x3FF};
-static const uint16_t RHD_ADC_CH_CMD[32] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
-                                            11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21,
-                                            22, 23, 24, 25, 26, 27, 28, 29, 30, 31};
+/**
+ * @brief Sample RHD2164 channels, see @ref rhd2164_sample.
+ *
+ * @return int `rw` return code
+ */
+static int rhd2164_xfer(rhd_device_t *dev, uint16_t ch, uint16_t *rx);
+
+/**
+ * @brief Sample a frame with a single `rw` call and decode it, see
+ * @ref rhd_sample_all.
+ *
+ * @return int `rw` return code
+ */
+static int rhd_engine_xfer(rhd_device_t *dev, const rhd_engine_t *eng,
+                           uint16_t *sample_buf);
+
+/** CONVERT commands of channels 0-31, shorter frames use the start */
+static const uint16_t RHD_FRAME_TX[32] = {
+    0x0000, 0x0100, 0x0200, 0x0300, 0x0400, 0x0500, 0x0600, 0x0700,
+    0x0800, 0x0900, 0x0A00, 0x0B00, 0x0C00, 0x0D00, 0x0E00, 0x0F00,
+    0x1000, 0x1100, 0x1200, 0x1300, 0x1400, 0x1500, 0x1600, 0x1700,
+    0x1800, 0x1900, 0x1A00, 0x1B00, 0x1C00, 0x1D00, 0x1E00, 0x1F00};
+/** Same commands, bit-doubled */
+static const uint16_t RHD_FRAME_TX_DOUBLE[64] = {
+    0x000, 0, 0x003, 0, 0x00C, 0, 0x00F, 0, 0x030, 0, 0x033, 0, 0x03C, 0,
+    0x03F, 0, 0x0C0, 0, 0x0C3, 0, 0x0CC, 0, 0x0CF, 0, 0x0F0, 0, 0x0F3, 0,
+    0x0FC, 0, 0x0FF, 0, 0x300, 0, 0x303, 0, 0x30C, 0, 0x30F, 0, 0x330, 0,
+    0x333, 0, 0x33C, 0, 0x33F, 0, 0x3C0, 0, 0x3C3, 0, 0x3CC, 0, 0x3CF, 0,
+    0x3F0, 0, 0x3F3, 0, 0x3FC, 0, 0x3FF, 0};
+
+/** Results arrive 2 commands late */
+static const uint8_t RHD_FRAME_RX_CH_32[32] = {
+    30, 31, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+    14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29};
+static const uint8_t RHD_FRAME_RX_CH_16[16] = {
+    14, 15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+
+static const rhd_engine_t RHD_ENGINES[] = {
+    {RHD_CHIP_RHD2132, 32, false, false, false, 32, 32, 32, RHD_FRAME_TX,
+     RHD_FRAME_RX_CH_32},
+    {RHD_CHIP_RHD2132, 32, false, false, true, 32, 64, 64,
+     RHD_FRAME_TX_DOUBLE, RHD_FRAME_RX_CH_32},
+    {RHD_CHIP_RHD2216, 16, true, false, false, 16, 16, 16, RHD_FRAME_TX,
+     RHD_FRAME_RX_CH_16},
+    {RHD_CHIP_RHD2216, 16, true, false, true, 16, 32, 32,
+     RHD_FRAME_TX_DOUBLE, RHD_FRAME_RX_CH_16},
+    {RHD_CHIP_RHD2164, 64, false, true, false, 32, 32, 64, RHD_FRAME_TX,
+     RHD_FRAME_RX_CH_32},
+    {RHD_CHIP_RHD2164, 64, false, true, true, 32, 64, 64,
+     RHD_FRAME_TX_DOUBLE, RHD_FRAME_RX_CH_32},
+};
 
 uint8_t rhd_send(rhd_device_t *dev, uint16_t reg, uint16_t val)
 {
@@ -42,9 +86,10 @@ uint8_t rhd_send(rhd_device_t *dev, uint16_t reg, uint16_t val)
   case 0:
   {
     uint16_t tx = (reg << 8) | (val & 0xFF);
-    uint16_t rx = 0;
-    dev->rw(&tx, &rx, 1);
-    return (uint8_t)(rx & 0xFF);
+    // Hardware flip-flops return both MISO lines
+    uint16_t rx[2] = {0};
+    dev->rw(&tx, rx, 1);
+    return (uint8_t)(rx[0] & 0xFF);
   }
   default:
   {
@@ -74,11 +119,143 @@ uint8_t rhd_w(rhd_device_t *dev, uint16_t reg, uint16_t val)
   return rhd_send(dev, reg, val);
 }
 
+int rhd_send_burst(rhd_device_t *dev, const uint16_t *cmds, uint16_t *rx_a,
+                   uint16_t *rx_b, size_t n)
+{
+  uint16_t tx[2 * RHD_BURST_LEN];
+  uint16_t rx[2 * RHD_BURST_LEN];
+  int ret = 0;
+
+  for (size_t off = 0; off < n; off += RHD_BURST_LEN)
+  {
+    size_t len = n - off < RHD_BURST_LEN ? n - off : RHD_BURST_LEN;
+    int r;
+
+    if (dev->double_bits)
+    {
+      for (size_t i = 0; i < len; i++)
+      {
+        tx[2 * i] = rhd_duplicate_bits(cmds[off + i] >> 8);
+        tx[2 * i + 1] = rhd_duplicate_bits(cmds[off + i] & 0xFF);
+      }
+      r = dev->rw(tx, rx, 2 * len);
+      for (size_t i = 0; i < len; i++)
+      {
+        uint8_t a_h, b_h, a_l, b_l;
+        rhd_unsplit_u16(rx[2 * i], &a_h, &b_h);
+        rhd_unsplit_u16(rx[2 * i + 1], &a_l, &b_l);
+        if (rx_a != NULL)
+        {
+          rx_a[off + i] = (((uint16_t)a_h) << 8) | a_l;
+        }
+        if (rx_b != NULL)
+        {
+          rx_b[off + i] = (((uint16_t)b_h) << 8) | b_l;
+        }
+      }
+    }
+    else if (rx_b != NULL)
+    {
+      // Hardware flip-flop: 2 words (MISO A, MISO B) per command
+      for (size_t i = 0; i < len; i++)
+      {
+        tx[i] = cmds[off + i];
+      }
+      r = dev->rw(tx, rx, len);
+      for (size_t i = 0; i < len; i++)
+      {
+        if (rx_a != NULL)
+        {
+          rx_a[off + i] = rx[2 * i];
+        }
+        rx_b[off + i] = rx[2 * i + 1];
+      }
+    }
+    else
+    {
+      for (size_t i = 0; i < len; i++)
+      {
+        tx[i] = cmds[off + i];
+      }
+      r = dev->rw(tx, rx, len);
+      for (size_t i = 0; rx_a != NULL && i < len; i++)
+      {
+        rx_a[off + i] = rx[i];
+      }
+    }
+
+    if (ret >= 0)
+    {
+      ret = r;
+    }
+  }
+  return ret;
+}
+
 int rhd_init(rhd_device_t *dev, bool mode, rhd_rw_t rw)
 {
   dev->double_bits = mode;
   dev->rw = rw;
-  return rhd_sanity_check(dev);
+  dev->engine = NULL;
+  int ret = rhd_sanity_check(dev);
+  if (ret != 0)
+  {
+    return ret;
+  }
+  // An unknown chip falls back to RHD2164, see rhd_detect
+  rhd_detect(dev);
+  return 0;
+}
+
+const rhd_engine_t *rhd_engine_find(uint8_t chip_id, bool double_bits)
+{
+  for (size_t i = 0; i < sizeof(RHD_ENGINES) / sizeof(RHD_ENGINES[0]); i++)
+  {
+    if (RHD_ENGINES[i].chip_id == chip_id &&
+        RHD_ENGINES[i].double_bits == double_bits)
+    {
+      return &RHD_ENGINES[i];
+    }
+  }
+  return NULL;
+}
+
+int rhd_detect(rhd_device_t *dev)
+{
+  const uint8_t regs[4] = {CHIP_ID, NB_AMP, UNI_BIPLR_AMPS, MISO_A_B};
+  uint8_t vals[4];
+
+  dev->engine = NULL;
+  // Pipelined reads, 2 dummy cmds flush the last results
+  for (int i = 0; i < 6; i++)
+  {
+    uint8_t val = rhd_r(dev, i < 4 ? regs[i] : CHIP_ID);
+    if (i >= 2)
+    {
+      vals[i - 2] = val;
+    }
+  }
+
+  const rhd_engine_t *eng = rhd_engine_find(vals[0], dev->double_bits);
+  if (eng == NULL)
+  {
+    return CHIP_ID;
+  }
+  if (vals[1] != eng->n_amp)
+  {
+    return NB_AMP;
+  }
+  if ((vals[2] != 0) != eng->bipolar)
+  {
+    return UNI_BIPLR_AMPS;
+  }
+  // MISO A reads '5' on RHD2164, 0 on single-MISO chips
+  if (vals[3] != (eng->miso_b ? 0x35 : 0))
+  {
+    return MISO_A_B;
+  }
+  dev->engine = eng;
+  return 0;
 }
 
 int rhd_setup(rhd_device_t *dev, float fs, float fl, float fh, bool dsp,
@@ -101,7 +278,7 @@ int rhd_setup(rhd_device_t *dev, float fs, float fl, float fh, bool dsp,
   rhd_w(dev, IMP_CHK_DAC, 0);
   rhd_w(dev, IMP_CHK_AMP_SEL, 0);
 
-  rhd_cfg_fs(dev, fs, 32);
+  rhd_cfg_fs(dev, fs, dev->engine != NULL ? dev->engine->n_cmds : 32);
   rhd_cfg_dsp(dev, true, false, dsp, fdsp, fs);
   rhd_cfg_ch(dev, 0xFFFFFFFF, 0xFFFFFFFF);
   rhd_cfg_amp_bw(dev, fl, fh);
@@ -273,58 +450,64 @@ uint8_t rhd_read_force(rhd_device_t *dev, int reg)
 
 uint16_t *rhd2164_sample(rhd_device_t *dev, uint16_t ch, uint16_t *rx)
 {
-  switch ((int)dev->double_bits)
-  {
-  case 0:
-  {
-    uint16_t tx = (ch << 8);
-    dev->rw(&tx, rx, 1);
-    return rx;
-  }
-  default:
-  {
-    uint16_t tx[2] = {0};
-    tx[0] = rhd_duplicate_bits(ch);
-
-    dev->rw(tx, rx, 2);
-
-    uint8_t dat_a[2] = {0};
-    uint8_t dat_b[2] = {0};
-    rhd_unsplit_u16(rx[0], &dat_a[1], &dat_b[1]);
-    rhd_unsplit_u16(rx[1], &dat_a[0], &dat_b[0]);
-    rx[0] =
-        (((uint16_t)dat_a[1]) << 8) | dat_a[0] | 1;
-    rx[1] =
-        (((uint16_t)dat_b[1]) << 8) | dat_b[0] | 1;
-    return rx;
-  }
-  }
+  rhd2164_xfer(dev, ch, rx);
+  return rx;
 }
 
 uint16_t rhd2000_sample(rhd_device_t *dev, uint16_t ch)
 {
   uint16_t tx = (ch << 8);
-  uint16_t rx;
-  dev->rw(&tx, &rx, 1);
-  return rx;
+  uint16_t rx[2] = {0};
+  dev->rw(&tx, rx, 1);
+  return rx[0];
 }
 
-void rhd2164_sample_all(rhd_device_t *dev, uint16_t *sample_buf)
+int rhd2164_sample_all(rhd_device_t *dev, uint16_t *sample_buf)
 {
   // Let ch0 sample from last iter, ask for ch1
-  // const uint16_t *RHD_ADC_CH =
-  //     (int)dev->double_bits ? RHD_ADC_CH_CMD_DOUBLE : RHD_ADC_CH_CMD;
   uint16_t rx[2] = {0};
+  int ret = 0;
 
   for (int ch = 0; ch < 32; ch++)
   {
-    rhd2164_sample(dev, ch, rx);
+    int r = rhd2164_xfer(dev, ch, rx);
+    if (ret >= 0)
+    {
+      ret = r;
+    }
     int rx_ch = ch < 2 ? 31 - ch : ch - 2;
     sample_buf[rx_ch] = rx[0];
     sample_buf[rx_ch + 32] = rx[1];
   }
   // Alignment
   sample_buf[0] &= 0xFFFE;
+
+  return ret;
+}
+
+int rhd_sample_all(rhd_device_t *dev, uint16_t *sample_buf)
+{
+  const rhd_engine_t *eng = dev->engine;
+  if (eng == NULL)
+  {
+    eng = rhd_engine_find(RHD_CHIP_RHD2164, dev->double_bits);
+  }
+  return rhd_engine_xfer(dev, eng, sample_buf);
+}
+
+int rhd2164_sample_all_burst(rhd_device_t *dev, uint16_t *sample_buf)
+{
+  int ret = rhd_engine_xfer(
+      dev, rhd_engine_find(RHD_CHIP_RHD2164, dev->double_bits), sample_buf);
+
+  // Keep rhd2164_sample_all's order for channels 30 and 31
+  for (int ch = 30; ch < 64; ch += 32)
+  {
+    uint16_t tmp = sample_buf[ch];
+    sample_buf[ch] = sample_buf[ch + 1];
+    sample_buf[ch + 1] = tmp;
+  }
+  return ret;
 }
 
 static int rhd_duplicate_bits(uint8_t val)
@@ -356,3 +539,86 @@ static void rhd_unsplit_u16(uint16_t data, uint8_t *a, uint8_t *b)
   *a = aa;
   *b = bb;
 }
+
+static int rhd2164_xfer(rhd_device_t *dev, uint16_t ch, uint16_t *rx)
+{
+  switch ((int)dev->double_bits)
+  {
+  case 0:
+  {
+    uint16_t tx = (ch << 8);
+    return dev->rw(&tx, rx, 1);
+  }
+  default:
+  {
+    uint16_t tx[2] = {0};
+    tx[0] = rhd_duplicate_bits(ch);
+
+    int ret = dev->rw(tx, rx, 2);
+
+    uint8_t dat_a[2] = {0};
+    uint8_t dat_b[2] = {0};
+    rhd_unsplit_u16(rx[0], &dat_a[1], &dat_b[1]);
+    rhd_unsplit_u16(rx[1], &dat_a[0], &dat_b[0]);
+    rx[0] =
+        (((uint16_t)dat_a[1]) << 8) | dat_a[0] | 1;
+    rx[1] =
+        (((uint16_t)dat_b[1]) << 8) | dat_b[0] | 1;
+    return ret;
+  }
+  }
+}
+
+void rhd_engine_decode(const rhd_engine_t *eng, const uint16_t *rx,
+                       uint16_t *sample_buf)
+{
+  const int n = eng->n_cmds;
+
+  if (eng->double_bits)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      uint8_t a_h, b_h, a_l, b_l;
+      rhd_unsplit_u16(rx[2 * i], &a_h, &b_h);
+      rhd_unsplit_u16(rx[2 * i + 1], &a_l, &b_l);
+      sample_buf[eng->rx_ch[i]] = (((uint16_t)a_h) << 8) | a_l | 1;
+      if (eng->miso_b)
+      {
+        sample_buf[eng->rx_ch[i] + n] = (((uint16_t)b_h) << 8) | b_l | 1;
+      }
+    }
+  }
+  else if (eng->miso_b)
+  {
+    // Hardware flip-flop: MISO A and MISO B words for each command
+    for (int i = 0; i < n; i++)
+    {
+      sample_buf[eng->rx_ch[i]] = rx[2 * i];
+      sample_buf[eng->rx_ch[i] + n] = rx[2 * i + 1];
+    }
+  }
+  else
+  {
+    for (int i = 0; i < n; i++)
+    {
+      sample_buf[eng->rx_ch[i]] = rx[i];
+    }
+  }
+  // Alignment
+  sample_buf[0] &= 0xFFFE;
+}
+
+static int rhd_engine_xfer(rhd_device_t *dev, const rhd_engine_t *eng,
+                           uint16_t *sample_buf)
+{
+  uint16_t tx[64];
+  uint16_t rx[64] = {0};
+
+  for (int i = 0; i < eng->n_tx; i++)
+  {
+    tx[i] = eng->tx[i];
+  }
+  int ret = dev->rw(tx, rx, eng->n_tx);
+  rhd_engine_decode(eng, rx, sample_buf);
+  return ret;
+}
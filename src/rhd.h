@@ -13,6 +13,14 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/** Maximum number of commands sent per `rw` call by @ref rhd_send_burst */
+#define RHD_BURST_LEN 64
+
+/** Amplifier input-referred ADC step [V] */
+#define RHD_ADC_STEP 0.195e-6
+/** Impedance check DAC step [V] */
+#define RHD_ZCHECK_DAC_STEP (1.225 / 256.0)
+
 /**
  * @brief RHD2164 Read Write function typedef.
  * When called, it must send out w_buf while reading into r_buf.
@@ -22,14 +30,50 @@
  * @param rx_buf receive buffer
  * @param len number of 16-bit values to transfer.
  *
- * @returns int : Return code
+ * @returns int : Return code, negative on transport failure
  */
 typedef int (*rhd_rw_t)(uint16_t *tx_buf, uint16_t *rx_buf, size_t len);
 
+/** CHIP_ID register values */
+#define RHD_CHIP_RHD2132 1
+#define RHD_CHIP_RHD2216 2
+#define RHD_CHIP_RHD2164 4
+
+/**
+ * @brief Frame engine of a chip variant and SPI mode, selected by
+ * @ref rhd_detect. It holds the precomputed command burst of a frame, the
+ * channel each result belongs to and the decode path.
+ */
+typedef struct
+{
+  /** CHIP_ID register (63), one of `RHD_CHIP_*` */
+  uint8_t chip_id;
+  /** NB_AMP register (62), also the number of samples per frame */
+  uint8_t n_amp;
+  /** UNI_BIPLR_AMPS register (61), true for RHD2216's bipolar amplifiers */
+  bool bipolar;
+  /** True if MISO B carries channels `n_cmds` and up (RHD2164) */
+  bool miso_b;
+  /** SPI mode, see @ref rhd_init */
+  bool double_bits;
+  /** CONVERT commands per frame */
+  uint8_t n_cmds;
+  /** Words sent per frame, `2 * n_cmds` in DDR mode */
+  uint8_t n_tx;
+  /** Words received per frame, `2 * n_cmds` in DDR or flip-flop mode */
+  uint8_t n_rx;
+  /** Frame command burst */
+  const uint16_t *tx;
+  /** Frame index of the result received with each command */
+  const uint8_t *rx_ch;
+} rhd_engine_t;
+
 typedef struct
 {
   rhd_rw_t rw;
   bool double_bits;
+  /** Frame engine of the detected chip, NULL if unknown (RHD2164 assumed) */
+  const rhd_engine_t *engine;
 } rhd_device_t;
 
 typedef enum
@@ -100,8 +144,33 @@ uint8_t rhd_r(rhd_device_t *dev, uint16_t reg);
 uint8_t rhd_w(rhd_device_t *dev, uint16_t reg, uint16_t val);
 
 /**
- * @brief Initialize RHD device driver. Afterwards, call `rhd_setup(...)` to
- * ready the device.
+ * @brief Send a burst of raw 16-bit commands through a single `rw` call.
+ *
+ * Commands are doubled if `dev->double_bits` is true. Results are returned
+ * in transfer order, so `rx_a[i]` holds the result of `cmds[i - 2]`.
+ *
+ * When `double_bits` is false and `rx_b` is not NULL, `rw` is expected to
+ * behave like a hardware flip-flop and return 2 words per command (MISO A,
+ * MISO B), as in @ref rhd2164_sample.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @param cmds commands to send
+ * @param rx_a MISO A results, can be NULL
+ * @param rx_b MISO B results (RHD2164 only), can be NULL
+ * @param n number of commands, longer bursts are split in chunks of
+ * `RHD_BURST_LEN`
+ * @return int `rw` return code of the last chunk, or the first negative one
+ */
+int rhd_send_burst(rhd_device_t *dev, const uint16_t *cmds, uint16_t *rx_a,
+                   uint16_t *rx_b, size_t n);
+
+/**
+ * @brief Initialize RHD device driver and detect the chip variant with
+ * @ref rhd_detect. Afterwards, call `rhd_setup(...)` to ready the device.
+ *
+ * A failed detection does not fail the initialization: `dev->engine` is left
+ * NULL and the driver assumes an RHD2164, as before variants were detected.
+ * Call @ref rhd_detect to require a known chip.
  *
  * @param dev pointer to rhd_device_t instance
  * @param mode true if using hardware flipflop strategy, false otherwise.
@@ -109,10 +178,30 @@ uint8_t rhd_w(rhd_device_t *dev, uint16_t reg, uint16_t val);
  * This is how RHD2164 driver bridges to the hardware.
  * Refer to @ref rhd_rw_t's inline documentation.
  *
- * @return int sanity check result, 0 for success. See `rhd_sanity_check` for more details.
+ * @return int sanity check result, 0 for success. See `rhd_sanity_check` for
+ * more details.
  */
 int rhd_init(rhd_device_t *dev, bool mode, rhd_rw_t rw);
 
+/**
+ * @brief Frame engine of a chip variant.
+ *
+ * @param chip_id CHIP_ID register value, one of `RHD_CHIP_*`
+ * @param double_bits SPI mode, see @ref rhd_init
+ * @return const rhd_engine_t* engine, NULL for an unknown chip
+ */
+const rhd_engine_t *rhd_engine_find(uint8_t chip_id, bool double_bits);
+
+/**
+ * @brief Read the CHIP_ID, NB_AMP, UNI_BIPLR_AMPS and MISO_A_B ROM registers
+ * and select the matching frame engine into `dev->engine`.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @return int 0 for success. Otherwise, returns the first register which
+ * does not match a known variant, and `dev->engine` is NULL.
+ */
+int rhd_detect(rhd_device_t *dev);
+
 /**
  * @brief Setup RHD device with sensible defaults, including device calibration.
  *
@@ -242,8 +331,53 @@ uint16_t *rhd2164_sample(rhd_device_t *dev, uint16_t ch, uint16_t *rx);
  *
  * Channel 0's LSb is set to 0, while all others are set to 1 for alignment.
  *
+ * For compatibility, channels 30 and 31 (and 62 and 63) are stored swapped.
+ * @ref rhd_sample_all stores every channel at its index.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @param sample_buf 64 samples reception buffer
+ * @return int `rw` return code of the last transfer, or the first negative one
+ */
+int rhd2164_sample_all(rhd_device_t *dev, uint16_t *sample_buf);
+
+/**
+ * @brief Sample all channels of the detected chip with a single `rw` call,
+ * using `dev->engine`'s precomputed command burst.
+ *
+ * The frame holds `dev->engine->n_amp` samples at their channel index: 64 for
+ * RHD2164 (or an undetected chip), 32 for RHD2132 and 16 for RHD2216. As with
+ * RHD2164, channel 0's LSb is set to 0, and in DDR mode all others are set to
+ * 1 for alignment.
+ *
+ * @param dev pointer to rhd_device_t instance, initialized by @ref rhd_init
+ * @param sample_buf `n_amp` samples reception buffer
+ * @return int `rw` return code
+ */
+int rhd_sample_all(rhd_device_t *dev, uint16_t *sample_buf);
+
+/**
+ * @brief Decode the words received for a frame, eg a raw recording of `rw`
+ * transfers, the way @ref rhd_sample_all does.
+ *
+ * @param eng frame engine of the chip and SPI mode
+ * @param rx `eng->n_rx` received words
+ * @param sample_buf `eng->n_amp` samples
+ */
+void rhd_engine_decode(const rhd_engine_t *eng, const uint16_t *rx,
+                       uint16_t *sample_buf);
+
+/**
+ * @brief Sample all RHD2164 channels with a single `rw` call.
+ *
+ * Same output as @ref rhd2164_sample_all, but the 32 convert commands are
+ * sent as one burst, which is much cheaper for transports with a high
+ * per-call overhead (eg FIFO-based, see `rhd_mmio.h`). `rw` must fill `rx`
+ * for the whole burst.
+ *
  * @param dev pointer to rhd_device_t instance
+ * @param sample_buf 64 samples reception buffer
+ * @return int `rw` return code
  */
-void rhd2164_sample_all(rhd_device_t *dev, uint16_t *sample_buf);
+int rhd2164_sample_all_burst(rhd_device_t *dev, uint16_t *sample_buf);
 
 #endif /* RHD_H */
\ No newline at end of file
@@ -0,0 +1,220 @@
+/** @file rhd.hpp
+ *
+ * @brief Header-only C++ front end to the RHD2000 driver.
+ *
+ * `rhd::Device<Transport, Ddr>` speaks the same register protocol as `rhd.c`,
+ * but the transport and the DDR mode are template parameters: there is no
+ * runtime branch on `double_bits` and no call through a function pointer, so
+ * the whole frame path (encode, transfer, decode) compiles into one
+ * specialized loop. The C API is untouched and still used for the cold
+ * configuration path.
+ *
+ * A transport is any class with a member
+ * `int rw(uint16_t *tx, uint16_t *rx, size_t len)` following @ref rhd_rw_t's
+ * semantics. It must accept whole frame bursts.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_HPP
+#define RHD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "rhd.h"
+}
+
+namespace rhd {
+
+/**
+ * @brief Duplicate the bits of an 8-bit value, eg `0b0101 0011` becomes
+ * `0b0011 0011 0000 1111`.
+ */
+constexpr uint16_t duplicate_bits(uint8_t val) {
+  uint32_t x = val;
+  x = (x | (x << 4)) & 0x0F0F;
+  x = (x | (x << 2)) & 0x3333;
+  x = (x | (x << 1)) & 0x5555;
+  return static_cast<uint16_t>(x | (x << 1));
+}
+
+/**
+ * @brief Gather the even bits of a 16-bit word into a byte.
+ */
+constexpr uint8_t compact_bits(uint16_t data) {
+  uint32_t x = data & 0x5555;
+  x = (x | (x >> 1)) & 0x3333;
+  x = (x | (x >> 2)) & 0x0F0F;
+  x = (x | (x >> 4)) & 0x00FF;
+  return static_cast<uint8_t>(x);
+}
+
+/**
+ * @brief Unsplit SPI DDR flip-flopped data, `0bxyxy xyxy xyxy xyxy` into
+ * `a = 0bxxxx xxxx` and `b = 0byyyy yyyy`.
+ */
+inline void unsplit_u16(uint16_t data, uint8_t &a, uint8_t &b) {
+  a = compact_bits(data >> 1);
+  b = compact_bits(data);
+}
+
+/**
+ * @brief Channel whose result is received while converting channel `ch`,
+ * with the same rotation as `rhd2164_sample_all`.
+ */
+constexpr int rx_channel(int ch) { return ch < 2 ? 31 - ch : ch - 2; }
+
+/**
+ * @brief Transport adapter for a plain `rhd_rw_t` function, resolved at
+ * compile time.
+ */
+template <int (*Rw)(uint16_t *, uint16_t *, size_t)> struct FnTransport {
+  int rw(uint16_t *tx, uint16_t *rx, size_t len) { return Rw(tx, rx, len); }
+};
+
+/**
+ * @brief Frame command burst: the 32 CONVERT commands of a RHD2164 frame,
+ * doubled in DDR mode.
+ */
+template <bool Ddr> struct FrameCmds {
+  static constexpr std::size_t len = Ddr ? 64 : 32;
+  uint16_t tx[len];
+
+  constexpr FrameCmds() : tx{} {
+    for (std::size_t ch = 0; ch < 32; ch++) {
+      if (Ddr) {
+        tx[2 * ch] = duplicate_bits(static_cast<uint8_t>(ch));
+        tx[2 * ch + 1] = 0;
+      } else {
+        tx[ch] = static_cast<uint16_t>(ch << 8);
+      }
+    }
+  }
+};
+
+template <class Transport, bool Ddr> class Device {
+public:
+  static constexpr bool double_bits = Ddr;
+
+  explicit Device(Transport &transport) : transport_(transport) {}
+
+  Transport &transport() { return transport_; }
+
+  /**
+   * @brief Send a raw command, see `rhd_send`.
+   */
+  uint8_t send(uint16_t reg, uint16_t val) {
+    if (Ddr) {
+      uint16_t tx[2] = {duplicate_bits(static_cast<uint8_t>(reg)),
+                        duplicate_bits(static_cast<uint8_t>(val))};
+      uint16_t rx[2] = {0};
+      transport_.rw(tx, rx, 2);
+      return compact_bits(rx[1] >> 1);
+    }
+    uint16_t tx = static_cast<uint16_t>((reg << 8) | (val & 0xFF));
+    uint16_t rx[2] = {0};
+    transport_.rw(&tx, rx, 1);
+    return static_cast<uint8_t>(rx[0] & 0xFF);
+  }
+
+  uint8_t r(uint16_t reg) { return send((reg & 0x3F) | 0xC0, 0); }
+
+  uint8_t w(uint16_t reg, uint16_t val) {
+    return send((reg & 0x3F) | 0x80, val);
+  }
+
+  uint8_t read_force(int reg) {
+    r(reg);
+    r(reg);
+    return r(reg);
+  }
+
+  /**
+   * @brief See `rhd_sanity_check`.
+   */
+  int sanity_check() {
+    const char intan[] = "INTAN";
+    for (int i = 0; i < 5; i++) {
+      if (static_cast<char>(read_force(INTAN_0 + i)) != intan[i]) {
+        return INTAN_0 + i;
+      }
+    }
+    return 0;
+  }
+
+  int init() { return sanity_check(); }
+
+  /**
+   * @brief Configure the chip with `rhd_setup`, bridged to this transport.
+   */
+  int setup(float fs, float fl, float fh, bool dsp, float fdsp) {
+    rhd_device_t dev = c_device();
+    return rhd_setup(&dev, fs, fl, fh, dsp, fdsp);
+  }
+
+  /**
+   * @brief C handle driving this device's transport, for the rest of the C
+   * API. Only valid while this device is the last one to call it.
+   */
+  rhd_device_t c_device() {
+    active_ = this;
+    rhd_device_t dev;
+    dev.rw = bridge_rw;
+    dev.double_bits = Ddr;
+    dev.engine = rhd_engine_find(RHD_CHIP_RHD2164, Ddr);
+    return dev;
+  }
+
+  /**
+   * @brief Sample all RHD2164 channels in a single transfer. Same output as
+   * `rhd2164_sample_all`.
+   *
+   * @param sample_buf 64 samples reception buffer
+   * @return int transport return code
+   */
+  int sample_all(uint16_t *sample_buf) {
+    static constexpr FrameCmds<Ddr> cmds{};
+    uint16_t tx[FrameCmds<Ddr>::len];
+    uint16_t rx[64];
+    for (std::size_t i = 0; i < FrameCmds<Ddr>::len; i++) {
+      tx[i] = cmds.tx[i];
+    }
+    int ret = transport_.rw(tx, rx, FrameCmds<Ddr>::len);
+
+    for (int ch = 0; ch < 32; ch++) {
+      const int rx_ch = rx_channel(ch);
+      if (Ddr) {
+        const uint16_t hi = rx[2 * ch];
+        const uint16_t lo = rx[2 * ch + 1];
+        sample_buf[rx_ch] = static_cast<uint16_t>(
+            (compact_bits(hi >> 1) << 8) | compact_bits(lo >> 1) | 1);
+        sample_buf[rx_ch + 32] = static_cast<uint16_t>(
+            (compact_bits(hi) << 8) | compact_bits(lo) | 1);
+      } else {
+        sample_buf[rx_ch] = rx[2 * ch];
+        sample_buf[rx_ch + 32] = rx[2 * ch + 1];
+      }
+    }
+    // Alignment
+    sample_buf[0] &= 0xFFFE;
+    return ret;
+  }
+
+private:
+  static int bridge_rw(uint16_t *tx, uint16_t *rx, size_t len) {
+    return active_->transport_.rw(tx, rx, len);
+  }
+
+  static Device *active_;
+  Transport &transport_;
+};
+
+template <class Transport, bool Ddr>
+Device<Transport, Ddr> *Device<Transport, Ddr>::active_ = nullptr;
+
+} // namespace rhd
+
+#endif /* RHD_HPP */
@@ -0,0 +1,436 @@
+/** @file rhd_batch.c
+ *
+ * @brief Parallel offline processing of recorded sessions.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#define _GNU_SOURCE
+#include "rhd_batch.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Range of chunks dealt to a worker, `[lo, hi)` */
+typedef struct
+{
+  pthread_mutex_t lock;
+  uint32_t lo;
+  uint32_t hi;
+} rhd_batch_deque_t;
+
+typedef struct
+{
+  const rhd_batch_cfg_t *cfg;
+  const rhd_engine_t *eng;
+  int in_fd;
+  int out_fd;
+  /** Words per input frame */
+  size_t frame_words;
+  size_t n_ch;
+  uint16_t flip;
+  uint64_t n_frames;
+  uint32_t chunk_len;
+  /** Frames read before a chunk for the filter's history */
+  uint32_t n_hist;
+  uint32_t n_chunks;
+  int n_threads;
+  rhd_batch_deque_t *deques;
+  uint32_t n_stolen;
+  int err;
+} rhd_batch_job_t;
+
+typedef struct
+{
+  rhd_batch_job_t *job;
+  int id;
+  pthread_t thread;
+  /** Input words, `[n_hist + chunk_len][frame_words]` */
+  uint16_t *raw;
+  /** Converted frames, `[n_hist + chunk_len][n_ch]` */
+  float *x;
+  /** Filtered frames, `[chunk_len][n_ch]` */
+  float *y;
+  /** RMS windows, `[chunk_len / feat_win][n_ch]` */
+  float *feat;
+} rhd_batch_worker_t;
+
+void rhd_batch_default_cfg(rhd_batch_cfg_t *cfg)
+{
+  cfg->input = RHD_BATCH_FRAMES;
+  cfg->n_ch = 64;
+  cfg->chip_id = RHD_CHIP_RHD2164;
+  cfg->double_bits = true;
+  cfg->twos_comp = true;
+  cfg->scale = RHD_ADC_STEP * 1e6;
+  cfg->taps = NULL;
+  cfg->n_taps = 0;
+  cfg->feat_win = 0;
+  cfg->chunk_len = 16384;
+  cfg->n_threads = 0;
+}
+
+int rhd_batch_fir_bandpass(float *taps, size_t n_taps, float fs, float fl,
+                           float fh)
+{
+  if (n_taps == 0 || n_taps > RHD_BATCH_MAX_TAPS || fs <= 0 || fl < 0 ||
+      fl >= fh || fh > fs / 2 || (fh == fs / 2 && n_taps % 2 == 0))
+  {
+    return -1;
+  }
+
+  // Difference of 2 ideal low-passes, a delta at fs / 2
+  const double wh = 2.0 * fh / fs;
+  const double wl = 2.0 * fl / fs;
+  const double mid = (n_taps - 1) / 2.0;
+  for (size_t i = 0; i < n_taps; i++)
+  {
+    double m = i - mid;
+    double h = m == 0 ? wh - wl
+                      : (sin(M_PI * wh * m) - sin(M_PI * wl * m)) / (M_PI * m);
+    double win = n_taps > 1 ? 0.54 - 0.46 * cos(2 * M_PI * i / (n_taps - 1))
+                            : 1.0;
+    taps[i] = (float)(h * win);
+  }
+  return 0;
+}
+
+/**
+ * @brief Read or write a whole range, resuming short transfers.
+ *
+ * @return int 0 for success, -1 on failure or end of file
+ */
+static int rhd_batch_pio(int fd, void *buf, size_t len, uint64_t off,
+                         bool write)
+{
+  uint8_t *p = buf;
+  while (len > 0)
+  {
+    ssize_t r = write ? pwrite(fd, p, len, off) : pread(fd, p, len, off);
+    if (r < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (r <= 0)
+    {
+      return -1;
+    }
+    p += r;
+    len -= r;
+    off += r;
+  }
+  return 0;
+}
+
+/**
+ * @brief Take a chunk, from the worker's own range first, then from the end
+ * of the others'.
+ *
+ * @return int64_t chunk index, -1 once every chunk is taken
+ */
+static int64_t rhd_batch_next(rhd_batch_job_t *job, int id)
+{
+  for (int i = 0; i < job->n_threads; i++)
+  {
+    rhd_batch_deque_t *d = &job->deques[(id + i) % job->n_threads];
+    int64_t k = -1;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->lo < d->hi)
+    {
+      k = i == 0 ? d->lo++ : --d->hi;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    if (k >= 0)
+    {
+      if (i > 0)
+      {
+        __atomic_fetch_add(&job->n_stolen, 1, __ATOMIC_RELAXED);
+      }
+      return k;
+    }
+  }
+  return -1;
+}
+
+static int rhd_batch_chunk(rhd_batch_worker_t *w, uint32_t k)
+{
+  const rhd_batch_job_t *job = w->job;
+  const rhd_batch_cfg_t *cfg = job->cfg;
+  const size_t n_ch = job->n_ch;
+  const uint64_t start = (uint64_t)k * job->chunk_len;
+  const uint64_t end = start + job->chunk_len < job->n_frames
+                           ? start + job->chunk_len
+                           : job->n_frames;
+  const size_t len = end - start;
+
+  // Frames before the recording are zeros, as in a serial run
+  const uint64_t first = start > job->n_hist ? start - job->n_hist : 0;
+  const size_t n_pad = job->n_hist - (start - first);
+  const size_t n_in = end - first;
+  const size_t frame_bytes = job->frame_words * sizeof(uint16_t);
+
+  if (rhd_batch_pio(job->in_fd, w->raw, n_in * frame_bytes,
+                    first * frame_bytes, false) != 0)
+  {
+    return -1;
+  }
+
+  memset(w->x, 0, n_pad * n_ch * sizeof(float));
+  for (size_t i = 0; i < n_in; i++)
+  {
+    const uint16_t *src = &w->raw[i * job->frame_words];
+    uint16_t frame[RHD_BATCH_MAX_CH];
+    float *dst = &w->x[(n_pad + i) * n_ch];
+
+    if (job->eng != NULL)
+    {
+      rhd_engine_decode(job->eng, src, frame);
+      src = frame;
+    }
+    for (size_t c = 0; c < n_ch; c++)
+    {
+      dst[c] = (int16_t)(src[c] ^ job->flip) * cfg->scale;
+    }
+  }
+
+  // Same accumulation order for every output whatever the chunking
+  const float *y = &w->x[job->n_hist * n_ch];
+  if (cfg->taps != NULL)
+  {
+    for (size_t t = 0; t < len; t++)
+    {
+      float *yt = &w->y[t * n_ch];
+      memset(yt, 0, n_ch * sizeof(float));
+      for (size_t j = 0; j < cfg->n_taps; j++)
+      {
+        const float h = cfg->taps[j];
+        const float *xt = &w->x[(t + job->n_hist - j) * n_ch];
+        for (size_t c = 0; c < n_ch; c++)
+        {
+          yt[c] += h * xt[c];
+        }
+      }
+    }
+    y = w->y;
+  }
+
+  const size_t row_bytes = n_ch * sizeof(float);
+  if (cfg->feat_win == 0)
+  {
+    return rhd_batch_pio(job->out_fd, (void *)y, len * row_bytes,
+                         start * row_bytes, true);
+  }
+
+  const size_t n_win = len / cfg->feat_win;
+  for (size_t i = 0; i < n_win; i++)
+  {
+    float *acc = &w->feat[i * n_ch];
+    memset(acc, 0, row_bytes);
+    for (uint32_t t = 0; t < cfg->feat_win; t++)
+    {
+      const float *yt = &y[(i * cfg->feat_win + t) * n_ch];
+      for (size_t c = 0; c < n_ch; c++)
+      {
+        acc[c] += yt[c] * yt[c];
+      }
+    }
+    for (size_t c = 0; c < n_ch; c++)
+    {
+      acc[c] = sqrtf(acc[c] / cfg->feat_win);
+    }
+  }
+  return rhd_batch_pio(job->out_fd, w->feat, n_win * row_bytes,
+                       start / cfg->feat_win * row_bytes, true);
+}
+
+static void *rhd_batch_worker(void *arg)
+{
+  rhd_batch_worker_t *w = arg;
+  rhd_batch_job_t *job = w->job;
+  int64_t k;
+
+  while (!__atomic_load_n(&job->err, __ATOMIC_RELAXED) &&
+         (k = rhd_batch_next(job, w->id)) >= 0)
+  {
+    if (rhd_batch_chunk(w, k) != 0)
+    {
+      __atomic_store_n(&job->err, -1, __ATOMIC_RELAXED);
+    }
+  }
+  return NULL;
+}
+
+int rhd_batch_run(const rhd_batch_cfg_t *cfg, int in_fd, int out_fd,
+                  rhd_batch_stats_t *stats)
+{
+  rhd_batch_job_t job;
+  struct stat st;
+
+  memset(&job, 0, sizeof(job));
+  job.cfg = cfg;
+  job.in_fd = in_fd;
+  job.out_fd = out_fd;
+  job.flip = cfg->twos_comp ? 0 : 0x8000;
+
+  if (cfg->input == RHD_BATCH_RAW)
+  {
+    job.eng = rhd_engine_find(cfg->chip_id, cfg->double_bits);
+    if (job.eng == NULL)
+    {
+      return -1;
+    }
+    job.frame_words = job.eng->n_rx;
+    job.n_ch = job.eng->n_amp;
+  }
+  else
+  {
+    job.frame_words = cfg->n_ch;
+    job.n_ch = cfg->n_ch;
+  }
+  if (job.n_ch == 0 || job.n_ch > RHD_BATCH_MAX_CH || cfg->chunk_len == 0 ||
+      (cfg->taps != NULL &&
+       (cfg->n_taps == 0 || cfg->n_taps > RHD_BATCH_MAX_TAPS)))
+  {
+    return -1;
+  }
+  if (fstat(in_fd, &st) != 0)
+  {
+    return -1;
+  }
+
+  job.n_frames = st.st_size / (job.frame_words * sizeof(uint16_t));
+  job.n_hist = cfg->taps != NULL ? cfg->n_taps - 1 : 0;
+  job.chunk_len = cfg->chunk_len;
+  if (cfg->feat_win > 0 && job.chunk_len % cfg->feat_win != 0)
+  {
+    job.chunk_len += cfg->feat_win - job.chunk_len % cfg->feat_win;
+  }
+  job.n_chunks = (job.n_frames + job.chunk_len - 1) / job.chunk_len;
+  job.n_threads = cfg->n_threads > 0 ? cfg->n_threads
+                                     : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (job.n_threads > (int)job.n_chunks)
+  {
+    job.n_threads = job.n_chunks;
+  }
+  if (job.n_threads < 1)
+  {
+    job.n_threads = 1;
+  }
+
+  const uint64_t n_out =
+      cfg->feat_win > 0 ? job.n_frames / cfg->feat_win : job.n_frames;
+  if (stats != NULL)
+  {
+    stats->n_frames = job.n_frames;
+    stats->n_out = n_out;
+    stats->n_ch = job.n_ch;
+    stats->n_chunks = job.n_chunks;
+    stats->n_stolen = 0;
+    stats->n_threads = job.n_threads;
+  }
+  if (ftruncate(out_fd, n_out * job.n_ch * sizeof(float)) != 0)
+  {
+    return -1;
+  }
+  if (job.n_chunks == 0)
+  {
+    return 0;
+  }
+
+  rhd_batch_worker_t *workers = calloc(job.n_threads, sizeof(*workers));
+  job.deques = calloc(job.n_threads, sizeof(*job.deques));
+  int ret = workers != NULL && job.deques != NULL ? 0 : -1;
+
+  const size_t n_rows = (size_t)job.n_hist + job.chunk_len;
+  int n_init = 0;
+  for (int i = 0; ret == 0 && i < job.n_threads; i++, n_init++)
+  {
+    rhd_batch_worker_t *w = &workers[i];
+    w->job = &job;
+    w->id = i;
+    w->raw = malloc(n_rows * job.frame_words * sizeof(uint16_t));
+    w->x = malloc(n_rows * job.n_ch * sizeof(float));
+    w->y = malloc((size_t)job.chunk_len * job.n_ch * sizeof(float));
+    w->feat = cfg->feat_win > 0 ? malloc((size_t)job.chunk_len /
+                                         cfg->feat_win * job.n_ch *
+                                         sizeof(float))
+                                : NULL;
+    if (w->raw == NULL || w->x == NULL || w->y == NULL ||
+        (cfg->feat_win > 0 && w->feat == NULL))
+    {
+      ret = -1;
+    }
+
+    // Contiguous ranges keep each worker's reads sequential
+    pthread_mutex_init(&job.deques[i].lock, NULL);
+    job.deques[i].lo = (uint64_t)job.n_chunks * i / job.n_threads;
+    job.deques[i].hi = (uint64_t)job.n_chunks * (i + 1) / job.n_threads;
+  }
+
+  int n_started = 0;
+  for (int i = 0; ret == 0 && i < job.n_threads; i++)
+  {
+    if (pthread_create(&workers[i].thread, NULL, rhd_batch_worker,
+                       &workers[i]) != 0)
+    {
+      __atomic_store_n(&job.err, -1, __ATOMIC_RELAXED);
+      break;
+    }
+    n_started++;
+  }
+  for (int i = 0; i < n_started; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+  }
+  if (job.err != 0)
+  {
+    ret = -1;
+  }
+  if (stats != NULL)
+  {
+    stats->n_stolen = job.n_stolen;
+  }
+
+  for (int i = 0; i < n_init; i++)
+  {
+    free(workers[i].raw);
+    free(workers[i].x);
+    free(workers[i].y);
+    free(workers[i].feat);
+    pthread_mutex_destroy(&job.deques[i].lock);
+  }
+  free(workers);
+  free(job.deques);
+  return ret;
+}
+
+int rhd_batch_file(const rhd_batch_cfg_t *cfg, const char *in_path,
+                   const char *out_path, rhd_batch_stats_t *stats)
+{
+  int in_fd = open(in_path, O_RDONLY);
+  if (in_fd < 0)
+  {
+    return -1;
+  }
+  int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (out_fd < 0)
+  {
+    close(in_fd);
+    return -1;
+  }
+
+  int ret = rhd_batch_run(cfg, in_fd, out_fd, stats);
+  close(in_fd);
+  if (close(out_fd) != 0)
+  {
+    ret = -1;
+  }
+  return ret;
+}
@@ -0,0 +1,125 @@
+/** @file rhd_batch.h
+ *
+ * @brief Parallel offline processing of recorded sessions.
+ *
+ * A recording is split in chunks of frames which a pool of worker threads
+ * decodes, converts to physical units, filters with a FIR and optionally
+ * reduces to RMS features. Each chunk also reads the `n_taps - 1` frames
+ * before it, so the filter starts from the same history as in a serial run:
+ * the output is bit-identical whatever the number of threads or the chunk
+ * length. Results are written at their offset in the output file as soon as
+ * their chunk is done, so memory only depends on the chunk length.
+ *
+ * Output columns follow the input's channel order. `RHD_BATCH_FRAMES` keeps
+ * the frames' order, so frames from `rhd2164_sample_all` keep channels 30
+ * and 31 (62 and 63) swapped. `RHD_BATCH_RAW` decodes to the order of
+ * `rhd_sample_all`, channel `c` in column `c`.
+ *
+ * Chunks are dealt to the workers in contiguous ranges. A worker that
+ * exhausts its range steals the last chunk of another one's, which keeps
+ * every core busy when chunks take uneven time (eg page cache misses).
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_BATCH_H
+#define RHD_BATCH_H
+
+#include "rhd.h"
+
+#define RHD_BATCH_MAX_CH 64
+#define RHD_BATCH_MAX_TAPS 1024
+
+typedef enum
+{
+  /** `n_ch` samples per frame, eg from `rhd_sample_all`, output in the same
+   * order */
+  RHD_BATCH_FRAMES = 0,
+  /** `n_rx` words per frame as received by `rw`, see `rhd_engine_decode`,
+   * output in the order of `rhd_sample_all` */
+  RHD_BATCH_RAW = 1,
+} rhd_batch_input_t;
+
+typedef struct
+{
+  rhd_batch_input_t input;
+  /** Channels per frame of `RHD_BATCH_FRAMES` input */
+  size_t n_ch;
+  /** Chip of `RHD_BATCH_RAW` input, see `rhd_engine_find` */
+  uint8_t chip_id;
+  /** SPI mode of `RHD_BATCH_RAW` input */
+  bool double_bits;
+  /** True if samples are two's complement, see `rhd_cfg_dsp` */
+  bool twos_comp;
+  /** Output units per ADC step, eg `RHD_ADC_STEP * 1e6` for uV */
+  float scale;
+  /** FIR taps applied to every channel, NULL for none */
+  const float *taps;
+  /** Number of taps, at most `RHD_BATCH_MAX_TAPS` */
+  size_t n_taps;
+  /** RMS window [frames], 0 to output the filtered frames */
+  uint32_t feat_win;
+  /** Frames per chunk, rounded up to a multiple of `feat_win` */
+  uint32_t chunk_len;
+  /** Worker threads, 0 for one per online core */
+  int n_threads;
+} rhd_batch_cfg_t;
+
+typedef struct
+{
+  /** Input frames, a trailing partial frame is ignored */
+  uint64_t n_frames;
+  /** Output rows of `n_ch` floats: frames, or complete RMS windows */
+  uint64_t n_out;
+  size_t n_ch;
+  uint32_t n_chunks;
+  /** Chunks processed by another worker than the one they were dealt to */
+  uint32_t n_stolen;
+  int n_threads;
+} rhd_batch_stats_t;
+
+/**
+ * @brief Sensible defaults: 64-channel two's complement frames converted to
+ * uV, no filter, no features, chunks of 16384 frames on every core.
+ *
+ * @param cfg configuration to fill
+ */
+void rhd_batch_default_cfg(rhd_batch_cfg_t *cfg);
+
+/**
+ * @brief Design a linear-phase band-pass FIR (Hamming-windowed sinc).
+ *
+ * @param taps `n_taps` taps to fill
+ * @param n_taps number of taps, odd for a high-pass
+ * @param fs frame rate [Hz]
+ * @param fl lower cutoff [Hz], 0 for a low-pass
+ * @param fh upper cutoff [Hz], `fs / 2` for a high-pass
+ * @return int 0 for success, -1 for invalid cutoffs or length
+ */
+int rhd_batch_fir_bandpass(float *taps, size_t n_taps, float fs, float fl,
+                           float fh);
+
+/**
+ * @brief Process a recording.
+ *
+ * The output holds `n_out` rows of `n_ch` native floats.
+ *
+ * @param cfg processing configuration
+ * @param in_fd recording, native 16-bit words, read with `pread`
+ * @param out_fd output, written with `pwrite` and truncated to its size
+ * @param stats filled with the run's figures, can be NULL
+ * @return int 0 for success, -1 for an invalid configuration, an allocation
+ * or an I/O failure
+ */
+int rhd_batch_run(const rhd_batch_cfg_t *cfg, int in_fd, int out_fd,
+                  rhd_batch_stats_t *stats);
+
+/**
+ * @brief @ref rhd_batch_run between two files, the output being created or
+ * overwritten.
+ */
+int rhd_batch_file(const rhd_batch_cfg_t *cfg, const char *in_path,
+                   const char *out_path, rhd_batch_stats_t *stats);
+
+#endif /* RHD_BATCH_H */
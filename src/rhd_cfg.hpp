@@ -0,0 +1,328 @@
+/** @file rhd_cfg.hpp
+ *
+ * @brief Compile-time register image and setup command stream.
+ *
+ * `rhd_setup` searches float lookup tables every time a chip is configured,
+ * which pulls soft-float code into MCU builds. For a fixed configuration,
+ * `rhd::reg_image` computes the same register values at compile time, and
+ * `rhd::setup_cmds` turns them into the exact command stream `rhd_setup`
+ * sends, DDR-doubled if needed. Startup is then a single burst:
+ *
+ * ```cpp
+ * constexpr auto img = rhd::reg_image(1000, 20, 500, true, 20);
+ * constexpr auto cmds = rhd::setup_cmds<true>(img);
+ * rhd::setup(&dev, cmds);
+ * ```
+ *
+ * Results must be assigned to `constexpr` variables: a frequency outside the
+ * lookup tables then fails compilation, the diagnostic pointing at
+ * `rhd::cfg_error` and its message.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_CFG_HPP
+#define RHD_CFG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "rhd.hpp"
+
+namespace rhd {
+
+/**
+ * @brief Configuration error. Not `constexpr`, so reaching it while
+ * evaluating a constant expression is a compilation error.
+ */
+[[noreturn]] inline void cfg_error(const char *msg) {
+  (void)msg;
+  std::abort();
+}
+
+namespace detail {
+
+// Same tables as rhd.c
+constexpr int msps_lut[9] = {120000, 140000, 175000, 220000, 280000,
+                             350000, 440000, 525000, 700000};
+constexpr int adc_buf_bias_lut[9] = {32, 16, 8, 8, 8, 4, 3, 3, 2};
+constexpr int mux_bias_lut[9] = {40, 40, 40, 32, 26, 18, 16, 7, 4};
+
+constexpr int fh_lut[17] = {20000, 15000, 10000, 7500, 5000, 3000,
+                            2500,  2000,  1500,  1000, 750,  500,
+                            300,   250,   200,   150,  100};
+constexpr int rh1_dac1_lut[17] = {8,  11, 17, 22, 33, 3,  13, 27, 1,
+                                  46, 41, 30, 6,  42, 24, 44, 38};
+constexpr int rh1_dac2_lut[17] = {0, 0, 0, 0, 0,  1,  1,  1, 2,
+                                  2, 3, 5, 9, 10, 13, 17, 26};
+constexpr int rh2_dac1_lut[17] = {4,  8,  16, 23, 37, 13, 25, 44, 23,
+                                  30, 36, 43, 2,  5,  7,  8,  5};
+constexpr int rh2_dac2_lut[17] = {0, 0, 0, 0,  0,  1,  1,  1, 2,
+                                  3, 4, 6, 11, 13, 16, 21, 31};
+
+constexpr float fl_lut[25] = {0.1, 0.25, 0.3, 0.5, 0.75, 1.0, 1.5,
+                              2.0, 2.5,  3.0, 5.0, 7.5,  10,  15,
+                              20,  25,   30,  50,  75,   100, 150,
+                              200, 250,  300, 500};
+constexpr int rl_dac1_lut[25] = {16, 56, 1,  35, 49, 44, 9,  8,  42,
+                                 20, 40, 18, 5,  62, 54, 48, 44, 34,
+                                 28, 25, 21, 18, 17, 15, 13};
+constexpr int rl_dac2_lut[25] = {60, 54, 40, 17, 9, 6, 4, 3, 2, 2, 1, 1, 1,
+                                 0,  0,  0,  0,  0, 0, 0, 0, 0, 0, 0, 0};
+constexpr int rl_dac3_lut[25] = {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+constexpr double k_lut[16] = {0.99,      0.1103,     0.04579,    0.02125,
+                              0.01027,   0.005053,   0.002506,   0.001248,
+                              0.0006229, 0.0003112,  0.0001555,  0.00007773,
+                              0.00003886, 0.00001943, 0.000009714,
+                              0.000004857};
+
+} // namespace detail
+
+/**
+ * @brief `rhd_cfg_fs` table index. Same float arithmetic as the runtime
+ * search, so both pick the same entry.
+ */
+constexpr int fs_index(float fs, int n_ch) {
+  const float msps = fs * n_ch;
+  if (!(fs > 0) || msps > detail::msps_lut[8]) {
+    cfg_error("fs: aggregate sample rate above 700 kS/s");
+  }
+  int i_lut = 0;
+  for (int i = 0; i < 9; i++) {
+    if (msps <= detail::msps_lut[i]) {
+      break;
+    }
+    i_lut = i;
+  }
+  return i_lut;
+}
+
+/**
+ * @brief `rhd_cfg_amp_bw` upper cutoff table index.
+ */
+constexpr int fh_index(float fh) {
+  if (!(fh >= detail::fh_lut[16]) || fh > detail::fh_lut[0]) {
+    cfg_error("fh: upper cutoff outside [100, 20000] Hz");
+  }
+  int i_fh = 0;
+  while (!(fh >= detail::fh_lut[i_fh])) {
+    i_fh++;
+  }
+  return i_fh;
+}
+
+/**
+ * @brief `rhd_cfg_amp_bw` lower cutoff table index.
+ */
+constexpr int fl_index(float fl) {
+  if (!(fl >= detail::fl_lut[0]) || fl > detail::fl_lut[24]) {
+    cfg_error("fl: lower cutoff outside [0.1, 500] Hz");
+  }
+  int i_fl = 0;
+  while (!(fl <= detail::fl_lut[i_fl])) {
+    i_fl++;
+  }
+  return i_fl;
+}
+
+/**
+ * @brief `rhd_cfg_dsp` cutoff setting, 0 when the DSP is disabled.
+ */
+constexpr int dsp_index(bool dsp, float fdsp, float fs) {
+  if (!dsp) {
+    return 0;
+  }
+  const float k = fdsp / fs;
+  if (!(k <= detail::k_lut[0]) || !(k > detail::k_lut[15])) {
+    cfg_error("fdsp: DSP cutoff outside the 0.99 to 4.857e-6 fs range");
+  }
+  int dsp_val = 0;
+  while (!(k > detail::k_lut[dsp_val])) {
+    dsp_val++;
+  }
+  return dsp_val;
+}
+
+/**
+ * @brief Values of the writable registers, 0 to 21.
+ */
+struct RegImage {
+  static constexpr std::size_t n_regs = 22;
+  uint8_t regs[n_regs];
+
+  constexpr RegImage() : regs{} {}
+
+  constexpr uint8_t operator[](std::size_t reg) const { return regs[reg]; }
+};
+
+/**
+ * @brief Register image written by `rhd_setup` and the `rhd_cfg_*`
+ * functions, with every enabled amplifier set in the channel masks.
+ *
+ * @param fs sampling frequency per channel [Hz]
+ * @param fl amplifier lower cutoff [Hz], 0.1 to 500
+ * @param fh amplifier upper cutoff [Hz], 100 to 20000
+ * @param dsp enable the DSP offset removal
+ * @param fdsp DSP cutoff [Hz]
+ * @param channels_l amplifiers 0 to 31 power, see `rhd_cfg_ch`
+ * @param channels_h amplifiers 32 to 63 power
+ * @param n_cmds CONVERT commands per frame, the chip's `rhd_engine_t::n_cmds`:
+ * 16 for RHD2216, 32 otherwise
+ */
+constexpr RegImage reg_image(float fs, float fl, float fh, bool dsp,
+                             float fdsp, uint32_t channels_l = 0xFFFFFFFF,
+                             uint32_t channels_h = 0xFFFFFFFF,
+                             int n_cmds = 32) {
+  RegImage img;
+  const int i_fs = fs_index(fs, n_cmds);
+  const int i_fh = fh_index(fh);
+  const int i_fl = fl_index(fl);
+
+  img.regs[ADC_CFG] = 0b11011110;
+  img.regs[SUPPLY_SENS_ADC_BUF_BIAS] =
+      static_cast<uint8_t>(detail::adc_buf_bias_lut[i_fs]);
+  img.regs[MUX_BIAS_CURR] = static_cast<uint8_t>(detail::mux_bias_lut[i_fs]);
+  img.regs[MUX_LOAD_TEMP_SENS_AUX_DIG_OUT] = 0;
+  // Two's complement, no absolute mode
+  img.regs[ADC_OUT_FMT_DPS_OFF_RMVL] = static_cast<uint8_t>(
+      (1 << 7) | (1 << 6) | (static_cast<int>(dsp) << 4) |
+      dsp_index(dsp, fdsp, fs));
+  img.regs[IMP_CHK_CTRL] = 0;
+  img.regs[IMP_CHK_DAC] = 0;
+  img.regs[IMP_CHK_AMP_SEL] = 0;
+  img.regs[AMP_BW_SEL_0] = static_cast<uint8_t>(detail::rh1_dac1_lut[i_fh]);
+  img.regs[AMP_BW_SEL_1] = static_cast<uint8_t>(detail::rh1_dac2_lut[i_fh]);
+  img.regs[AMP_BW_SEL_2] = static_cast<uint8_t>(detail::rh2_dac1_lut[i_fh]);
+  img.regs[AMP_BW_SEL_3] = static_cast<uint8_t>(detail::rh2_dac2_lut[i_fh]);
+  img.regs[AMP_BW_SEL_4] = static_cast<uint8_t>(detail::rl_dac1_lut[i_fl]);
+  img.regs[AMP_BW_SEL_5] = static_cast<uint8_t>(
+      (detail::rl_dac3_lut[i_fl] << 6) | detail::rl_dac2_lut[i_fl]);
+  for (int i = 0; i < 4; i++) {
+    img.regs[IND_AMP_PWR_0 + i] =
+        static_cast<uint8_t>((channels_l >> (8 * i)) & 0xFF);
+    img.regs[IND_AMP_PWR_4 + i] =
+        static_cast<uint8_t>((channels_h >> (8 * i)) & 0xFF);
+  }
+  return img;
+}
+
+/**
+ * @brief `rhd_setup`'s command stream, excluding the final sanity check,
+ * ready to send in one `rw` call.
+ */
+template <bool Ddr> struct SetupCmds {
+  /** 2 dummy reads, 22 writes, CALIBRATE and 9 dummy reads */
+  static constexpr std::size_t n_cmds = 34;
+  static constexpr std::size_t len = Ddr ? 2 * n_cmds : n_cmds;
+  uint16_t tx[len];
+
+  constexpr SetupCmds() : tx{} {}
+};
+
+namespace detail {
+
+template <bool Ddr>
+constexpr std::size_t put_cmd(SetupCmds<Ddr> &cmds, std::size_t i,
+                              uint16_t cmd) {
+  if (Ddr) {
+    cmds.tx[2 * i] = duplicate_bits(static_cast<uint8_t>(cmd >> 8));
+    cmds.tx[2 * i + 1] = duplicate_bits(static_cast<uint8_t>(cmd & 0xFF));
+  } else {
+    cmds.tx[i] = cmd;
+  }
+  return i + 1;
+}
+
+constexpr uint16_t read_cmd(int reg) {
+  return static_cast<uint16_t>(((reg & 0x3F) | 0xC0) << 8);
+}
+
+constexpr uint16_t write_cmd(int reg, uint8_t val) {
+  return static_cast<uint16_t>((((reg & 0x3F) | 0x80) << 8) | val);
+}
+
+} // namespace detail
+
+/**
+ * @brief Command stream writing `img` in `rhd_setup`'s order, then
+ * calibrating.
+ */
+template <bool Ddr> constexpr SetupCmds<Ddr> setup_cmds(const RegImage &img) {
+  // rhd_setup, then rhd_cfg_fs, rhd_cfg_dsp, rhd_cfg_ch and rhd_cfg_amp_bw
+  constexpr int order[22] = {
+      ADC_CFG,         MUX_LOAD_TEMP_SENS_AUX_DIG_OUT,
+      IMP_CHK_CTRL,    IMP_CHK_DAC,
+      IMP_CHK_AMP_SEL, SUPPLY_SENS_ADC_BUF_BIAS,
+      MUX_BIAS_CURR,   ADC_OUT_FMT_DPS_OFF_RMVL,
+      IND_AMP_PWR_0,   IND_AMP_PWR_1,
+      IND_AMP_PWR_2,   IND_AMP_PWR_3,
+      IND_AMP_PWR_4,   IND_AMP_PWR_5,
+      IND_AMP_PWR_6,   IND_AMP_PWR_7,
+      AMP_BW_SEL_0,    AMP_BW_SEL_1,
+      AMP_BW_SEL_2,    AMP_BW_SEL_3,
+      AMP_BW_SEL_4,    AMP_BW_SEL_5};
+
+  SetupCmds<Ddr> cmds;
+  std::size_t i = 0;
+  i = detail::put_cmd(cmds, i, detail::read_cmd(CHIP_ID));
+  i = detail::put_cmd(cmds, i, detail::read_cmd(CHIP_ID));
+  for (int reg : order) {
+    i = detail::put_cmd(cmds, i, detail::write_cmd(reg, img[reg]));
+  }
+  i = detail::put_cmd(cmds, i, static_cast<uint16_t>(0b01010101 << 8));
+  while (i < SetupCmds<Ddr>::n_cmds) {
+    i = detail::put_cmd(cmds, i, detail::read_cmd(CHIP_ID));
+  }
+  return cmds;
+}
+
+/**
+ * @brief Send a compiled setup through the C API handle, then run
+ * `rhd_sanity_check`.
+ *
+ * @param dev pointer to rhd_device_t instance, in the same DDR mode
+ * @param cmds command stream from @ref setup_cmds
+ * @return int `rhd_setup` return code, -1 on DDR mode mismatch or transport
+ * failure
+ */
+template <bool Ddr>
+int setup(rhd_device_t *dev, const SetupCmds<Ddr> &cmds) {
+  if (dev->double_bits != Ddr) {
+    return -1;
+  }
+  uint16_t tx[SetupCmds<Ddr>::len];
+  // Flip-flop transports return 2 words per command
+  uint16_t rx[2 * SetupCmds<Ddr>::n_cmds];
+  for (std::size_t i = 0; i < SetupCmds<Ddr>::len; i++) {
+    tx[i] = cmds.tx[i];
+  }
+  if (dev->rw(tx, rx, SetupCmds<Ddr>::len) < 0) {
+    return -1;
+  }
+  return rhd_sanity_check(dev);
+}
+
+/**
+ * @brief Send a compiled setup through a `Device`'s transport, then run its
+ * sanity check.
+ */
+template <class Transport, bool Ddr>
+int setup(Device<Transport, Ddr> &dev, const SetupCmds<Ddr> &cmds) {
+  uint16_t tx[SetupCmds<Ddr>::len];
+  uint16_t rx[2 * SetupCmds<Ddr>::n_cmds];
+  for (std::size_t i = 0; i < SetupCmds<Ddr>::len; i++) {
+    tx[i] = cmds.tx[i];
+  }
+  if (dev.transport().rw(tx, rx, SetupCmds<Ddr>::len) < 0) {
+    return -1;
+  }
+  return dev.sanity_check();
+}
+
+} // namespace rhd
+
+#endif /* RHD_CFG_HPP */
@@ -0,0 +1,192 @@
+/** @file rhd_event.c
+ *
+ * @brief Streaming threshold-crossing event detector.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_event.h"
+#include <math.h>
+#include <string.h>
+
+/** Median absolute value of a unit normal distribution */
+#define RHD_EVENT_MAD_SCALE 0.6745f
+
+void rhd_event_default_cfg(rhd_event_cfg_t *cfg)
+{
+  cfg->n_ch = 64;
+  cfg->twos_comp = true;
+  cfg->noise = RHD_EVENT_RMS;
+  cfg->polarity = RHD_EVENT_BOTH;
+  cfg->k = 5;
+  cfg->tau = 20000;
+  cfg->warmup = 20000;
+  cfg->refractory = 20;
+  cfg->snip_len = 0;
+  cfg->snip_pre = 0;
+}
+
+int rhd_event_init(rhd_event_det_t *det, const rhd_event_cfg_t *cfg)
+{
+  if (cfg->n_ch == 0 || cfg->n_ch > RHD_EVENT_MAX_CH || cfg->refractory == 0 ||
+      cfg->refractory > 65536 || !(cfg->k > 0) || !(cfg->tau >= 1) ||
+      cfg->snip_len > RHD_EVENT_MAX_SNIP)
+  {
+    return -1;
+  }
+  if (cfg->snip_len > 0 && (cfg->snip_pre >= cfg->snip_len ||
+                            cfg->snip_len - cfg->snip_pre > cfg->refractory))
+  {
+    return -1;
+  }
+
+  memset(det, 0, sizeof(*det));
+  det->cfg = *cfg;
+  det->flip = cfg->twos_comp ? 0 : 0x8000;
+  det->alpha = 1.0f / cfg->tau;
+  det->k2 = cfg->k * cfg->k;
+  if (cfg->noise == RHD_EVENT_MAD)
+  {
+    det->k2 /= RHD_EVENT_MAD_SCALE * RHD_EVENT_MAD_SCALE;
+  }
+  return 0;
+}
+
+float rhd_event_noise(const rhd_event_det_t *det, int ch)
+{
+  if (det->cfg.noise == RHD_EVENT_MAD)
+  {
+    return det->noise[ch] / RHD_EVENT_MAD_SCALE;
+  }
+  return sqrtf(det->noise[ch]);
+}
+
+size_t rhd_event_process(rhd_event_det_t *det, const uint16_t *sample_buf,
+                         rhd_event_t *events, int16_t *snippets,
+                         size_t max_events)
+{
+  const rhd_event_cfg_t *cfg = &det->cfg;
+  const size_t n_ch = cfg->n_ch;
+  const uint64_t n = det->n_frames;
+  const float w_abs = cfg->polarity == RHD_EVENT_BOTH ? 1.0f : 0.0f;
+  const float w_sgn = cfg->polarity == RHD_EVENT_POS   ? 1.0f
+                      : cfg->polarity == RHD_EVENT_NEG ? -1.0f
+                                                       : 0.0f;
+  const bool ready = n >= cfg->warmup;
+  // Cumulative average at first, so the estimates settle within a few tau
+  const float alpha = n + 1 < cfg->tau ? 1.0f / (n + 1) : det->alpha;
+  int16_t *hist = det->hist[n & (RHD_EVENT_MAX_SNIP - 1)];
+  float x[RHD_EVENT_MAX_CH];
+  float m[RHD_EVENT_MAX_CH];
+  uint8_t hit[RHD_EVENT_MAX_CH];
+
+  // Branch-free over the channels
+  for (size_t c = 0; c < n_ch; c++)
+  {
+    int16_t v = (int16_t)(sample_buf[c] ^ det->flip);
+    hist[c] = v;
+    x[c] = v;
+    m[c] = fabsf(x[c]) * w_abs + x[c] * w_sgn;
+  }
+  for (size_t c = 0; c < n_ch; c++)
+  {
+    hit[c] = ready & (det->refr[c] == 0) & (m[c] > 0) &
+             (m[c] * m[c] > det->thr2[c]);
+  }
+  // Noise estimates are frozen during events
+  if (cfg->noise == RHD_EVENT_MAD)
+  {
+    for (size_t c = 0; c < n_ch; c++)
+    {
+      float g = (float)((det->refr[c] == 0) & !hit[c]) * alpha;
+      float a = fabsf(x[c]);
+      float s = (float)(a > det->noise[c]) - (float)(a < det->noise[c]);
+      // Relative steps, +1 so the estimate can leave 0
+      det->noise[c] += g * s * (det->noise[c] + 1.0f);
+      det->thr2[c] = det->k2 * det->noise[c] * det->noise[c];
+    }
+  }
+  else
+  {
+    for (size_t c = 0; c < n_ch; c++)
+    {
+      float g = (float)((det->refr[c] == 0) & !hit[c]) * alpha;
+      det->noise[c] += g * (x[c] * x[c] - det->noise[c]);
+      det->thr2[c] = det->k2 * det->noise[c];
+    }
+  }
+
+  uint64_t cross = 0;
+  for (size_t c = 0; c < n_ch; c++)
+  {
+    cross |= (uint64_t)hit[c] << c;
+  }
+
+  // Channels in an event, one by one
+  size_t n_out = 0;
+  uint64_t todo = det->busy | cross;
+  while (todo)
+  {
+    int c = __builtin_ctzll(todo);
+    uint64_t bit = (uint64_t)1 << c;
+    todo &= todo - 1;
+
+    if (cross & bit)
+    {
+      det->refr[c] = cfg->refractory;
+      det->start[c] = n;
+      det->peak_m[c] = m[c];
+      det->peak[c] = hist[c];
+      det->peak_lag[c] = 0;
+      for (uint32_t i = 0; i < cfg->snip_pre; i++)
+      {
+        // Frames before the first one are 0
+        det->snip[c][i] =
+            det->hist[(n - cfg->snip_pre + i) & (RHD_EVENT_MAX_SNIP - 1)][c];
+      }
+      det->snip[c][cfg->snip_pre] = hist[c];
+      det->snip_fill[c] = cfg->snip_pre + 1;
+    }
+    else
+    {
+      if (m[c] > det->peak_m[c])
+      {
+        det->peak_m[c] = m[c];
+        det->peak[c] = hist[c];
+        det->peak_lag[c] = (uint16_t)(n - det->start[c]);
+      }
+      if (det->snip_fill[c] < cfg->snip_len)
+      {
+        det->snip[c][det->snip_fill[c]++] = hist[c];
+      }
+    }
+
+    if (--det->refr[c] > 0)
+    {
+      det->busy |= bit;
+      continue;
+    }
+    det->busy &= ~bit;
+    if (n_out == max_events)
+    {
+      det->n_dropped++;
+      continue;
+    }
+    rhd_event_t *e = &events[n_out];
+    e->frame = det->start[c];
+    e->peak = det->peak[c];
+    e->peak_lag = det->peak_lag[c];
+    e->ch = (uint8_t)c;
+    memset(e->reserved, 0, sizeof(e->reserved));
+    if (snippets != NULL && cfg->snip_len > 0)
+    {
+      memcpy(&snippets[n_out * cfg->snip_len], det->snip[c],
+             cfg->snip_len * sizeof(int16_t));
+    }
+    n_out++;
+    det->n_events++;
+  }
+
+  det->n_frames++;
+  return n_out;
+}
@@ -0,0 +1,147 @@
+/** @file rhd_event.h
+ *
+ * @brief Streaming threshold-crossing event detector.
+ *
+ * Detects spikes or activation onsets in the frames of `rhd2164_sample_all`
+ * and emits compact event records instead of frames. Each channel tracks
+ * its noise level (running RMS, or running median of the absolute value for
+ * a MAD estimate), and an event starts when a sample crosses `k` times the
+ * noise. The channel is then refractory: its peak is tracked and its noise
+ * estimate frozen, and the event is emitted once the refractory period ends,
+ * optionally with a snippet of samples around the crossing. Samples are
+ * assumed zero-mean, eg with the DSP offset removal enabled.
+ *
+ * The per-sample work is done over all channels by branch-free loops the
+ * compiler vectorizes; only channels in an event are handled one by one.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_EVENT_H
+#define RHD_EVENT_H
+
+#include "rhd.h"
+
+#define RHD_EVENT_MAX_CH 64
+/** Longest snippet [frames], also the depth of the pre-crossing history */
+#define RHD_EVENT_MAX_SNIP 64
+
+typedef enum
+{
+  RHD_EVENT_RMS = 0,
+  /** Median absolute value / 0.6745, robust to the events themselves */
+  RHD_EVENT_MAD = 1,
+} rhd_event_noise_t;
+
+typedef enum
+{
+  RHD_EVENT_NEG = 0,
+  RHD_EVENT_POS = 1,
+  RHD_EVENT_BOTH = 2,
+} rhd_event_polarity_t;
+
+typedef struct
+{
+  /** Channels per frame, at most `RHD_EVENT_MAX_CH` */
+  size_t n_ch;
+  /** True if samples are two's complement, see `rhd_cfg_dsp` */
+  bool twos_comp;
+  rhd_event_noise_t noise;
+  rhd_event_polarity_t polarity;
+  /** Threshold, in noise standard deviations */
+  float k;
+  /** Noise estimate time constant [frames] */
+  float tau;
+  /** Frames before detection starts, to let the noise estimate settle */
+  uint32_t warmup;
+  /** Event length [frames], at least 1. The peak is searched over it. */
+  uint32_t refractory;
+  /** Snippet length [frames], 0 for no snippets */
+  uint32_t snip_len;
+  /** Snippet frames before the crossing, less than `snip_len`.
+   * `snip_len - snip_pre` must not exceed `refractory`. */
+  uint32_t snip_pre;
+} rhd_event_cfg_t;
+
+/** Event record, 16 bytes */
+typedef struct
+{
+  /** Frame index of the threshold crossing */
+  uint64_t frame;
+  /** Peak sample, two's complement */
+  int16_t peak;
+  /** Frames from the crossing to the peak */
+  uint16_t peak_lag;
+  uint8_t ch;
+  uint8_t reserved[3];
+} rhd_event_t;
+
+typedef struct
+{
+  rhd_event_cfg_t cfg;
+  uint16_t flip;
+  float alpha;
+  float k2;
+
+  /** Noise estimate: mean square (RMS) or median absolute value (MAD) */
+  float noise[RHD_EVENT_MAX_CH];
+  /** Squared threshold */
+  float thr2[RHD_EVENT_MAX_CH];
+  /** Remaining event frames, 0 when idle */
+  uint32_t refr[RHD_EVENT_MAX_CH];
+  /** Channels in an event */
+  uint64_t busy;
+
+  uint64_t start[RHD_EVENT_MAX_CH];
+  float peak_m[RHD_EVENT_MAX_CH];
+  int16_t peak[RHD_EVENT_MAX_CH];
+  uint16_t peak_lag[RHD_EVENT_MAX_CH];
+  uint32_t snip_fill[RHD_EVENT_MAX_CH];
+  int16_t snip[RHD_EVENT_MAX_CH][RHD_EVENT_MAX_SNIP];
+  /** Last frames, for the snippets' pre-crossing part */
+  int16_t hist[RHD_EVENT_MAX_SNIP][RHD_EVENT_MAX_CH];
+
+  uint64_t n_frames;
+  uint64_t n_events;
+  /** Events that did not fit in the caller's buffer */
+  uint64_t n_dropped;
+} rhd_event_det_t;
+
+/**
+ * @brief Sensible defaults for 64 channels: 5 RMS, both polarities, 1 s
+ * noise time constant and 1 ms events at 20 kHz, no snippets.
+ *
+ * @param cfg configuration to fill
+ */
+void rhd_event_default_cfg(rhd_event_cfg_t *cfg);
+
+/**
+ * @brief Initialize a detector.
+ *
+ * @param det pointer to rhd_event_det_t instance
+ * @param cfg detector configuration, copied
+ * @return int 0 for success, -1 for an invalid configuration
+ */
+int rhd_event_init(rhd_event_det_t *det, const rhd_event_cfg_t *cfg);
+
+/**
+ * @brief Process a frame, emitting the events that end on it.
+ *
+ * @param det pointer to rhd_event_det_t instance
+ * @param sample_buf `n_ch` samples, eg from `rhd2164_sample_all`
+ * @param events emitted events, at most `max_events`
+ * @param snippets emitted snippets, `snip_len` samples per event, can be NULL
+ * @param max_events room in `events`, `n_ch` is always enough
+ * @return size_t number of events emitted
+ */
+size_t rhd_event_process(rhd_event_det_t *det, const uint16_t *sample_buf,
+                         rhd_event_t *events, int16_t *snippets,
+                         size_t max_events);
+
+/**
+ * @brief Noise standard deviation estimate of a channel [ADC steps].
+ */
+float rhd_event_noise(const rhd_event_det_t *det, int ch);
+
+#endif /* RHD_EVENT_H */
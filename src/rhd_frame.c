@@ -0,0 +1,160 @@
+/** @file rhd_frame.c
+ *
+ * @brief Per-frame metadata and gap/overrun detection.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_frame.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
+uint64_t rhd_clock_ns(void)
+{
+#if defined(__unix__) || defined(__APPLE__)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+  // Provide your own clock to rhd_pacer_init on bare-metal targets
+  return 0;
+#endif
+}
+
+void rhd_pacer_init(rhd_pacer_t *pacer, uint64_t period_ns, rhd_clock_t clock)
+{
+  pacer->clock = clock != NULL ? clock : rhd_clock_ns;
+  pacer->period_ns = period_ns;
+  pacer->t0_ns = 0;
+  pacer->seq = 0;
+}
+
+void rhd_pacer_begin(rhd_pacer_t *pacer, rhd_frame_hdr_t *hdr)
+{
+  uint64_t now = pacer->clock();
+
+  hdr->late_ns = 0;
+  hdr->flags = 0;
+  if (pacer->period_ns != 0)
+  {
+    if (pacer->seq == 0)
+    {
+      pacer->t0_ns = now;
+    }
+    uint64_t deadline = pacer->t0_ns + (uint64_t)pacer->seq * pacer->period_ns;
+    while (now < deadline)
+    {
+      now = pacer->clock();
+    }
+    hdr->late_ns = (int64_t)(now - deadline);
+    if ((uint64_t)hdr->late_ns > pacer->period_ns)
+    {
+      hdr->flags |= RHD_FRAME_OVERRUN;
+    }
+  }
+  hdr->t_ns = now;
+  hdr->seq = pacer->seq++;
+}
+
+int rhd_frame_sample(rhd_device_t *dev, rhd_pacer_t *pacer, rhd_sample_fn_t fn,
+                     uint16_t *sample_buf, rhd_frame_hdr_t *hdr)
+{
+  rhd_frame_hdr_t tmp;
+  hdr = hdr != NULL ? hdr : &tmp;
+
+  rhd_pacer_begin(pacer, hdr);
+  int ret = fn(dev, sample_buf);
+  if (ret < 0)
+  {
+    hdr->flags |= RHD_FRAME_RW_ERR;
+  }
+  return ret;
+}
+
+void rhd_gap_init(rhd_gap_detector_t *det, uint64_t period_ns, uint64_t tol_ns)
+{
+  det->period_ns = period_ns;
+  det->tol_ns = tol_ns;
+  det->started = false;
+  det->next_seq = 0;
+  det->last_t_ns = 0;
+  det->n_frames = 0;
+  det->n_missing = 0;
+  det->n_reordered = 0;
+  det->n_stalls = 0;
+  det->n_overruns = 0;
+  det->n_rw_err = 0;
+  det->max_late_ns = 0;
+  det->max_dt_ns = 0;
+}
+
+uint32_t rhd_gap_check(rhd_gap_detector_t *det, const rhd_frame_hdr_t *hdr,
+                       uint32_t *missing)
+{
+  uint32_t ret = 0;
+  uint32_t lost = 0;
+
+  if (det->started && (int32_t)(hdr->seq - det->next_seq) < 0)
+  {
+    ret |= RHD_GAP_REORDER;
+    det->n_reordered++;
+  }
+  else
+  {
+    if (det->started)
+    {
+      // Unsigned difference handles sequence wrap-around
+      lost = hdr->seq - det->next_seq;
+      if (lost != 0)
+      {
+        ret |= RHD_GAP_SEQ;
+        det->n_missing += lost;
+      }
+
+      uint64_t dt = hdr->t_ns - det->last_t_ns;
+      det->max_dt_ns = dt > det->max_dt_ns ? dt : det->max_dt_ns;
+      if (det->period_ns != 0 &&
+          dt > (uint64_t)(lost + 1) * det->period_ns + det->tol_ns)
+      {
+        ret |= RHD_GAP_STALL;
+        det->n_stalls++;
+      }
+    }
+    det->started = true;
+    det->next_seq = hdr->seq + 1;
+    det->last_t_ns = hdr->t_ns;
+  }
+  det->n_frames++;
+
+  if (hdr->flags & RHD_FRAME_OVERRUN)
+  {
+    ret |= RHD_GAP_OVERRUN;
+    det->n_overruns++;
+  }
+  if (hdr->flags & RHD_FRAME_RW_ERR)
+  {
+    ret |= RHD_GAP_RW_ERR;
+    det->n_rw_err++;
+  }
+  det->max_late_ns =
+      hdr->late_ns > det->max_late_ns ? hdr->late_ns : det->max_late_ns;
+
+  if (missing != NULL)
+  {
+    *missing = lost;
+  }
+  return ret;
+}
+
+size_t rhd_gap_feed(rhd_gap_detector_t *det, const rhd_frame_hdr_t *hdr,
+                    size_t n)
+{
+  size_t n_bad = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    n_bad += rhd_gap_check(det, &hdr[i], NULL) != 0;
+  }
+  return n_bad;
+}
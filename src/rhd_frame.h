@@ -0,0 +1,165 @@
+/** @file rhd_frame.h
+ *
+ * @brief Per-frame metadata: timestamp, sequence number, transport error flag
+ * and pacing lateness, plus a streaming gap/overrun detector.
+ *
+ * Headers are kept in a separate array parallel to the sample block, so
+ * `hdr[i]` describes the 64 samples at `sample_buf + 64 * i` and the samples
+ * stay dense.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_FRAME_H
+#define RHD_FRAME_H
+
+#include "rhd.h"
+
+/** A transfer of the frame returned a negative `rw` code */
+#define RHD_FRAME_RW_ERR 0x01
+/** The frame started more than a period after its deadline */
+#define RHD_FRAME_OVERRUN 0x02
+
+/** Sequence number jump, `missing` frames were lost */
+#define RHD_GAP_SEQ 0x01
+/** Timestamp jump larger than a period plus tolerance */
+#define RHD_GAP_STALL 0x02
+/** Frame flagged @ref RHD_FRAME_OVERRUN */
+#define RHD_GAP_OVERRUN 0x04
+/** Frame flagged @ref RHD_FRAME_RW_ERR */
+#define RHD_GAP_RW_ERR 0x08
+/** Sequence number behind the stream: frame reordered or duplicated */
+#define RHD_GAP_REORDER 0x10
+
+/**
+ * @brief Monotonic clock, in nanoseconds.
+ */
+typedef uint64_t (*rhd_clock_t)(void);
+
+/**
+ * @brief Frame sampling function, eg @ref rhd2164_sample_all or
+ * @ref rhd2164_sample_all_burst.
+ */
+typedef int (*rhd_sample_fn_t)(rhd_device_t *dev, uint16_t *sample_buf);
+
+typedef struct
+{
+  /** Monotonic time at which the frame acquisition started [ns] */
+  uint64_t t_ns;
+  /** Start time minus scheduled deadline [ns], 0 when not paced */
+  int64_t late_ns;
+  /** Frame sequence number */
+  uint32_t seq;
+  /** `RHD_FRAME_*` flags */
+  uint32_t flags;
+} rhd_frame_hdr_t;
+
+typedef struct
+{
+  rhd_clock_t clock;
+  /** Frame period [ns], 0 to sample as fast as possible */
+  uint64_t period_ns;
+  /** Deadline of frame 0 [ns] */
+  uint64_t t0_ns;
+  uint32_t seq;
+} rhd_pacer_t;
+
+typedef struct
+{
+  uint64_t period_ns;
+  uint64_t tol_ns;
+
+  bool started;
+  uint32_t next_seq;
+  uint64_t last_t_ns;
+
+  uint64_t n_frames;
+  /** Frames skipped by the sequence numbers, late ones included */
+  uint64_t n_missing;
+  /** Frames older than the last one, see @ref RHD_GAP_REORDER */
+  uint64_t n_reordered;
+  uint64_t n_stalls;
+  uint64_t n_overruns;
+  uint64_t n_rw_err;
+  int64_t max_late_ns;
+  uint64_t max_dt_ns;
+} rhd_gap_detector_t;
+
+/**
+ * @brief Default clock, `CLOCK_MONOTONIC` on POSIX systems.
+ *
+ * @return uint64_t time [ns]
+ */
+uint64_t rhd_clock_ns(void);
+
+/**
+ * @brief Initialize a frame pacer. The schedule starts at the first frame.
+ *
+ * @param pacer pointer to rhd_pacer_t instance
+ * @param period_ns frame period [ns], 0 for unpaced acquisition
+ * @param clock clock, NULL for @ref rhd_clock_ns
+ */
+void rhd_pacer_init(rhd_pacer_t *pacer, uint64_t period_ns, rhd_clock_t clock);
+
+/**
+ * @brief Busy-wait until the next frame's deadline, then fill its header's
+ * timestamp, sequence number and lateness.
+ *
+ * The schedule is fixed (`t0 + seq * period`), so a late frame does not
+ * delay the following deadlines.
+ *
+ * @param pacer pointer to rhd_pacer_t instance
+ * @param hdr header of the frame about to be sampled
+ */
+void rhd_pacer_begin(rhd_pacer_t *pacer, rhd_frame_hdr_t *hdr);
+
+/**
+ * @brief Wait for the next deadline and sample a frame with its header.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @param pacer pointer to rhd_pacer_t instance
+ * @param fn frame sampling function
+ * @param sample_buf frame reception buffer
+ * @param hdr frame header, can be NULL
+ * @return int `fn` return code
+ */
+int rhd_frame_sample(rhd_device_t *dev, rhd_pacer_t *pacer, rhd_sample_fn_t fn,
+                     uint16_t *sample_buf, rhd_frame_hdr_t *hdr);
+
+/**
+ * @brief Initialize a gap/overrun detector.
+ *
+ * @param det pointer to rhd_gap_detector_t instance
+ * @param period_ns expected frame period [ns], 0 to disable stall detection
+ * @param tol_ns jitter tolerated before reporting a stall [ns]
+ */
+void rhd_gap_init(rhd_gap_detector_t *det, uint64_t period_ns, uint64_t tol_ns);
+
+/**
+ * @brief Feed one frame header to the detector.
+ *
+ * A frame older than the last one (eg reordered or duplicated by a datagram
+ * transport) is flagged @ref RHD_GAP_REORDER and otherwise ignored: the
+ * expected sequence number and timestamp stay those of the newest frame.
+ *
+ * @param det pointer to rhd_gap_detector_t instance
+ * @param hdr frame header
+ * @param missing number of frames lost before `hdr`, can be NULL
+ * @return uint32_t `RHD_GAP_*` flags, 0 if the frame is on time
+ */
+uint32_t rhd_gap_check(rhd_gap_detector_t *det, const rhd_frame_hdr_t *hdr,
+                       uint32_t *missing);
+
+/**
+ * @brief Feed a block of frame headers to the detector.
+ *
+ * @param det pointer to rhd_gap_detector_t instance
+ * @param hdr frame headers
+ * @param n number of headers
+ * @return size_t number of anomalous frames in the block
+ */
+size_t rhd_gap_feed(rhd_gap_detector_t *det, const rhd_frame_hdr_t *hdr,
+                    size_t n);
+
+#endif /* RHD_FRAME_H */
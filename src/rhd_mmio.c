@@ -0,0 +1,251 @@
+/** @file rhd_mmio.c
+ *
+ * @brief Memory-mapped FIFO transport.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_mmio.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static rhd_mmio_t *rhd_mmio_bound = NULL;
+
+static inline volatile uint32_t *rhd_mmio_reg(volatile uint8_t *base,
+                                              size_t off)
+{
+  return (volatile uint32_t *)(base + off);
+}
+
+/**
+ * @brief Copy 16-bit words into a FIFO window, 2 per 32-bit slot.
+ *
+ * @return int number of 32-bit accesses
+ */
+static int rhd_mmio_put(volatile uint8_t *base, size_t off, const uint16_t *src,
+                        size_t len)
+{
+  volatile uint32_t *fifo = rhd_mmio_reg(base, off);
+  size_t n = 0;
+  for (size_t i = 0; i + 1 < len; i += 2)
+  {
+    fifo[n++] = src[i] | ((uint32_t)src[i + 1] << 16);
+  }
+  if (len & 1)
+  {
+    fifo[n++] = src[len - 1];
+  }
+  return n;
+}
+
+/**
+ * @brief Copy 16-bit words out of a FIFO window, 2 per 32-bit slot.
+ *
+ * @return int number of 32-bit accesses
+ */
+static int rhd_mmio_get(volatile uint8_t *base, size_t off, uint16_t *dst,
+                        size_t len)
+{
+  volatile uint32_t *fifo = rhd_mmio_reg(base, off);
+  size_t n = 0;
+  for (size_t i = 0; i + 1 < len; i += 2)
+  {
+    uint32_t v = fifo[n++];
+    dst[i] = v & 0xFFFF;
+    dst[i + 1] = v >> 16;
+  }
+  if (len & 1)
+  {
+    dst[len - 1] = fifo[n++] & 0xFFFF;
+  }
+  return n;
+}
+
+void rhd_mmio_default_cfg(rhd_mmio_cfg_t *cfg)
+{
+  cfg->len_off = 0x00;
+  cfg->bell_off = 0x04;
+  cfg->stat_off = 0x08;
+  cfg->tx_off = 0x100;
+  cfg->rx_off = 0x300;
+  cfg->depth = 256;
+  cfg->rx_per_tx = 1;
+  cfg->max_polls = 0;
+  cfg->yield_polls = 0;
+}
+
+size_t rhd_mmio_region_size(const rhd_mmio_cfg_t *cfg)
+{
+  size_t size = cfg->tx_off + 2 * cfg->depth;
+  size_t rx_end = cfg->rx_off + 2 * cfg->depth * cfg->rx_per_tx;
+  size_t regs[] = {cfg->len_off, cfg->bell_off, cfg->stat_off};
+
+  size = rx_end > size ? rx_end : size;
+  for (unsigned int i = 0; i < sizeof(regs) / sizeof(size_t); i++)
+  {
+    size = regs[i] + 4 > size ? regs[i] + 4 : size;
+  }
+  return size;
+}
+
+int rhd_mmio_attach(rhd_mmio_t *mmio, void *base, size_t size,
+                    const rhd_mmio_cfg_t *cfg)
+{
+  if (base == NULL || cfg->depth < 2 || cfg->rx_per_tx < 1 ||
+      rhd_mmio_region_size(cfg) > size)
+  {
+    return -1;
+  }
+  mmio->cfg = *cfg;
+  mmio->base = (volatile uint8_t *)base;
+  mmio->size = size;
+  mmio->fd = -1;
+  mmio->burst_id = *rhd_mmio_reg(mmio->base, cfg->stat_off);
+  mmio->n_mmio = 1;
+  mmio->n_poll = 0;
+  mmio->n_burst = 0;
+  return 0;
+}
+
+int rhd_mmio_open(rhd_mmio_t *mmio, const char *path, size_t size,
+                  size_t offset, const rhd_mmio_cfg_t *cfg)
+{
+  int fd = open(path, O_RDWR | O_SYNC);
+  if (fd < 0)
+  {
+    return -1;
+  }
+
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+  if (base == MAP_FAILED)
+  {
+    close(fd);
+    return -1;
+  }
+
+  if (rhd_mmio_attach(mmio, base, size, cfg) != 0)
+  {
+    munmap(base, size);
+    close(fd);
+    return -1;
+  }
+  mmio->fd = fd;
+  return 0;
+}
+
+int rhd_mmio_close(rhd_mmio_t *mmio)
+{
+  if (rhd_mmio_bound == mmio)
+  {
+    rhd_mmio_bound = NULL;
+  }
+  if (mmio->fd >= 0)
+  {
+    munmap((void *)mmio->base, mmio->size);
+    close(mmio->fd);
+    mmio->fd = -1;
+  }
+  mmio->base = NULL;
+  return 0;
+}
+
+int rhd_mmio_xfer(rhd_mmio_t *mmio, const uint16_t *tx, uint16_t *rx,
+                  size_t len)
+{
+  const rhd_mmio_cfg_t *cfg = &mmio->cfg;
+  volatile uint8_t *base = mmio->base;
+
+  for (size_t off = 0; off < len; off += cfg->depth)
+  {
+    size_t n = len - off < cfg->depth ? len - off : cfg->depth;
+    uint32_t id = ++mmio->burst_id;
+    uint32_t polls = 0;
+
+    mmio->n_mmio += rhd_mmio_put(base, cfg->tx_off, tx + off, n);
+    *rhd_mmio_reg(base, cfg->len_off) = n;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    *rhd_mmio_reg(base, cfg->bell_off) = id;
+    mmio->n_mmio += 2;
+    mmio->n_burst++;
+
+    while (*rhd_mmio_reg(base, cfg->stat_off) != id)
+    {
+      polls++;
+      if (cfg->max_polls != 0 && polls >= cfg->max_polls)
+      {
+        mmio->n_poll += polls;
+        mmio->n_mmio += polls;
+        return -1;
+      }
+      if (cfg->yield_polls != 0 && polls % cfg->yield_polls == 0)
+      {
+        sched_yield();
+      }
+    }
+    polls++;
+    mmio->n_poll += polls;
+    mmio->n_mmio += polls;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    mmio->n_mmio += rhd_mmio_get(base, cfg->rx_off, rx + off * cfg->rx_per_tx,
+                                 n * cfg->rx_per_tx);
+  }
+  return len;
+}
+
+void rhd_mmio_bind(rhd_mmio_t *mmio) { rhd_mmio_bound = mmio; }
+
+int rhd_mmio_rw(uint16_t *tx_buf, uint16_t *rx_buf, size_t len)
+{
+  if (rhd_mmio_bound == NULL)
+  {
+    return -1;
+  }
+  return rhd_mmio_xfer(rhd_mmio_bound, tx_buf, rx_buf, len);
+}
+
+int rhd_mmio_serve(const rhd_mmio_cfg_t *cfg, void *base, rhd_rw_t rw,
+                   volatile int *stop)
+{
+  volatile uint8_t *b = (volatile uint8_t *)base;
+  uint32_t last = *rhd_mmio_reg(b, cfg->stat_off);
+  uint16_t *tx = malloc(2 * cfg->depth);
+  uint16_t *rx = malloc(2 * cfg->depth * cfg->rx_per_tx);
+  int served = 0;
+
+  if (tx == NULL || rx == NULL)
+  {
+    free(tx);
+    free(rx);
+    return -1;
+  }
+
+  while (!*stop)
+  {
+    uint32_t id = *rhd_mmio_reg(b, cfg->bell_off);
+    if (id == last)
+    {
+      sched_yield();
+      continue;
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    size_t n = *rhd_mmio_reg(b, cfg->len_off);
+    n = n > cfg->depth ? cfg->depth : n;
+    rhd_mmio_get(b, cfg->tx_off, tx, n);
+    rw(tx, rx, n);
+    rhd_mmio_put(b, cfg->rx_off, rx, n * cfg->rx_per_tx);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    *rhd_mmio_reg(b, cfg->stat_off) = id;
+    last = id;
+    served++;
+  }
+
+  free(tx);
+  free(rx);
+  return served;
+}
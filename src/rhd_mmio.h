@@ -0,0 +1,148 @@
+/** @file rhd_mmio.h
+ *
+ * @brief Memory-mapped FIFO transport, eg over `/dev/uioN` or any `mmap`able
+ * region. Linux only.
+ *
+ * A whole command burst is written to the TX FIFO window, the doorbell is rung
+ * once and the RX burst is collected when the status register echoes the
+ * doorbell's burst id. 16-bit words are packed 2 per 32-bit FIFO slot, lower
+ * half first.
+ *
+ * Pair it with @ref rhd2164_sample_all_burst or @ref rhd_send_burst so a frame
+ * only costs one doorbell.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_MMIO_H
+#define RHD_MMIO_H
+
+#include "rhd.h"
+
+typedef struct
+{
+  /** Burst length register offset [bytes], in 16-bit TX words */
+  size_t len_off;
+  /** Doorbell register offset [bytes], written with the burst id */
+  size_t bell_off;
+  /** Status register offset [bytes], echoes the id of the last done burst */
+  size_t stat_off;
+  /** TX FIFO window offset [bytes] */
+  size_t tx_off;
+  /** RX FIFO window offset [bytes] */
+  size_t rx_off;
+  /** FIFO depth, in 16-bit TX words */
+  size_t depth;
+  /** RX words per TX word, 2 for hardware DDR flip-flops */
+  unsigned int rx_per_tx;
+  /** Max status polls before giving up, 0 to poll forever */
+  uint32_t max_polls;
+  /** Yield the CPU every `yield_polls` polls, 0 to busy-poll */
+  uint32_t yield_polls;
+} rhd_mmio_cfg_t;
+
+typedef struct
+{
+  rhd_mmio_cfg_t cfg;
+  volatile uint8_t *base;
+  size_t size;
+  int fd;
+  uint32_t burst_id;
+
+  /** Number of 32-bit MMIO accesses, including polls */
+  uint64_t n_mmio;
+  /** Number of status polls */
+  uint64_t n_poll;
+  /** Number of doorbells */
+  uint64_t n_burst;
+} rhd_mmio_t;
+
+/**
+ * @brief Default register layout: length, doorbell and status registers at
+ * 0x00, 0x04 and 0x08, 256-word TX FIFO at 0x100, RX FIFO at 0x300.
+ *
+ * @param cfg configuration to fill
+ */
+void rhd_mmio_default_cfg(rhd_mmio_cfg_t *cfg);
+
+/**
+ * @brief Size of the region needed by `cfg` [bytes].
+ *
+ * @param cfg register layout
+ * @return size_t region size
+ */
+size_t rhd_mmio_region_size(const rhd_mmio_cfg_t *cfg);
+
+/**
+ * @brief Map a device file, eg `/dev/uio0`.
+ *
+ * @param mmio pointer to rhd_mmio_t instance
+ * @param path device path
+ * @param size mapping size [bytes]
+ * @param offset mapping offset [bytes], `N * page size` for UIO map N
+ * @param cfg register layout
+ * @return int 0 on success, -1 otherwise
+ */
+int rhd_mmio_open(rhd_mmio_t *mmio, const char *path, size_t size,
+                  size_t offset, const rhd_mmio_cfg_t *cfg);
+
+/**
+ * @brief Use an already mapped region.
+ *
+ * @param mmio pointer to rhd_mmio_t instance
+ * @param base region base address
+ * @param size region size [bytes]
+ * @param cfg register layout
+ * @return int 0 on success, -1 if `cfg` does not fit in the region
+ */
+int rhd_mmio_attach(rhd_mmio_t *mmio, void *base, size_t size,
+                    const rhd_mmio_cfg_t *cfg);
+
+/**
+ * @brief Unmap the region if it was opened with @ref rhd_mmio_open.
+ *
+ * @param mmio pointer to rhd_mmio_t instance
+ * @return int 0 on success
+ */
+int rhd_mmio_close(rhd_mmio_t *mmio);
+
+/**
+ * @brief Transfer a burst, split in FIFO-sized chunks if needed.
+ *
+ * @param mmio pointer to rhd_mmio_t instance
+ * @param tx write buffer
+ * @param rx receive buffer, `len * rx_per_tx` words long
+ * @param len number of 16-bit TX words
+ * @return int `len`, -1 on timeout
+ */
+int rhd_mmio_xfer(rhd_mmio_t *mmio, const uint16_t *tx, uint16_t *rx,
+                  size_t len);
+
+/**
+ * @brief Select the instance used by @ref rhd_mmio_rw.
+ *
+ * @param mmio pointer to rhd_mmio_t instance
+ */
+void rhd_mmio_bind(rhd_mmio_t *mmio);
+
+/**
+ * @brief `rhd_rw_t` transport to the bound MMIO region.
+ */
+int rhd_mmio_rw(uint16_t *tx_buf, uint16_t *rx_buf, size_t len);
+
+/**
+ * @brief Device side of the protocol, to stand in for the hardware, eg from a
+ * forked process sharing the region. Answers every burst with `rw` until
+ * `*stop` becomes non-zero. Yields the CPU while idle.
+ *
+ * @param cfg register layout
+ * @param base region base address
+ * @param rw transport answering the bursts, eg `rhd_sim_rw`
+ * @param stop stop flag
+ * @return int number of bursts served
+ */
+int rhd_mmio_serve(const rhd_mmio_cfg_t *cfg, void *base, rhd_rw_t rw,
+                   volatile int *stop);
+
+#endif /* RHD_MMIO_H */
@@ -0,0 +1,662 @@
+/** @file rhd_net.c
+ *
+ * @brief Frame streaming over UDP and TCP.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#define _GNU_SOURCE
+#include "rhd_net.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/** Datagrams received per `recvmmsg` call */
+#define RHD_NET_RX_BATCH 16
+
+static void rhd_net_put_u16(uint8_t *buf, uint16_t val)
+{
+  buf[0] = val & 0xFF;
+  buf[1] = val >> 8;
+}
+
+static void rhd_net_put_u32(uint8_t *buf, uint32_t val)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    buf[i] = (val >> (8 * i)) & 0xFF;
+  }
+}
+
+static void rhd_net_put_u64(uint8_t *buf, uint64_t val)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    buf[i] = (val >> (8 * i)) & 0xFF;
+  }
+}
+
+static uint16_t rhd_net_get_u16(const uint8_t *buf)
+{
+  return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t rhd_net_get_u32(const uint8_t *buf)
+{
+  uint32_t val = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    val |= (uint32_t)buf[i] << (8 * i);
+  }
+  return val;
+}
+
+static uint64_t rhd_net_get_u64(const uint8_t *buf)
+{
+  uint64_t val = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    val |= (uint64_t)buf[i] << (8 * i);
+  }
+  return val;
+}
+
+static void rhd_net_put_samples(uint8_t *buf, const uint16_t *samples,
+                                size_t n)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(buf, samples, 2 * n);
+#else
+  for (size_t i = 0; i < n; i++)
+  {
+    rhd_net_put_u16(&buf[2 * i], samples[i]);
+  }
+#endif
+}
+
+static void rhd_net_get_samples(const uint8_t *buf, uint16_t *samples,
+                                size_t n)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(samples, buf, 2 * n);
+#else
+  for (size_t i = 0; i < n; i++)
+  {
+    samples[i] = rhd_net_get_u16(&buf[2 * i]);
+  }
+#endif
+}
+
+/**
+ * @brief Open a socket connected to `host:port`.
+ */
+static int rhd_net_connect(const char *host, uint16_t port, int type)
+{
+  struct addrinfo hints;
+  struct addrinfo *res;
+  char port_str[8];
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = type;
+  snprintf(port_str, sizeof(port_str), "%u", port);
+  if (getaddrinfo(host, port_str, &hints, &res) != 0)
+  {
+    return -1;
+  }
+
+  int fd = -1;
+  for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next)
+  {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0)
+    {
+      continue;
+    }
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+    {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+/**
+ * @brief Open a socket bound to any IPv4 address on `port`.
+ */
+static int rhd_net_bind(uint16_t port, int type)
+{
+  struct sockaddr_in addr;
+  int one = 1;
+
+  int fd = socket(AF_INET, type, 0);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static uint16_t rhd_net_local_port(int fd)
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  if (fd < 0 || getsockname(fd, (struct sockaddr *)&addr, &len) != 0)
+  {
+    return 0;
+  }
+  return ntohs(addr.sin_port);
+}
+
+int rhd_net_tx_init(rhd_net_tx_t *tx, uint16_t stream_id, size_t frame_len,
+                    size_t frames_per_pkt, size_t pkts_per_flush)
+{
+  memset(tx, 0, sizeof(*tx));
+  tx->udp_fd = -1;
+  tx->listen_fd = -1;
+  for (int i = 0; i < RHD_NET_MAX_CLIENTS; i++)
+  {
+    tx->clients[i] = -1;
+  }
+
+  tx->pkt_size = RHD_NET_PKT_SIZE(frames_per_pkt, frame_len);
+  if (frame_len == 0 || frame_len > RHD_NET_MAX_FRAME_LEN ||
+      frames_per_pkt == 0 || frames_per_pkt > 0xFFFF ||
+      tx->pkt_size > RHD_NET_MAX_PKT || pkts_per_flush == 0 ||
+      pkts_per_flush > RHD_NET_MAX_BATCH)
+  {
+    return -1;
+  }
+
+  tx->stream_id = stream_id;
+  tx->frame_len = frame_len;
+  tx->frames_per_pkt = frames_per_pkt;
+  tx->pkts_per_flush = pkts_per_flush;
+  tx->pkts = malloc(tx->pkt_size * pkts_per_flush);
+  return tx->pkts != NULL ? 0 : -1;
+}
+
+int rhd_net_tx_udp(rhd_net_tx_t *tx, const char *host, uint16_t port)
+{
+  tx->udp_fd = rhd_net_connect(host, port, SOCK_DGRAM);
+  return tx->udp_fd >= 0 ? 0 : -1;
+}
+
+int rhd_net_tx_tcp_listen(rhd_net_tx_t *tx, uint16_t port)
+{
+  tx->listen_fd = rhd_net_bind(port, SOCK_STREAM);
+  if (tx->listen_fd < 0)
+  {
+    return -1;
+  }
+  if (listen(tx->listen_fd, RHD_NET_MAX_CLIENTS) != 0)
+  {
+    close(tx->listen_fd);
+    tx->listen_fd = -1;
+    return -1;
+  }
+  // Clients are picked up at each flush, without blocking
+  fcntl(tx->listen_fd, F_SETFL, fcntl(tx->listen_fd, F_GETFL) | O_NONBLOCK);
+  return 0;
+}
+
+uint16_t rhd_net_tx_tcp_port(const rhd_net_tx_t *tx)
+{
+  return rhd_net_local_port(tx->listen_fd);
+}
+
+/**
+ * @brief Write the header of the packet being filled and queue it.
+ */
+static void rhd_net_tx_seal(rhd_net_tx_t *tx)
+{
+  uint8_t *pkt = tx->pkts + tx->n_queued * tx->pkt_size;
+
+  rhd_net_put_u32(&pkt[0], RHD_NET_MAGIC);
+  rhd_net_put_u16(&pkt[4], tx->stream_id);
+  rhd_net_put_u16(&pkt[6], tx->n_frames);
+  rhd_net_put_u16(&pkt[8], tx->frame_len);
+  rhd_net_put_u16(&pkt[10], 0);
+  rhd_net_put_u32(&pkt[12], tx->pkt_seq++);
+
+  tx->pkt_len[tx->n_queued++] = RHD_NET_PKT_SIZE(tx->n_frames, tx->frame_len);
+  tx->n_frames = 0;
+}
+
+int rhd_net_tx_push(rhd_net_tx_t *tx, const rhd_frame_hdr_t *hdr,
+                    const uint16_t *samples)
+{
+  uint8_t *f = tx->pkts + tx->n_queued * tx->pkt_size +
+               RHD_NET_PKT_SIZE(tx->n_frames, tx->frame_len);
+
+  rhd_net_put_u64(&f[0], hdr->t_ns);
+  rhd_net_put_u32(&f[8], hdr->seq);
+  rhd_net_put_u32(&f[12], hdr->flags);
+  rhd_net_put_samples(&f[RHD_NET_FRAME_HDR_SIZE], samples, tx->frame_len);
+
+  if (++tx->n_frames < tx->frames_per_pkt)
+  {
+    return 0;
+  }
+  rhd_net_tx_seal(tx);
+  return tx->n_queued == tx->pkts_per_flush ? rhd_net_tx_flush(tx) : 0;
+}
+
+/**
+ * @brief Send all of `iov` to a non-blocking TCP client, in as few calls as
+ * possible.
+ *
+ * @return int 0 for success, -1 if the client went away or fell behind
+ */
+static int rhd_net_tx_tcp_send(rhd_net_tx_t *tx, int fd, struct iovec *iov,
+                               size_t n)
+{
+  struct msghdr msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = n;
+  while (msg.msg_iovlen > 0)
+  {
+    ssize_t ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    tx->n_syscalls++;
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      // Full send buffer: waiting would stall the producer, and dropping
+      // part of the flush would break the stream's framing
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        tx->n_slow_clients++;
+      }
+      return -1;
+    }
+    // Partial write, skip what was sent
+    while (msg.msg_iovlen > 0 && (size_t)ret >= msg.msg_iov->iov_len)
+    {
+      ret -= msg.msg_iov->iov_len;
+      msg.msg_iov++;
+      msg.msg_iovlen--;
+    }
+    if (msg.msg_iovlen > 0)
+    {
+      msg.msg_iov->iov_base = (uint8_t *)msg.msg_iov->iov_base + ret;
+      msg.msg_iov->iov_len -= ret;
+    }
+  }
+  return 0;
+}
+
+int rhd_net_tx_flush(rhd_net_tx_t *tx)
+{
+  struct iovec iov[RHD_NET_MAX_BATCH];
+  struct mmsghdr msgs[RHD_NET_MAX_BATCH];
+
+  if (tx->n_frames > 0)
+  {
+    rhd_net_tx_seal(tx);
+  }
+  size_t n = tx->n_queued;
+  if (n == 0)
+  {
+    return 0;
+  }
+  tx->n_queued = 0;
+  tx->n_pkts += n;
+
+  if (tx->udp_fd >= 0)
+  {
+    memset(msgs, 0, n * sizeof(msgs[0]));
+    for (size_t i = 0; i < n; i++)
+    {
+      iov[i].iov_base = tx->pkts + i * tx->pkt_size;
+      iov[i].iov_len = tx->pkt_len[i];
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    for (size_t sent = 0; sent < n;)
+    {
+      int ret = sendmmsg(tx->udp_fd, &msgs[sent], n - sent, 0);
+      tx->n_syscalls++;
+      if (ret < 0)
+      {
+        // Nobody listening yet, the datagrams are lost like any other
+        if (errno == ECONNREFUSED)
+        {
+          break;
+        }
+        if (errno != EINTR)
+        {
+          return -1;
+        }
+        continue;
+      }
+      sent += ret;
+    }
+  }
+
+  if (tx->listen_fd >= 0)
+  {
+    for (int i = 0; i < RHD_NET_MAX_CLIENTS; i++)
+    {
+      if (tx->clients[i] < 0)
+      {
+        tx->clients[i] = accept4(tx->listen_fd, NULL, NULL, SOCK_NONBLOCK);
+        if (tx->clients[i] >= 0)
+        {
+          int one = 1;
+          int sndbuf = RHD_NET_TCP_SNDBUF;
+          setsockopt(tx->clients[i], IPPROTO_TCP, TCP_NODELAY, &one,
+                     sizeof(one));
+          setsockopt(tx->clients[i], SOL_SOCKET, SO_SNDBUF, &sndbuf,
+                     sizeof(sndbuf));
+        }
+      }
+    }
+    for (int i = 0; i < RHD_NET_MAX_CLIENTS; i++)
+    {
+      if (tx->clients[i] < 0)
+      {
+        continue;
+      }
+      for (size_t k = 0; k < n; k++)
+      {
+        iov[k].iov_base = tx->pkts + k * tx->pkt_size;
+        iov[k].iov_len = tx->pkt_len[k];
+      }
+      if (rhd_net_tx_tcp_send(tx, tx->clients[i], iov, n) != 0)
+      {
+        // Client went away or fell behind
+        close(tx->clients[i]);
+        tx->clients[i] = -1;
+      }
+    }
+  }
+
+  return n;
+}
+
+void rhd_net_tx_close(rhd_net_tx_t *tx)
+{
+  if (tx->udp_fd >= 0)
+  {
+    close(tx->udp_fd);
+  }
+  if (tx->listen_fd >= 0)
+  {
+    close(tx->listen_fd);
+  }
+  for (int i = 0; i < RHD_NET_MAX_CLIENTS; i++)
+  {
+    if (tx->clients[i] >= 0)
+    {
+      close(tx->clients[i]);
+    }
+  }
+  free(tx->pkts);
+  tx->pkts = NULL;
+  tx->udp_fd = -1;
+  tx->listen_fd = -1;
+}
+
+static int rhd_net_rx_init(rhd_net_rx_t *rx, uint16_t stream_id, bool tcp)
+{
+  memset(rx, 0, sizeof(*rx));
+  rx->fd = -1;
+  rx->tcp = tcp;
+  rx->stream_id = stream_id;
+  rhd_gap_init(&rx->gap, 0, 0);
+
+  // A TCP stream needs room for one partial packet on top of a full read
+  rx->buf_size = tcp ? 2 * (RHD_NET_MAX_PKT + 1)
+                     : RHD_NET_RX_BATCH * (RHD_NET_MAX_PKT + 1);
+  rx->buf = malloc(rx->buf_size);
+  return rx->buf != NULL ? 0 : -1;
+}
+
+int rhd_net_rx_udp(rhd_net_rx_t *rx, uint16_t stream_id, uint16_t port)
+{
+  if (rhd_net_rx_init(rx, stream_id, false) != 0)
+  {
+    return -1;
+  }
+  rx->fd = rhd_net_bind(port, SOCK_DGRAM);
+  if (rx->fd < 0)
+  {
+    rhd_net_rx_close(rx);
+    return -1;
+  }
+  // Absorb bursts while the application processes frames
+  int rcvbuf = 4 << 20;
+  setsockopt(rx->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  return 0;
+}
+
+int rhd_net_rx_tcp(rhd_net_rx_t *rx, uint16_t stream_id, const char *host,
+                   uint16_t port)
+{
+  if (rhd_net_rx_init(rx, stream_id, true) != 0)
+  {
+    return -1;
+  }
+  rx->fd = rhd_net_connect(host, port, SOCK_STREAM);
+  if (rx->fd < 0)
+  {
+    rhd_net_rx_close(rx);
+    return -1;
+  }
+  return 0;
+}
+
+uint16_t rhd_net_rx_port(const rhd_net_rx_t *rx)
+{
+  return rhd_net_local_port(rx->fd);
+}
+
+/**
+ * @brief Size of the packet starting at `pkt`, from its header.
+ *
+ * @return size_t packet size, 0 if the header is malformed
+ */
+static size_t rhd_net_pkt_size(const uint8_t *pkt)
+{
+  size_t frame_len = rhd_net_get_u16(&pkt[8]);
+  size_t size = RHD_NET_PKT_SIZE(rhd_net_get_u16(&pkt[6]), frame_len);
+  if (rhd_net_get_u32(&pkt[0]) != RHD_NET_MAGIC ||
+      frame_len > RHD_NET_MAX_FRAME_LEN || size > RHD_NET_MAX_PKT)
+  {
+    return 0;
+  }
+  return size;
+}
+
+/**
+ * @brief Deliver the frames of a complete packet.
+ *
+ * @return int number of frames delivered
+ */
+static int rhd_net_rx_packet(rhd_net_rx_t *rx, const uint8_t *pkt, size_t len,
+                             rhd_net_frame_cb_t cb, void *ctx)
+{
+  uint16_t samples[RHD_NET_MAX_FRAME_LEN];
+
+  size_t size = len >= RHD_NET_HDR_SIZE ? rhd_net_pkt_size(pkt) : 0;
+  if (size == 0 || size != len || rhd_net_get_u16(&pkt[4]) != rx->stream_id)
+  {
+    rx->n_bad_pkts++;
+    return 0;
+  }
+
+  uint32_t seq = rhd_net_get_u32(&pkt[12]);
+  if (rx->started && (int32_t)(seq - rx->next_pkt_seq) < 0)
+  {
+    // Its frames are still delivered, flagged by the gap detector
+    rx->n_reordered_pkts++;
+  }
+  else
+  {
+    if (rx->started)
+    {
+      rx->n_lost_pkts += seq - rx->next_pkt_seq;
+    }
+    rx->started = true;
+    rx->next_pkt_seq = seq + 1;
+  }
+  rx->n_pkts++;
+
+  size_t n_frames = rhd_net_get_u16(&pkt[6]);
+  size_t frame_len = rhd_net_get_u16(&pkt[8]);
+  const uint8_t *f = &pkt[RHD_NET_HDR_SIZE];
+  for (size_t i = 0; i < n_frames; i++)
+  {
+    rhd_frame_hdr_t hdr;
+    hdr.t_ns = rhd_net_get_u64(&f[0]);
+    hdr.late_ns = 0;
+    hdr.seq = rhd_net_get_u32(&f[8]);
+    hdr.flags = rhd_net_get_u32(&f[12]);
+    rhd_net_get_samples(&f[RHD_NET_FRAME_HDR_SIZE], samples, frame_len);
+
+    rhd_gap_check(&rx->gap, &hdr, NULL);
+    cb(ctx, &hdr, samples, frame_len);
+    f += RHD_NET_FRAME_HDR_SIZE + 2 * frame_len;
+  }
+  return n_frames;
+}
+
+static int rhd_net_rx_poll_udp(rhd_net_rx_t *rx, rhd_net_frame_cb_t cb,
+                               void *ctx)
+{
+  struct iovec iov[RHD_NET_RX_BATCH];
+  struct mmsghdr msgs[RHD_NET_RX_BATCH];
+  int n_frames = 0;
+
+  for (;;)
+  {
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < RHD_NET_RX_BATCH; i++)
+    {
+      iov[i].iov_base = rx->buf + i * (RHD_NET_MAX_PKT + 1);
+      iov[i].iov_len = RHD_NET_MAX_PKT + 1;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int n = recvmmsg(rx->fd, msgs, RHD_NET_RX_BATCH, MSG_DONTWAIT, NULL);
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        return n_frames;
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    for (int i = 0; i < n; i++)
+    {
+      n_frames +=
+          rhd_net_rx_packet(rx, iov[i].iov_base, msgs[i].msg_len, cb, ctx);
+    }
+  }
+}
+
+static int rhd_net_rx_poll_tcp(rhd_net_rx_t *rx, rhd_net_frame_cb_t cb,
+                               void *ctx)
+{
+  int n_frames = 0;
+
+  for (;;)
+  {
+    ssize_t n = recv(rx->fd, rx->buf + rx->buf_len, rx->buf_size - rx->buf_len,
+                     MSG_DONTWAIT);
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        return n_frames;
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    if (n == 0)
+    {
+      // Peer closed
+      return n_frames > 0 ? n_frames : -1;
+    }
+    rx->buf_len += n;
+
+    // Reassemble the complete packets, keep the partial one
+    size_t off = 0;
+    while (rx->buf_len - off >= RHD_NET_HDR_SIZE)
+    {
+      size_t size = rhd_net_pkt_size(rx->buf + off);
+      if (size == 0)
+      {
+        // Lost framing, the stream is unusable
+        return -1;
+      }
+      if (rx->buf_len - off < size)
+      {
+        break;
+      }
+      n_frames += rhd_net_rx_packet(rx, rx->buf + off, size, cb, ctx);
+      off += size;
+    }
+    memmove(rx->buf, rx->buf + off, rx->buf_len - off);
+    rx->buf_len -= off;
+  }
+}
+
+int rhd_net_rx_poll(rhd_net_rx_t *rx, rhd_net_frame_cb_t cb, void *ctx,
+                    int timeout_ms)
+{
+  struct pollfd pfd = {rx->fd, POLLIN, 0};
+  int ret = poll(&pfd, 1, timeout_ms);
+  if (ret <= 0)
+  {
+    return ret < 0 && errno != EINTR ? -1 : 0;
+  }
+  return rx->tcp ? rhd_net_rx_poll_tcp(rx, cb, ctx)
+                 : rhd_net_rx_poll_udp(rx, cb, ctx);
+}
+
+void rhd_net_rx_close(rhd_net_rx_t *rx)
+{
+  if (rx->fd >= 0)
+  {
+    close(rx->fd);
+  }
+  free(rx->buf);
+  rx->buf = NULL;
+  rx->fd = -1;
+}
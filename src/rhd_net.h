@@ -0,0 +1,212 @@
+/** @file rhd_net.h
+ *
+ * @brief Frame streaming over UDP and TCP.
+ *
+ * The sender packs several frames per packet and queues several packets per
+ * flush, so that a flush costs one `sendmmsg` call for UDP and one
+ * scatter-gather `sendmsg` call per TCP client. The receiver reassembles
+ * frames from either transport and reports lost packets and frames.
+ *
+ * Wire format, little-endian: a 16-byte packet header
+ * `[magic "RHDN", stream id u16, frame count u16, frame length u16,
+ * reserved u16, packet sequence u32]`, followed by the frames, each being
+ * `[t_ns u64, seq u32, flags u32]` and `frame length` samples (u16). The
+ * frame header's `late_ns` is not transmitted.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_NET_H
+#define RHD_NET_H
+
+#include "rhd.h"
+#include "rhd_frame.h"
+
+#define RHD_NET_MAGIC 0x4E444852
+#define RHD_NET_HDR_SIZE 16
+#define RHD_NET_FRAME_HDR_SIZE 16
+/** Largest packet, the maximum UDP payload */
+#define RHD_NET_MAX_PKT 65507
+/** Largest frame [samples] */
+#define RHD_NET_MAX_FRAME_LEN 256
+/** Most packets queued per flush */
+#define RHD_NET_MAX_BATCH 64
+#define RHD_NET_MAX_CLIENTS 8
+/** Send buffer requested for each TCP client, the slack before it is
+ * disconnected for falling behind [bytes] */
+#define RHD_NET_TCP_SNDBUF (4 << 20)
+
+/** Packet size for `n_frames` frames of `frame_len` samples [bytes] */
+#define RHD_NET_PKT_SIZE(n_frames, frame_len)                                  \
+  (RHD_NET_HDR_SIZE +                                                          \
+   (n_frames) * (RHD_NET_FRAME_HDR_SIZE + 2 * (size_t)(frame_len)))
+
+typedef struct
+{
+  uint16_t stream_id;
+  size_t frame_len;
+  size_t frames_per_pkt;
+  size_t pkts_per_flush;
+
+  /** `pkts_per_flush` packet buffers */
+  uint8_t *pkts;
+  size_t pkt_size;
+  size_t pkt_len[RHD_NET_MAX_BATCH];
+  /** Complete packets waiting for the next flush */
+  size_t n_queued;
+  /** Frames in the packet being filled */
+  size_t n_frames;
+  uint32_t pkt_seq;
+
+  int udp_fd;
+  int listen_fd;
+  int clients[RHD_NET_MAX_CLIENTS];
+
+  uint64_t n_pkts;
+  uint64_t n_syscalls;
+  /** TCP clients disconnected because their send buffer was full */
+  uint64_t n_slow_clients;
+} rhd_net_tx_t;
+
+/**
+ * @brief Reassembled frame callback.
+ *
+ * @param ctx user context
+ * @param hdr frame header, `late_ns` is 0
+ * @param samples `frame_len` samples
+ * @param frame_len number of samples
+ */
+typedef void (*rhd_net_frame_cb_t)(void *ctx, const rhd_frame_hdr_t *hdr,
+                                   const uint16_t *samples, size_t frame_len);
+
+typedef struct
+{
+  int fd;
+  bool tcp;
+  uint16_t stream_id;
+
+  /** Receive buffer, a TCP stream may hold partial packets */
+  uint8_t *buf;
+  size_t buf_size;
+  size_t buf_len;
+
+  bool started;
+  /** Sequence number following the newest packet */
+  uint32_t next_pkt_seq;
+  /** Frame sequence tracking, its `n_missing` counts the lost frames */
+  rhd_gap_detector_t gap;
+
+  uint64_t n_pkts;
+  uint64_t n_lost_pkts;
+  /** Packets older than the newest one, reordered or duplicated */
+  uint64_t n_reordered_pkts;
+  /** Malformed packets, or packets of another stream */
+  uint64_t n_bad_pkts;
+} rhd_net_rx_t;
+
+/**
+ * @brief Initialize a sender.
+ *
+ * @param tx pointer to rhd_net_tx_t instance
+ * @param stream_id stream identifier, eg one per device
+ * @param frame_len samples per frame, eg 64 for RHD2164
+ * @param frames_per_pkt frames per packet. Keep
+ * `RHD_NET_PKT_SIZE(frames_per_pkt, frame_len)` under the path MTU for UDP.
+ * @param pkts_per_flush packets sent per flush, at most `RHD_NET_MAX_BATCH`
+ * @return int 0 for success, -1 for invalid sizes or allocation failure
+ */
+int rhd_net_tx_init(rhd_net_tx_t *tx, uint16_t stream_id, size_t frame_len,
+                    size_t frames_per_pkt, size_t pkts_per_flush);
+
+/**
+ * @brief Send UDP datagrams to `host:port`.
+ *
+ * @return int 0 for success, -1 on socket error
+ */
+int rhd_net_tx_udp(rhd_net_tx_t *tx, const char *host, uint16_t port);
+
+/**
+ * @brief Accept TCP clients on `port`, 0 for an ephemeral port. Clients are
+ * accepted at each flush and receive every packet flushed afterwards.
+ *
+ * Client sockets are non-blocking, so a slow client never stalls the flush
+ * and the acquisition loop behind it. A client whose send buffer (see
+ * `RHD_NET_TCP_SNDBUF`) cannot take a whole flush is disconnected and
+ * counted in `n_slow_clients`: the stream it received stays lossless up to
+ * that point.
+ *
+ * @return int 0 for success, -1 on socket error
+ */
+int rhd_net_tx_tcp_listen(rhd_net_tx_t *tx, uint16_t port);
+
+/**
+ * @brief Local TCP port, useful after listening on port 0.
+ */
+uint16_t rhd_net_tx_tcp_port(const rhd_net_tx_t *tx);
+
+/**
+ * @brief Queue a frame. Flushes once `pkts_per_flush` packets are complete.
+ *
+ * @param tx pointer to rhd_net_tx_t instance
+ * @param hdr frame header
+ * @param samples `frame_len` samples, eg from `rhd2164_sample_all`
+ * @return int number of packets flushed, negative on UDP send failure
+ */
+int rhd_net_tx_push(rhd_net_tx_t *tx, const rhd_frame_hdr_t *hdr,
+                    const uint16_t *samples);
+
+/**
+ * @brief Send the queued packets, including a partially filled one.
+ *
+ * @return int number of packets sent, negative on UDP send failure
+ */
+int rhd_net_tx_flush(rhd_net_tx_t *tx);
+
+/**
+ * @brief Close the sockets and free the buffers.
+ */
+void rhd_net_tx_close(rhd_net_tx_t *tx);
+
+/**
+ * @brief Receive UDP datagrams on `port`, 0 for an ephemeral port.
+ *
+ * @param rx pointer to rhd_net_rx_t instance
+ * @param stream_id stream to receive, others are counted as bad packets
+ * @param port local port
+ * @return int 0 for success, -1 on socket error, the receiver then released
+ */
+int rhd_net_rx_udp(rhd_net_rx_t *rx, uint16_t stream_id, uint16_t port);
+
+/**
+ * @brief Connect to a sender's TCP port.
+ *
+ * @return int 0 for success, -1 on socket error, the receiver then released
+ */
+int rhd_net_rx_tcp(rhd_net_rx_t *rx, uint16_t stream_id, const char *host,
+                   uint16_t port);
+
+/**
+ * @brief Local port, useful after binding UDP port 0.
+ */
+uint16_t rhd_net_rx_port(const rhd_net_rx_t *rx);
+
+/**
+ * @brief Receive the available packets and deliver their frames in order.
+ *
+ * @param rx pointer to rhd_net_rx_t instance
+ * @param cb called for every frame
+ * @param ctx passed to `cb`
+ * @param timeout_ms time to wait for the first packet, -1 to block
+ * @return int number of frames delivered, negative on socket error or when
+ * the TCP peer closed the connection
+ */
+int rhd_net_rx_poll(rhd_net_rx_t *rx, rhd_net_frame_cb_t cb, void *ctx,
+                    int timeout_ms);
+
+/**
+ * @brief Close the socket and free the buffer.
+ */
+void rhd_net_rx_close(rhd_net_rx_t *rx);
+
+#endif /* RHD_NET_H */
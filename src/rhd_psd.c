@@ -0,0 +1,374 @@
+/** @file rhd_psd.c
+ *
+ * @brief Streaming multi-channel power spectral density and line-noise
+ * monitor.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_psd.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/** Bins on each side of a line harmonic, the Hann main lobe */
+#define RHD_PSD_LINE_BINS 2
+
+/**
+ * @brief In-place radix-2 FFT of `n_lanes` interleaved signals, input in
+ * bit-reversed order.
+ */
+static void rhd_psd_fft(rhd_psd_t *psd)
+{
+  const size_t n = psd->cfg.nfft;
+  const size_t l = psd->n_lanes;
+  float *re = psd->re;
+  float *im = psd->im;
+
+  for (size_t len = 2; len <= n; len <<= 1)
+  {
+    const size_t half = len / 2;
+    const size_t step = n / len;
+    for (size_t i = 0; i < n; i += len)
+    {
+      for (size_t j = 0; j < half; j++)
+      {
+        const float wr = psd->cos_lut[j * step];
+        const float wi = -psd->sin_lut[j * step];
+        float *ar = &re[(i + j) * l];
+        float *ai = &im[(i + j) * l];
+        float *br = &re[(i + j + half) * l];
+        float *bi = &im[(i + j + half) * l];
+        // Across lanes, vectorized
+        for (size_t c = 0; c < l; c++)
+        {
+          const float tr = wr * br[c] - wi * bi[c];
+          const float ti = wr * bi[c] + wi * br[c];
+          br[c] = ar[c] - tr;
+          bi[c] = ai[c] - ti;
+          ar[c] += tr;
+          ai[c] += ti;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Window, transform and accumulate the last `nfft` samples.
+ */
+static void rhd_psd_segment(rhd_psd_t *psd)
+{
+  const size_t n = psd->cfg.nfft;
+  const size_t n_ch = psd->cfg.n_ch;
+  const size_t l = psd->n_lanes;
+
+  // Channel c in the real part, c + n_lanes in the imaginary part
+  for (size_t i = 0; i < n; i++)
+  {
+    const float *x = &psd->hist[((psd->pos + i) & (n - 1)) * n_ch];
+    const float w = psd->win[i];
+    float *re = &psd->re[psd->bitrev[i] * l];
+    float *im = &psd->im[psd->bitrev[i] * l];
+    for (size_t c = 0; c < l; c++)
+    {
+      re[c] = w * x[c];
+      im[c] = c + l < n_ch ? w * x[c + l] : 0;
+    }
+  }
+
+  rhd_psd_fft(psd);
+
+  // Split the packed spectra: Xa = (Z[k] + Z*[n-k]) / 2,
+  // Xb = (Z[k] - Z*[n-k]) / 2i
+  for (size_t k = 0; k < psd->n_bins; k++)
+  {
+    const size_t kk = (n - k) & (n - 1);
+    const float *zr = &psd->re[k * l];
+    const float *zi = &psd->im[k * l];
+    const float *yr = &psd->re[kk * l];
+    const float *yi = &psd->im[kk * l];
+    float *acc = &psd->acc[k * n_ch];
+    for (size_t c = 0; c < l; c++)
+    {
+      const float ar = zr[c] + yr[c];
+      const float ai = zi[c] - yi[c];
+      acc[c] += 0.25f * (ar * ar + ai * ai);
+    }
+    for (size_t c = 0; c + l < n_ch; c++)
+    {
+      const float br = zi[c] + yi[c];
+      const float bi = zr[c] - yr[c];
+      acc[c + l] += 0.25f * (br * br + bi * bi);
+    }
+  }
+  psd->n_seg++;
+}
+
+/**
+ * @brief k-th smallest value, partially sorting `v`.
+ */
+static float rhd_psd_select(float *v, size_t n, size_t k)
+{
+  size_t lo = 0;
+  size_t hi = n - 1;
+  while (lo < hi)
+  {
+    const float pivot = v[(lo + hi) / 2];
+    size_t i = lo;
+    size_t j = hi;
+    while (i <= j)
+    {
+      while (v[i] < pivot)
+      {
+        i++;
+      }
+      while (v[j] > pivot)
+      {
+        j--;
+      }
+      if (i <= j)
+      {
+        float t = v[i];
+        v[i] = v[j];
+        v[j] = t;
+        i++;
+        if (j == 0)
+        {
+          break;
+        }
+        j--;
+      }
+    }
+    if (k <= j)
+    {
+      hi = j;
+    }
+    else if (k >= i)
+    {
+      lo = i;
+    }
+    else
+    {
+      break;
+    }
+  }
+  return v[k];
+}
+
+/**
+ * @brief Scale the accumulated power into PSDs, and derive the line-noise
+ * power and noise floor.
+ */
+static void rhd_psd_publish(rhd_psd_t *psd)
+{
+  const rhd_psd_cfg_t *cfg = &psd->cfg;
+  const size_t n_ch = cfg->n_ch;
+  const size_t n_bins = psd->n_bins;
+  const float fs = cfg->fs / cfg->decim;
+  const float df = fs / cfg->nfft;
+
+  float u = 0;
+  for (size_t i = 0; i < cfg->nfft; i++)
+  {
+    u += psd->win[i] * psd->win[i];
+  }
+  // One-sided density
+  const float scale = 1.0f / (fs * u * psd->n_seg);
+
+  for (size_t k = 0; k < n_bins; k++)
+  {
+    const float s = k == 0 || k == n_bins - 1 ? scale : 2 * scale;
+    for (size_t c = 0; c < n_ch; c++)
+    {
+      psd->psd[c * n_bins + k] = s * psd->acc[k * n_ch + c];
+    }
+  }
+  memset(psd->acc, 0, n_bins * n_ch * sizeof(float));
+  psd->n_seg = 0;
+
+  for (size_t c = 0; c < n_ch; c++)
+  {
+    const float *p = &psd->psd[c * n_bins];
+
+    psd->line[c] = 0;
+    for (uint32_t h = 1; h <= cfg->n_harmonics; h++)
+    {
+      const long k0 = lroundf(h * cfg->line_freq / df);
+      if (k0 + RHD_PSD_LINE_BINS >= (long)n_bins)
+      {
+        break;
+      }
+      for (long k = k0 - RHD_PSD_LINE_BINS; k <= k0 + RHD_PSD_LINE_BINS; k++)
+      {
+        if (k > 0)
+        {
+          psd->line[c] += p[k] * df;
+        }
+      }
+    }
+
+    // Without DC
+    memcpy(psd->scratch, p + 1, (n_bins - 1) * sizeof(float));
+    psd->floor[c] = rhd_psd_select(psd->scratch, n_bins - 1, (n_bins - 1) / 2);
+  }
+  psd->n_published++;
+}
+
+void rhd_psd_default_cfg(rhd_psd_cfg_t *cfg)
+{
+  cfg->n_ch = 64;
+  cfg->fs = 1000;
+  cfg->decim = 1;
+  cfg->nfft = 1024;
+  cfg->hop = 512;
+  cfg->n_avg = 8;
+  cfg->line_freq = 60;
+  cfg->n_harmonics = 3;
+  cfg->twos_comp = true;
+}
+
+int rhd_psd_init(rhd_psd_t *psd, const rhd_psd_cfg_t *cfg)
+{
+  const uint32_t n = cfg->nfft;
+  memset(psd, 0, sizeof(*psd));
+  if (cfg->n_ch == 0 || cfg->n_ch > RHD_PSD_MAX_CH || n < 4 ||
+      n > RHD_PSD_MAX_NFFT || (n & (n - 1)) != 0 || cfg->hop == 0 ||
+      cfg->hop > n || cfg->n_avg == 0 || cfg->decim == 0 || !(cfg->fs > 0))
+  {
+    return -1;
+  }
+
+  psd->cfg = *cfg;
+  psd->flip = cfg->twos_comp ? 0 : 0x8000;
+  psd->n_lanes = (cfg->n_ch + 1) / 2;
+  psd->n_bins = n / 2 + 1;
+
+  psd->win = malloc(n * sizeof(float));
+  psd->cos_lut = malloc(n / 2 * sizeof(float));
+  psd->sin_lut = malloc(n / 2 * sizeof(float));
+  psd->bitrev = malloc(n * sizeof(uint32_t));
+  psd->hist = calloc((size_t)n * cfg->n_ch, sizeof(float));
+  psd->re = malloc(n * psd->n_lanes * sizeof(float));
+  psd->im = malloc(n * psd->n_lanes * sizeof(float));
+  psd->acc = calloc(psd->n_bins * cfg->n_ch, sizeof(float));
+  psd->psd = calloc(psd->n_bins * cfg->n_ch, sizeof(float));
+  psd->scratch = malloc(psd->n_bins * sizeof(float));
+  if (psd->win == NULL || psd->cos_lut == NULL || psd->sin_lut == NULL ||
+      psd->bitrev == NULL || psd->hist == NULL || psd->re == NULL ||
+      psd->im == NULL || psd->acc == NULL || psd->psd == NULL ||
+      psd->scratch == NULL)
+  {
+    rhd_psd_free(psd);
+    return -1;
+  }
+
+  int n_bits = 0;
+  while ((1u << n_bits) < n)
+  {
+    n_bits++;
+  }
+  for (uint32_t i = 0; i < n; i++)
+  {
+    // Periodic Hann
+    psd->win[i] = 0.5 - 0.5 * cos(2 * M_PI * i / n);
+    uint32_t r = 0;
+    for (int b = 0; b < n_bits; b++)
+    {
+      r |= ((i >> b) & 1) << (n_bits - 1 - b);
+    }
+    psd->bitrev[i] = r;
+  }
+  for (uint32_t i = 0; i < n / 2; i++)
+  {
+    psd->cos_lut[i] = cos(2 * M_PI * i / n);
+    psd->sin_lut[i] = sin(2 * M_PI * i / n);
+  }
+  return 0;
+}
+
+void rhd_psd_free(rhd_psd_t *psd)
+{
+  free(psd->win);
+  free(psd->cos_lut);
+  free(psd->sin_lut);
+  free(psd->bitrev);
+  free(psd->hist);
+  free(psd->re);
+  free(psd->im);
+  free(psd->acc);
+  free(psd->psd);
+  free(psd->scratch);
+  memset(psd, 0, sizeof(*psd));
+}
+
+int rhd_psd_push(rhd_psd_t *psd, const uint16_t *sample_buf)
+{
+  const rhd_psd_cfg_t *cfg = &psd->cfg;
+  const size_t n_ch = cfg->n_ch;
+
+  for (size_t c = 0; c < n_ch; c++)
+  {
+    psd->dec_acc[c] += (int16_t)(sample_buf[c] ^ psd->flip);
+  }
+  if (++psd->dec_n < cfg->decim)
+  {
+    return 0;
+  }
+
+  float *x = &psd->hist[psd->pos * n_ch];
+  const float inv = 1.0f / cfg->decim;
+  for (size_t c = 0; c < n_ch; c++)
+  {
+    x[c] = psd->dec_acc[c] * inv;
+    psd->dec_acc[c] = 0;
+  }
+  psd->dec_n = 0;
+  psd->pos = (psd->pos + 1) & (cfg->nfft - 1);
+  psd->n_in++;
+  psd->n_new++;
+
+  if (psd->n_in < cfg->nfft || psd->n_new < cfg->hop)
+  {
+    return 0;
+  }
+  psd->n_new = 0;
+  rhd_psd_segment(psd);
+  if (psd->n_seg < cfg->n_avg)
+  {
+    return 0;
+  }
+  rhd_psd_publish(psd);
+  return 1;
+}
+
+float rhd_psd_bin_freq(const rhd_psd_t *psd, size_t bin)
+{
+  return bin * psd->cfg.fs / psd->cfg.decim / psd->cfg.nfft;
+}
+
+const float *rhd_psd_channel(const rhd_psd_t *psd, int ch)
+{
+  return &psd->psd[ch * psd->n_bins];
+}
+
+float rhd_psd_band_power(const rhd_psd_t *psd, int ch, float f_lo,
+                         float f_hi)
+{
+  const float df = rhd_psd_bin_freq(psd, 1);
+  const float *p = rhd_psd_channel(psd, ch);
+  float sum = 0;
+  for (size_t k = 0; k < psd->n_bins; k++)
+  {
+    float f = k * df;
+    if (f >= f_lo && f <= f_hi)
+    {
+      sum += p[k];
+    }
+  }
+  return sum * df;
+}
@@ -0,0 +1,141 @@
+/** @file rhd_psd.h
+ *
+ * @brief Streaming multi-channel power spectral density and line-noise
+ * monitor.
+ *
+ * Frames are optionally downsampled by averaging, then Welch's method runs
+ * on all channels at once: every `hop` samples, the last `nfft` samples are
+ * Hann-windowed, transformed and their power accumulated; every `n_avg`
+ * segments, the averaged one-sided PSDs are published together with each
+ * channel's line-noise power and noise floor.
+ *
+ * The FFT is batched across channels: samples are stored time-major like the
+ * frames, so every butterfly is a loop over channels that vectorizes, and
+ * channel pairs share one complex transform (real FFT by packing). Feed the
+ * monitor from a consumer of `rhd_ring.h` to keep it off the sampling loop.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_PSD_H
+#define RHD_PSD_H
+
+#include "rhd.h"
+
+#define RHD_PSD_MAX_CH 64
+#define RHD_PSD_MAX_NFFT 8192
+
+typedef struct
+{
+  /** Channels per frame, at most `RHD_PSD_MAX_CH` */
+  size_t n_ch;
+  /** Frame rate [Hz] */
+  float fs;
+  /** Frames averaged into one input sample, 1 for none */
+  uint32_t decim;
+  /** Segment length, a power of 2 up to `RHD_PSD_MAX_NFFT` */
+  uint32_t nfft;
+  /** Input samples between segments, up to `nfft` */
+  uint32_t hop;
+  /** Segments averaged per published PSD */
+  uint32_t n_avg;
+  /** Line frequency [Hz], eg 50 or 60 */
+  float line_freq;
+  /** Line harmonics included in the line-noise power */
+  uint32_t n_harmonics;
+  /** True if samples are two's complement, see `rhd_cfg_dsp` */
+  bool twos_comp;
+} rhd_psd_cfg_t;
+
+typedef struct
+{
+  rhd_psd_cfg_t cfg;
+  uint16_t flip;
+  /** Channel pairs, the lanes of the batched FFT */
+  size_t n_lanes;
+  size_t n_bins;
+
+  float *win;
+  float *cos_lut;
+  float *sin_lut;
+  uint32_t *bitrev;
+
+  /** Last `nfft` input samples, `[nfft][n_ch]` circular */
+  float *hist;
+  uint32_t pos;
+  uint64_t n_in;
+  uint32_t n_new;
+  float dec_acc[RHD_PSD_MAX_CH];
+  uint32_t dec_n;
+
+  /** FFT work buffers, `[nfft][n_lanes]` */
+  float *re;
+  float *im;
+  /** Accumulated power, `[n_bins][n_ch]` */
+  float *acc;
+  uint32_t n_seg;
+  /** `n_bins` values, for the noise floor's median */
+  float *scratch;
+
+  /** Published PSDs, `[n_ch][n_bins]` [ADC steps^2/Hz] */
+  float *psd;
+  /** Power in the line harmonics' bins, per channel [ADC steps^2] */
+  float line[RHD_PSD_MAX_CH];
+  /** Median of the PSD, per channel [ADC steps^2/Hz] */
+  float floor[RHD_PSD_MAX_CH];
+  /** Number of PSDs published */
+  uint64_t n_published;
+} rhd_psd_t;
+
+/**
+ * @brief Sensible defaults for 64 channels at 1 kHz: 1024-point segments with
+ * 50% overlap, 8 segments per PSD, 60 Hz line with 3 harmonics.
+ *
+ * @param cfg configuration to fill
+ */
+void rhd_psd_default_cfg(rhd_psd_cfg_t *cfg);
+
+/**
+ * @brief Initialize a monitor, allocating its buffers.
+ *
+ * @param psd pointer to rhd_psd_t instance
+ * @param cfg monitor configuration, copied
+ * @return int 0 for success, -1 for an invalid configuration or allocation
+ * failure
+ */
+int rhd_psd_init(rhd_psd_t *psd, const rhd_psd_cfg_t *cfg);
+
+/**
+ * @brief Free the buffers.
+ */
+void rhd_psd_free(rhd_psd_t *psd);
+
+/**
+ * @brief Feed a frame.
+ *
+ * @param psd pointer to rhd_psd_t instance
+ * @param sample_buf `n_ch` samples, eg from `rhd2164_sample_all`
+ * @return int 1 if new PSDs were published, 0 otherwise
+ */
+int rhd_psd_push(rhd_psd_t *psd, const uint16_t *sample_buf);
+
+/**
+ * @brief Frequency of a PSD bin [Hz].
+ */
+float rhd_psd_bin_freq(const rhd_psd_t *psd, size_t bin);
+
+/**
+ * @brief Published PSD of a channel, `n_bins` values [ADC steps^2/Hz].
+ * Multiply by `RHD_ADC_STEP` squared for V^2/Hz.
+ */
+const float *rhd_psd_channel(const rhd_psd_t *psd, int ch);
+
+/**
+ * @brief Power of a channel between two frequencies, eg to check the
+ * amplifier band set by `rhd_cfg_amp_bw` [ADC steps^2].
+ */
+float rhd_psd_band_power(const rhd_psd_t *psd, int ch, float f_lo,
+                         float f_hi);
+
+#endif /* RHD_PSD_H */
@@ -0,0 +1,195 @@
+/** @file rhd_replay.c
+ *
+ * @brief Replay of a recorded session as an `rhd_rw_t` transport.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_replay.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static rhd_replay_t *rhd_replay_bound = NULL;
+
+/**
+ * @brief Move to the next recorded frame, waiting for its deadline.
+ *
+ * @param rp pointer to rhd_replay_t instance
+ */
+static void rhd_replay_advance(rhd_replay_t *rp)
+{
+  rhd_frame_hdr_t hdr;
+
+  if (rp->cur == rp->n_frames)
+  {
+    return;
+  }
+  rp->cur++;
+  rp->n_played++;
+  if (rp->cur == rp->n_frames)
+  {
+    if (!rp->cfg.loop)
+    {
+      return;
+    }
+    rp->cur = 0;
+    rp->n_loops++;
+  }
+  rhd_pacer_begin(&rp->pacer, &hdr);
+}
+
+/**
+ * @brief Signal of the simulated chip: the recorded sample the driver will
+ * store this conversion's result as.
+ */
+static uint16_t rhd_replay_signal(void *ctx, int ch)
+{
+  rhd_replay_t *rp = ctx;
+  const int n = rp->eng->n_cmds;
+  const bool miso_b = ch >= n;
+  const int cmd = miso_b ? ch - n : ch;
+
+  // The results of a frame's last 2 commands land in the next frame
+  if (!miso_b && cmd == n - 2)
+  {
+    rhd_replay_advance(rp);
+  }
+  // Past the end, the last frame's carried-over results are blank and the
+  // next frame's conversions end the replay
+  if (rp->cur == rp->n_frames)
+  {
+    if (cmd < n - 2)
+    {
+      rp->done = true;
+    }
+    return 0;
+  }
+  return rp->frames[rp->cur * rp->eng->n_amp + rp->src[cmd] +
+                    (miso_b ? n : 0)];
+}
+
+void rhd_replay_default_cfg(rhd_replay_cfg_t *cfg)
+{
+  cfg->chip_id = RHD_CHIP_RHD2164;
+  cfg->double_bits = true;
+  cfg->legacy_order = false;
+  cfg->fs = 1000;
+  cfg->speed = 1;
+  cfg->loop = true;
+  cfg->clock = NULL;
+}
+
+int rhd_replay_init(rhd_replay_t *rp, const rhd_replay_cfg_t *cfg,
+                    const uint16_t *frames, uint64_t n_frames)
+{
+  const rhd_engine_t *eng = rhd_engine_find(cfg->chip_id, cfg->double_bits);
+  if (eng == NULL || frames == NULL || n_frames == 0 ||
+      (cfg->speed > 0 && cfg->fs <= 0) ||
+      (cfg->legacy_order && cfg->chip_id != RHD_CHIP_RHD2164))
+  {
+    return -1;
+  }
+
+  memset(rp, 0, sizeof(*rp));
+  rp->cfg = *cfg;
+  rp->eng = eng;
+  rp->frames = frames;
+  rp->n_frames = n_frames;
+  for (int c = 0; c < eng->n_cmds; c++)
+  {
+    rp->src[c] = eng->rx_ch[(c + 2) % eng->n_cmds];
+    // rhd2164_sample_all stores channel 30 at index 31 and vice versa
+    if (cfg->legacy_order && rp->src[c] >= 30)
+    {
+      rp->src[c] ^= 1;
+    }
+  }
+
+  rhd_sim_init(&rp->sim, cfg->chip_id, cfg->double_bits);
+  rhd_sim_set_signal(&rp->sim, rhd_replay_signal, rp);
+  rhd_replay_set_speed(rp, cfg->speed);
+  return 0;
+}
+
+int rhd_replay_open(rhd_replay_t *rp, const rhd_replay_cfg_t *cfg,
+                    const char *path)
+{
+  const rhd_engine_t *eng = rhd_engine_find(cfg->chip_id, cfg->double_bits);
+  struct stat st;
+
+  if (eng == NULL)
+  {
+    return -1;
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    close(fd);
+    return -1;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    return -1;
+  }
+
+  uint64_t n_frames = st.st_size / (eng->n_amp * sizeof(uint16_t));
+  if (rhd_replay_init(rp, cfg, map, n_frames) != 0)
+  {
+    munmap(map, st.st_size);
+    return -1;
+  }
+  rp->map = map;
+  rp->map_len = st.st_size;
+  return 0;
+}
+
+void rhd_replay_close(rhd_replay_t *rp)
+{
+  if (rp->map != NULL)
+  {
+    munmap(rp->map, rp->map_len);
+    rp->map = NULL;
+    rp->frames = NULL;
+  }
+  if (rhd_replay_bound == rp)
+  {
+    rhd_replay_bound = NULL;
+  }
+}
+
+void rhd_replay_set_speed(rhd_replay_t *rp, float speed)
+{
+  rp->cfg.speed = speed;
+  rhd_pacer_init(&rp->pacer,
+                 speed > 0 ? (uint64_t)(1e9 / (rp->cfg.fs * speed)) : 0,
+                 rp->cfg.clock);
+}
+
+int rhd_replay_xfer(rhd_replay_t *rp, const uint16_t *tx, uint16_t *rx,
+                    size_t len)
+{
+  // Fails from the first conversion past the end, the transfers completing
+  // the last frame succeed even when sent one command at a time
+  int ret = rhd_sim_xfer(&rp->sim, tx, rx, len);
+  return rp->done ? -1 : ret;
+}
+
+void rhd_replay_bind(rhd_replay_t *rp) { rhd_replay_bound = rp; }
+
+int rhd_replay_rw(uint16_t *tx_buf, uint16_t *rx_buf, size_t len)
+{
+  if (rhd_replay_bound == NULL)
+  {
+    return -1;
+  }
+  return rhd_replay_xfer(rhd_replay_bound, tx_buf, rx_buf, len);
+}
@@ -0,0 +1,151 @@
+/** @file rhd_replay.h
+ *
+ * @brief Replay of a recorded session as an `rhd_rw_t` transport, to
+ * load-test a pipeline with real signals and no hardware.
+ *
+ * The replay is a simulated chip (`rhd_sim.h`) whose CONVERT results come
+ * from recorded frames, written from `rhd_sample_all`, or from
+ * `rhd2164_sample_all` with `legacy_order` set. The chip model answers register reads and writes and
+ * re-encodes the MISO words in DDR mode, so `rhd_init` and `rhd_setup` work
+ * unchanged. Each conversion is answered with the recorded sample that lands
+ * at the same place in the driver's frame, 2 commands later, so frames read
+ * back with the same function match the recorded ones, with two caveats:
+ *
+ * - as with a real chip, the first frame sampled after configuration gets
+ * its first 2 results (`eng->rx_ch[0]` and `[1]`) from the commands sent
+ * before it, not from the recording. Frames from the second one on are the
+ * recorded ones;
+ * - the driver sets the LSb of every channel but 0 in DDR mode, and clears
+ * channel 0's. A recording made in the same SPI mode plays back bit for bit;
+ * one made without DDR gets these alignment bits set in DDR mode.
+ *
+ * The recording advances by one frame per frame's worth of CONVERT commands,
+ * paced at the recorded rate times a speed factor, or as fast as the driver
+ * asks. It can loop; otherwise `rw` fails once every frame was read back.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_REPLAY_H
+#define RHD_REPLAY_H
+
+#include "rhd.h"
+#include "rhd_frame.h"
+#include "rhd_sim.h"
+
+typedef struct
+{
+  /** Chip to emulate, one of `RHD_CHIP_*`. Frames hold its `n_amp` samples. */
+  uint8_t chip_id;
+  /** SPI mode of the driver using the replay, see @ref rhd_init */
+  bool double_bits;
+  /** Frames recorded with `rhd2164_sample_all` or
+   * `rhd2164_sample_all_burst`, which store channels 30 and 31 (62 and 63)
+   * swapped. RHD2164 only */
+  bool legacy_order;
+  /** Recorded frame rate [Hz] */
+  float fs;
+  /** Playback speed: 1 for real time, N for N times faster, 0 for as fast
+   * as the driver samples */
+  float speed;
+  /** Restart from the first frame at the end of the recording */
+  bool loop;
+  /** Pacing clock, NULL for `rhd_clock_ns` */
+  rhd_clock_t clock;
+} rhd_replay_cfg_t;
+
+typedef struct
+{
+  rhd_replay_cfg_t cfg;
+  rhd_sim_t sim;
+  const rhd_engine_t *eng;
+
+  const uint16_t *frames;
+  uint64_t n_frames;
+  /** File mapping of @ref rhd_replay_open, NULL otherwise */
+  void *map;
+  size_t map_len;
+
+  /** Frame sample answering each CONVERT command's MISO A result */
+  uint8_t src[32];
+  /** Recorded frame answering the conversions */
+  uint64_t cur;
+  rhd_pacer_t pacer;
+
+  /** Frames played, loops included */
+  uint64_t n_played;
+  /** Times the recording restarted */
+  uint64_t n_loops;
+  /** Recording exhausted without `loop` */
+  bool done;
+} rhd_replay_t;
+
+/**
+ * @brief Sensible defaults: RHD2164 in DDR mode, 1 kHz recording played in
+ * real time, looping.
+ *
+ * @param cfg configuration to fill
+ */
+void rhd_replay_default_cfg(rhd_replay_cfg_t *cfg);
+
+/**
+ * @brief Initialize a replay of frames in memory.
+ *
+ * @param rp pointer to rhd_replay_t instance
+ * @param cfg replay configuration, copied
+ * @param frames `n_frames` frames of `n_amp` samples, kept by reference
+ * @param n_frames number of frames
+ * @return int 0 for success, -1 for an unknown chip, `legacy_order` on
+ * another chip than the RHD2164 or an empty recording
+ */
+int rhd_replay_init(rhd_replay_t *rp, const rhd_replay_cfg_t *cfg,
+                    const uint16_t *frames, uint64_t n_frames);
+
+/**
+ * @brief Initialize a replay of a recording file, mapped in memory. A
+ * trailing partial frame is ignored.
+ *
+ * @param rp pointer to rhd_replay_t instance
+ * @param cfg replay configuration, copied
+ * @param path file of native 16-bit samples, `n_amp` per frame
+ * @return int 0 for success, -1 on failure
+ */
+int rhd_replay_open(rhd_replay_t *rp, const rhd_replay_cfg_t *cfg,
+                    const char *path);
+
+/**
+ * @brief Unmap the file of @ref rhd_replay_open.
+ */
+void rhd_replay_close(rhd_replay_t *rp);
+
+/**
+ * @brief Change the playback speed, the schedule restarting at the next
+ * frame.
+ *
+ * @param rp pointer to rhd_replay_t instance
+ * @param speed see `rhd_replay_cfg_t`
+ */
+void rhd_replay_set_speed(rhd_replay_t *rp, float speed);
+
+/**
+ * @brief Clock a transfer through the replay, see @ref rhd_sim_xfer.
+ *
+ * @return int `len`, -1 after the recording is exhausted without `loop`
+ */
+int rhd_replay_xfer(rhd_replay_t *rp, const uint16_t *tx, uint16_t *rx,
+                    size_t len);
+
+/**
+ * @brief Select the instance used by @ref rhd_replay_rw.
+ *
+ * @param rp pointer to rhd_replay_t instance
+ */
+void rhd_replay_bind(rhd_replay_t *rp);
+
+/**
+ * @brief `rhd_rw_t` transport to the bound replay.
+ */
+int rhd_replay_rw(uint16_t *tx_buf, uint16_t *rx_buf, size_t len);
+
+#endif /* RHD_REPLAY_H */
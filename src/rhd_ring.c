@@ -0,0 +1,149 @@
+/** @file rhd_ring.c
+ *
+ * @brief Single-producer, multi-consumer broadcast ring of frames.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_ring.h"
+
+int rhd_ring_init(rhd_ring_t *ring, uint16_t *frames, rhd_frame_hdr_t *hdrs,
+                  size_t frame_len, uint32_t capacity)
+{
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+  {
+    return -1;
+  }
+
+  ring->frames = frames;
+  ring->hdrs = hdrs;
+  ring->frame_len = frame_len;
+  ring->capacity = capacity;
+  ring->head = 0;
+  for (int i = 0; i < RHD_RING_MAX_CONSUMERS; i++)
+  {
+    ring->consumers[i].claimed = false;
+    ring->consumers[i].active = false;
+  }
+  return 0;
+}
+
+int rhd_ring_attach(rhd_ring_t *ring, rhd_ring_policy_t policy)
+{
+  for (int i = 0; i < RHD_RING_MAX_CONSUMERS; i++)
+  {
+    rhd_ring_consumer_t *c = &ring->consumers[i];
+    bool free_slot = false;
+    // Claim the slot first, it becomes active once set up
+    if (__atomic_compare_exchange_n(&c->claimed, &free_slot, true, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+      c->policy = policy;
+      c->n_lost = 0;
+      __atomic_store_n(&c->cursor, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE),
+                       __ATOMIC_RELAXED);
+      __atomic_store_n(&c->active, true, __ATOMIC_RELEASE);
+      return i;
+    }
+  }
+  return -1;
+}
+
+void rhd_ring_detach(rhd_ring_t *ring, int id)
+{
+  __atomic_store_n(&ring->consumers[id].active, false, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->consumers[id].claimed, false, __ATOMIC_RELEASE);
+}
+
+uint16_t *rhd_ring_claim(rhd_ring_t *ring, rhd_frame_hdr_t **hdr)
+{
+  uint32_t head = ring->head;
+
+  // The slot of `head` still holds frame `head - capacity`
+  for (int i = 0; i < RHD_RING_MAX_CONSUMERS; i++)
+  {
+    rhd_ring_consumer_t *c = &ring->consumers[i];
+    if (__atomic_load_n(&c->active, __ATOMIC_ACQUIRE) &&
+        c->policy == RHD_RING_BACKPRESSURE &&
+        head - __atomic_load_n(&c->cursor, __ATOMIC_ACQUIRE) >= ring->capacity)
+    {
+      return NULL;
+    }
+  }
+
+  uint32_t slot = head & (ring->capacity - 1);
+  if (hdr != NULL)
+  {
+    *hdr = &ring->hdrs[slot];
+  }
+  return &ring->frames[slot * ring->frame_len];
+}
+
+void rhd_ring_publish(rhd_ring_t *ring)
+{
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+int rhd_ring_sample(rhd_ring_t *ring, rhd_device_t *dev, rhd_pacer_t *pacer,
+                    rhd_sample_fn_t fn)
+{
+  rhd_frame_hdr_t *hdr;
+  uint16_t *buf = rhd_ring_claim(ring, &hdr);
+  if (buf == NULL)
+  {
+    return RHD_RING_FULL;
+  }
+  int ret = rhd_frame_sample(dev, pacer, fn, buf, hdr);
+  rhd_ring_publish(ring);
+  return ret;
+}
+
+const uint16_t *rhd_ring_read(rhd_ring_t *ring, int id,
+                              const rhd_frame_hdr_t **hdr)
+{
+  rhd_ring_consumer_t *c = &ring->consumers[id];
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint32_t cursor = c->cursor;
+
+  if (cursor == head)
+  {
+    return NULL;
+  }
+  // Lossy consumers skip what the producer overwrote, or is overwriting
+  if (c->policy == RHD_RING_LOSSY && head - cursor >= ring->capacity)
+  {
+    uint32_t skip = head - cursor - ring->capacity + 1;
+    c->n_lost += skip;
+    cursor += skip;
+    __atomic_store_n(&c->cursor, cursor, __ATOMIC_RELEASE);
+  }
+
+  uint32_t slot = cursor & (ring->capacity - 1);
+  if (hdr != NULL)
+  {
+    *hdr = &ring->hdrs[slot];
+  }
+  return &ring->frames[slot * ring->frame_len];
+}
+
+bool rhd_ring_release(rhd_ring_t *ring, int id)
+{
+  rhd_ring_consumer_t *c = &ring->consumers[id];
+  uint32_t cursor = c->cursor;
+
+  bool valid = true;
+  if (c->policy == RHD_RING_LOSSY)
+  {
+    // Reads of the slot must complete before checking it was not reclaimed
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    valid = head - cursor < ring->capacity;
+    if (!valid)
+    {
+      c->n_lost++;
+    }
+  }
+
+  __atomic_store_n(&c->cursor, cursor + 1, __ATOMIC_RELEASE);
+  return valid;
+}
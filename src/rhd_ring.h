@@ -0,0 +1,150 @@
+/** @file rhd_ring.h
+ *
+ * @brief Single-producer, multi-consumer broadcast ring of frames.
+ *
+ * The acquisition thread samples straight into ring slots, and every
+ * consumer (recorder, classifier, plot...) reads the same slots in place
+ * through its own cursor, so adding a consumer costs no copy. Each consumer
+ * picks a policy:
+ *
+ * - `RHD_RING_LOSSY`: the producer never waits for it. When it falls more
+ * than a ring behind, the overwritten frames are skipped and counted.
+ * - `RHD_RING_BACKPRESSURE`: the producer does not overwrite frames it has
+ * not released yet, @ref rhd_ring_claim fails instead.
+ *
+ * The producer and each consumer must each be driven by a single thread.
+ * Cursors are 32-bit sequence numbers, compared with wrap-around arithmetic.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_RING_H
+#define RHD_RING_H
+
+#include "rhd.h"
+#include "rhd_frame.h"
+
+#define RHD_RING_MAX_CONSUMERS 8
+
+/** @ref rhd_ring_claim failed, a backpressure consumer is a ring behind */
+#define RHD_RING_FULL -2
+
+typedef enum
+{
+  RHD_RING_LOSSY = 0,
+  RHD_RING_BACKPRESSURE = 1,
+} rhd_ring_policy_t;
+
+typedef struct
+{
+  /** Sequence number of the next frame to read */
+  uint32_t cursor;
+  rhd_ring_policy_t policy;
+  /** Slot claimed by @ref rhd_ring_attach, before its fields are set */
+  bool claimed;
+  /** Consumer visible to the producer */
+  bool active;
+  /** Frames overwritten before this consumer could read them */
+  uint64_t n_lost;
+} rhd_ring_consumer_t;
+
+typedef struct
+{
+  uint16_t *frames;
+  rhd_frame_hdr_t *hdrs;
+  /** Samples per frame, eg 64 for RHD2164 */
+  size_t frame_len;
+  /** Number of slots, a power of 2 */
+  uint32_t capacity;
+
+  /** Number of frames published */
+  uint32_t head;
+  rhd_ring_consumer_t consumers[RHD_RING_MAX_CONSUMERS];
+} rhd_ring_t;
+
+/**
+ * @brief Initialize a ring over caller-provided storage.
+ *
+ * @param ring pointer to rhd_ring_t instance
+ * @param frames sample storage, `capacity * frame_len` samples
+ * @param hdrs header storage, `capacity` headers, see `rhd_frame.h`
+ * @param frame_len samples per frame
+ * @param capacity number of slots, a power of 2
+ * @return int 0 for success, -1 if capacity is not a power of 2
+ */
+int rhd_ring_init(rhd_ring_t *ring, uint16_t *frames, rhd_frame_hdr_t *hdrs,
+                  size_t frame_len, uint32_t capacity);
+
+/**
+ * @brief Register a consumer. It starts at the next published frame.
+ *
+ * Safe to call from several threads at once, and while the producer runs.
+ *
+ * @param ring pointer to rhd_ring_t instance
+ * @param policy consumer policy
+ * @return int consumer id, -1 if all `RHD_RING_MAX_CONSUMERS` are taken
+ */
+int rhd_ring_attach(rhd_ring_t *ring, rhd_ring_policy_t policy);
+
+/**
+ * @brief Unregister a consumer, releasing any backpressure it applied.
+ *
+ * @param ring pointer to rhd_ring_t instance
+ * @param id consumer id
+ */
+void rhd_ring_detach(rhd_ring_t *ring, int id);
+
+/**
+ * @brief Producer: get the next slot to fill, in place.
+ *
+ * @param ring pointer to rhd_ring_t instance
+ * @param hdr set to the slot's header, can be NULL
+ * @return uint16_t* slot samples, NULL if a backpressure consumer has not
+ * released the slot yet
+ */
+uint16_t *rhd_ring_claim(rhd_ring_t *ring, rhd_frame_hdr_t **hdr);
+
+/**
+ * @brief Producer: make the claimed slot visible to consumers.
+ *
+ * @param ring pointer to rhd_ring_t instance
+ */
+void rhd_ring_publish(rhd_ring_t *ring);
+
+/**
+ * @brief Producer: acquire a frame straight into the ring with
+ * @ref rhd_frame_sample, and publish it.
+ *
+ * @param ring pointer to rhd_ring_t instance
+ * @param dev pointer to rhd_device_t instance
+ * @param pacer frame pacer
+ * @param fn sampling function
+ * @return int `fn` return code, or `RHD_RING_FULL`
+ */
+int rhd_ring_sample(rhd_ring_t *ring, rhd_device_t *dev, rhd_pacer_t *pacer,
+                    rhd_sample_fn_t fn);
+
+/**
+ * @brief Consumer: get the next frame, in place. Call @ref rhd_ring_release
+ * once done with it.
+ *
+ * @param ring pointer to rhd_ring_t instance
+ * @param id consumer id
+ * @param hdr set to the frame's header, can be NULL
+ * @return const uint16_t* frame samples, NULL if no new frame
+ */
+const uint16_t *rhd_ring_read(rhd_ring_t *ring, int id,
+                              const rhd_frame_hdr_t **hdr);
+
+/**
+ * @brief Consumer: release the frame returned by @ref rhd_ring_read.
+ *
+ * @param ring pointer to rhd_ring_t instance
+ * @param id consumer id
+ * @return bool false if a lossy consumer's frame was overwritten while it
+ * was being read, in which case its content must be discarded
+ */
+bool rhd_ring_release(rhd_ring_t *ring, int id);
+
+#endif /* RHD_RING_H */
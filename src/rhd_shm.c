@@ -0,0 +1,309 @@
+/** @file rhd_shm.c
+ *
+ * @brief Frame ring in POSIX shared memory.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_shm.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RHD_SHM_LINE 64
+#define RHD_SHM_ALIGN(x) (((x) + RHD_SHM_LINE - 1) & ~(size_t)(RHD_SHM_LINE - 1))
+
+/**
+ * @brief Shared header, at the start of the mapping. `head` is alone on its
+ * cache line, the producer writes it at every frame.
+ */
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t frame_len;
+  uint32_t capacity;
+  uint64_t slot_size;
+  uint8_t pad[RHD_SHM_LINE - 24];
+  /** Number of frames published */
+  uint64_t head;
+} rhd_shm_hdr_t;
+
+/**
+ * @brief Slot layout. `lock` is `2 * n + 1` while frame `n` is being written
+ * and `2 * n + 2` once it is published.
+ */
+typedef struct
+{
+  uint64_t lock;
+  rhd_frame_hdr_t hdr;
+  uint16_t samples[];
+} rhd_shm_slot_t;
+
+struct rhd_shm
+{
+  rhd_shm_hdr_t *hdr;
+  size_t size;
+  bool owner;
+  char *name;
+
+  /** Reader: next frame to read. Producer: frame being written. */
+  uint64_t cursor;
+  uint64_t n_lost;
+};
+
+static rhd_shm_slot_t *rhd_shm_slot(const rhd_shm_t *shm, uint64_t n)
+{
+  uint8_t *slots = (uint8_t *)shm->hdr + RHD_SHM_ALIGN(sizeof(rhd_shm_hdr_t));
+  return (rhd_shm_slot_t *)(slots + (n % shm->hdr->capacity) *
+                                        shm->hdr->slot_size);
+}
+
+/**
+ * @brief Map `fd` and wrap it in a handle.
+ */
+static rhd_shm_t *rhd_shm_map(int fd, size_t size, const char *name,
+                              bool owner)
+{
+  rhd_shm_t *shm = calloc(1, sizeof(*shm));
+  if (shm == NULL)
+  {
+    return NULL;
+  }
+
+  void *base = mmap(NULL, size, PROT_READ | (owner ? PROT_WRITE : 0),
+                    MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED)
+  {
+    free(shm);
+    return NULL;
+  }
+  shm->hdr = base;
+  shm->size = size;
+  shm->owner = owner;
+  shm->name = owner ? strdup(name) : NULL;
+  return shm;
+}
+
+rhd_shm_t *rhd_shm_create(const char *name, size_t frame_len,
+                          uint32_t capacity)
+{
+  if (frame_len == 0 || capacity == 0)
+  {
+    return NULL;
+  }
+  size_t slot_size =
+      RHD_SHM_ALIGN(sizeof(rhd_shm_slot_t) + frame_len * sizeof(uint16_t));
+  size_t size = RHD_SHM_ALIGN(sizeof(rhd_shm_hdr_t)) + capacity * slot_size;
+
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0)
+  {
+    return NULL;
+  }
+  if (ftruncate(fd, size) != 0)
+  {
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+  rhd_shm_t *shm = rhd_shm_map(fd, size, name, true);
+  close(fd);
+  if (shm == NULL)
+  {
+    shm_unlink(name);
+    return NULL;
+  }
+
+  // ftruncate zero-fills: every slot lock is 0, ie nothing published
+  shm->hdr->frame_len = frame_len;
+  shm->hdr->capacity = capacity;
+  shm->hdr->slot_size = slot_size;
+  shm->hdr->version = RHD_SHM_VERSION;
+  // Readers check the magic last
+  __atomic_store_n(&shm->hdr->magic, RHD_SHM_MAGIC, __ATOMIC_RELEASE);
+  return shm;
+}
+
+rhd_shm_t *rhd_shm_attach(const char *name)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+  {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(rhd_shm_hdr_t))
+  {
+    close(fd);
+    return NULL;
+  }
+  rhd_shm_t *shm = rhd_shm_map(fd, st.st_size, name, false);
+  close(fd);
+  if (shm == NULL)
+  {
+    return NULL;
+  }
+
+  const rhd_shm_hdr_t *hdr = shm->hdr;
+  if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != RHD_SHM_MAGIC ||
+      hdr->version != RHD_SHM_VERSION || hdr->capacity == 0 ||
+      RHD_SHM_ALIGN(sizeof(rhd_shm_hdr_t)) + hdr->capacity * hdr->slot_size >
+          shm->size)
+  {
+    rhd_shm_detach(shm);
+    return NULL;
+  }
+  shm->cursor = rhd_shm_head(shm);
+  return shm;
+}
+
+size_t rhd_shm_frame_len(const rhd_shm_t *shm) { return shm->hdr->frame_len; }
+
+uint64_t rhd_shm_head(const rhd_shm_t *shm)
+{
+  return __atomic_load_n(&shm->hdr->head, __ATOMIC_ACQUIRE);
+}
+
+uint64_t rhd_shm_lost(const rhd_shm_t *shm) { return shm->n_lost; }
+
+size_t rhd_shm_read(rhd_shm_t *shm, uint16_t *samples, uint64_t *t_ns,
+                    uint32_t *seq, uint32_t *flags, size_t max_frames)
+{
+  size_t frame_len = shm->hdr->frame_len;
+  size_t n = 0;
+
+  while (n < max_frames)
+  {
+    uint64_t head = rhd_shm_head(shm);
+    if (shm->cursor == head)
+    {
+      break;
+    }
+    // Too far behind, these slots were rewritten
+    if (head - shm->cursor > shm->hdr->capacity)
+    {
+      shm->n_lost += head - shm->cursor - shm->hdr->capacity;
+      shm->cursor = head - shm->hdr->capacity;
+    }
+
+    const rhd_shm_slot_t *slot = rhd_shm_slot(shm, shm->cursor);
+    uint64_t lock = 2 * shm->cursor + 2;
+    if (__atomic_load_n(&slot->lock, __ATOMIC_ACQUIRE) != lock)
+    {
+      shm->n_lost++;
+      shm->cursor++;
+      continue;
+    }
+    rhd_frame_hdr_t hdr = slot->hdr;
+    memcpy(&samples[n * frame_len], slot->samples,
+           frame_len * sizeof(uint16_t));
+    // Copies must complete before checking the slot was not rewritten
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->lock, __ATOMIC_RELAXED) != lock)
+    {
+      shm->n_lost++;
+      shm->cursor++;
+      continue;
+    }
+
+    if (t_ns != NULL)
+    {
+      t_ns[n] = hdr.t_ns;
+    }
+    if (seq != NULL)
+    {
+      seq[n] = hdr.seq;
+    }
+    if (flags != NULL)
+    {
+      flags[n] = hdr.flags;
+    }
+    shm->cursor++;
+    n++;
+  }
+  return n;
+}
+
+int rhd_shm_wait(rhd_shm_t *shm, int timeout_us)
+{
+  struct timespec t0, now;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  for (;;)
+  {
+    if (rhd_shm_head(shm) != shm->cursor)
+    {
+      return 1;
+    }
+    if (timeout_us == 0)
+    {
+      return 0;
+    }
+    if (timeout_us > 0)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      int64_t dt_us = (now.tv_sec - t0.tv_sec) * 1000000LL +
+                      (now.tv_nsec - t0.tv_nsec) / 1000;
+      if (dt_us >= timeout_us)
+      {
+        return 0;
+      }
+    }
+    sched_yield();
+  }
+}
+
+void rhd_shm_detach(rhd_shm_t *shm)
+{
+  munmap(shm->hdr, shm->size);
+  free(shm->name);
+  free(shm);
+}
+
+uint16_t *rhd_shm_claim(rhd_shm_t *shm, rhd_frame_hdr_t **hdr)
+{
+  rhd_shm_slot_t *slot = rhd_shm_slot(shm, shm->cursor);
+
+  __atomic_store_n(&slot->lock, 2 * shm->cursor + 1, __ATOMIC_RELAXED);
+  // The odd lock must be visible before any write to the slot
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  if (hdr != NULL)
+  {
+    *hdr = &slot->hdr;
+  }
+  return slot->samples;
+}
+
+void rhd_shm_publish(rhd_shm_t *shm)
+{
+  rhd_shm_slot_t *slot = rhd_shm_slot(shm, shm->cursor);
+
+  __atomic_store_n(&slot->lock, 2 * shm->cursor + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&shm->hdr->head, ++shm->cursor, __ATOMIC_RELEASE);
+}
+
+int rhd_shm_sample(rhd_shm_t *shm, rhd_device_t *dev, rhd_pacer_t *pacer,
+                   rhd_sample_fn_t fn)
+{
+  rhd_frame_hdr_t *hdr;
+  uint16_t *buf = rhd_shm_claim(shm, &hdr);
+  int ret = rhd_frame_sample(dev, pacer, fn, buf, hdr);
+  rhd_shm_publish(shm);
+  return ret;
+}
+
+void rhd_shm_destroy(rhd_shm_t *shm)
+{
+  if (shm->name != NULL)
+  {
+    shm_unlink(shm->name);
+  }
+  rhd_shm_detach(shm);
+}
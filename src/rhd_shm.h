@@ -0,0 +1,131 @@
+/** @file rhd_shm.h
+ *
+ * @brief Frame ring in POSIX shared memory, for consumers in other
+ * processes.
+ *
+ * The acquisition process creates a named ring (`shm_open` + `mmap`) and
+ * samples straight into its slots. Other processes attach to it by name and
+ * read frames with plain loads, without any system call or kernel copy.
+ *
+ * The ring is lock-free: the producer never waits for readers. Each slot is
+ * guarded by a sequence counter (seqlock), so a reader that falls more than
+ * a ring behind, or races with the producer rewriting a slot, detects it and
+ * counts the frames as lost instead of returning torn data.
+ *
+ * The consumer API, between the CFFI markers, only uses plain C types and an
+ * opaque handle so it can be declared as-is with CFFI, see
+ * `examples/python/shm`.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_SHM_H
+#define RHD_SHM_H
+
+#include "rhd.h"
+#include "rhd_frame.h"
+
+#define RHD_SHM_MAGIC 0x4D534852
+#define RHD_SHM_VERSION 1
+
+// CFFI START
+
+typedef struct rhd_shm rhd_shm_t;
+
+/**
+ * @brief Attach to a ring created by @ref rhd_shm_create. Reading starts at
+ * the next published frame.
+ *
+ * @param name shared memory object name, eg "/rhd0"
+ * @return rhd_shm_t* handle, NULL if the ring does not exist or is invalid
+ */
+rhd_shm_t *rhd_shm_attach(const char *name);
+
+/**
+ * @brief Samples per frame of the ring.
+ */
+size_t rhd_shm_frame_len(const rhd_shm_t *shm);
+
+/**
+ * @brief Number of frames the producer published so far.
+ */
+uint64_t rhd_shm_head(const rhd_shm_t *shm);
+
+/**
+ * @brief Frames this reader lost, overwritten before they could be read.
+ */
+uint64_t rhd_shm_lost(const rhd_shm_t *shm);
+
+/**
+ * @brief Copy out the next frames, in order.
+ *
+ * @param shm ring handle
+ * @param samples destination, `max_frames * frame_len` samples
+ * @param t_ns frame timestamps, `max_frames` long, can be NULL
+ * @param seq frame sequence numbers, `max_frames` long, can be NULL
+ * @param flags frame flags, `max_frames` long, can be NULL
+ * @param max_frames most frames to read
+ * @return size_t number of frames read, 0 if no new frame
+ */
+size_t rhd_shm_read(rhd_shm_t *shm, uint16_t *samples, uint64_t *t_ns,
+                    uint32_t *seq, uint32_t *flags, size_t max_frames);
+
+/**
+ * @brief Wait for a new frame by polling the ring.
+ *
+ * @param shm ring handle
+ * @param timeout_us time to wait [us], 0 to only check, negative to block
+ * @return int 1 if a frame is available, 0 on timeout
+ */
+int rhd_shm_wait(rhd_shm_t *shm, int timeout_us);
+
+/**
+ * @brief Detach from the ring, see @ref rhd_shm_attach.
+ */
+void rhd_shm_detach(rhd_shm_t *shm);
+
+// CFFI END
+
+/**
+ * @brief Create a named ring, replacing any previous one with the same name.
+ *
+ * @param name shared memory object name, eg "/rhd0"
+ * @param frame_len samples per frame, eg 64 for RHD2164
+ * @param capacity number of slots
+ * @return rhd_shm_t* producer handle, NULL on failure
+ */
+rhd_shm_t *rhd_shm_create(const char *name, size_t frame_len,
+                          uint32_t capacity);
+
+/**
+ * @brief Producer: get the next slot to fill, in place. Readers detect the
+ * slot as being rewritten until @ref rhd_shm_publish.
+ *
+ * @param shm producer handle
+ * @param hdr set to the slot's header, can be NULL
+ * @return uint16_t* slot samples
+ */
+uint16_t *rhd_shm_claim(rhd_shm_t *shm, rhd_frame_hdr_t **hdr);
+
+/**
+ * @brief Producer: make the claimed slot visible to readers.
+ */
+void rhd_shm_publish(rhd_shm_t *shm);
+
+/**
+ * @brief Producer: acquire a frame straight into the ring with
+ * @ref rhd_frame_sample, and publish it.
+ *
+ * @return int `fn` return code
+ */
+int rhd_shm_sample(rhd_shm_t *shm, rhd_device_t *dev, rhd_pacer_t *pacer,
+                   rhd_sample_fn_t fn);
+
+/**
+ * @brief Unmap the ring and remove its name. Attached readers keep their
+ * mapping until they detach.
+ */
+void rhd_shm_destroy(rhd_shm_t *shm);
+
+#endif /* RHD_SHM_H */
@@ -0,0 +1,264 @@
+/** @file rhd_sim.c
+ *
+ * @brief Software model of an RHD2000 chip.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_sim.h"
+#include <math.h>
+#include <string.h>
+
+static rhd_sim_t *rhd_sim_bound = NULL;
+
+/**
+ * @brief Interleave 2 bytes the way RHD2164's DDR MISO lines are sampled,
+ * ie the inverse of `rhd_unsplit_u16`.
+ *
+ * @param a MISO A byte, on odd bits
+ * @param b MISO B byte, on even bits
+ * @return uint16_t interleaved word
+ */
+static uint16_t rhd_sim_interleave(uint8_t a, uint8_t b);
+
+/**
+ * @brief Recover the byte sent in a bit-doubled MOSI word.
+ *
+ * @param word doubled word
+ * @return uint8_t original byte
+ */
+static uint8_t rhd_sim_undouble(uint16_t word);
+
+/**
+ * @brief Drive the selected electrode with the current injected by a DAC
+ * update through the impedance check capacitor.
+ *
+ * @param sim pointer to rhd_sim_t instance
+ * @param old_dac previous DAC value
+ * @param new_dac new DAC value
+ */
+static void rhd_sim_zcheck(rhd_sim_t *sim, uint8_t old_dac, uint8_t new_dac);
+
+static uint16_t rhd_sim_default_signal(void *ctx, int ch)
+{
+  (void)ctx;
+  return ch << 8;
+}
+
+void rhd_sim_init(rhd_sim_t *sim, uint8_t chip_id, bool double_bits)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->chip_id = chip_id;
+  sim->double_bits = double_bits;
+  sim->signal = rhd_sim_default_signal;
+
+  memcpy(&sim->regs[INTAN_0], "INTAN", 5);
+  sim->regs[MISO_A_B] = chip_id == RHD_SIM_RHD2164 ? 0x35 : 0;
+  sim->regs[UNI_BIPLR_AMPS] = chip_id == RHD_SIM_RHD2216 ? 1 : 0;
+  sim->regs[NB_AMP] = chip_id == RHD_SIM_RHD2164   ? 64
+                      : chip_id == RHD_SIM_RHD2216 ? 16
+                                                   : 32;
+  sim->regs[CHIP_ID] = chip_id;
+}
+
+void rhd_sim_set_signal(rhd_sim_t *sim, rhd_sim_signal_t signal, void *ctx)
+{
+  sim->signal = signal != NULL ? signal : rhd_sim_default_signal;
+  sim->ctx = ctx;
+}
+
+void rhd_sim_set_electrode(rhd_sim_t *sim, int ch, double rs, double rp,
+                           double cp, double fs)
+{
+  sim->z_fs = fs;
+  sim->z_rs[ch] = rs;
+  sim->z_rp[ch] = rp;
+  sim->z_cp[ch] = cp;
+  sim->z_vp[ch] = 0;
+}
+
+void rhd_sim_slip(rhd_sim_t *sim) { sim->n_slip++; }
+
+uint16_t rhd_sim_command(rhd_sim_t *sim, uint16_t cmd, uint16_t *res_b)
+{
+  uint8_t hi = cmd >> 8;
+  uint8_t reg = hi & 0x3F;
+  uint16_t a = 0;
+  uint16_t b = 0;
+
+  sim->n_cmd++;
+  switch (hi >> 6)
+  {
+  case 0:
+  {
+    // CONVERT
+    sim->n_convert++;
+    int n_amp = sim->chip_id == RHD_SIM_RHD2164 ? 32 : sim->regs[NB_AMP];
+    if (reg < n_amp)
+    {
+      int sel = sim->regs[IMP_CHK_AMP_SEL] & 0x3F;
+      int16_t dz = (int16_t)lround(sim->z_vout / RHD_ADC_STEP);
+      a = sim->signal(sim->ctx, reg);
+      a += sel == reg ? dz : 0;
+      if (sim->chip_id == RHD_SIM_RHD2164)
+      {
+        b = sim->signal(sim->ctx, reg + 32);
+        b += sel == reg + 32 ? dz : 0;
+      }
+    }
+    break;
+  }
+  case 1:
+    // CALIBRATE or CLEAR
+    if (hi == 0x55)
+    {
+      sim->n_calib++;
+    }
+    break;
+  case 2:
+  {
+    // WRITE
+    int n_reg = sim->chip_id == RHD_SIM_RHD2164 ? 22 : 18;
+    sim->n_write++;
+    if (reg == IMP_CHK_DAC)
+    {
+      rhd_sim_zcheck(sim, sim->regs[reg], cmd & 0xFF);
+    }
+    else if (reg == IMP_CHK_AMP_SEL)
+    {
+      sim->z_vout = 0;
+    }
+    if (reg < n_reg)
+    {
+      sim->regs[reg] = cmd & 0xFF;
+    }
+    a = 0xFF00 | (cmd & 0xFF);
+    b = a;
+    break;
+  }
+  default:
+    // READ
+    sim->n_read++;
+    a = sim->regs[reg];
+    b = reg == MISO_A_B && sim->chip_id == RHD_SIM_RHD2164 ? 0x3A : a;
+    break;
+  }
+
+  if (res_b != NULL)
+  {
+    *res_b = b;
+  }
+  return a;
+}
+
+int rhd_sim_xfer(rhd_sim_t *sim, const uint16_t *tx, uint16_t *rx, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    uint16_t cmd;
+
+    if (sim->n_slip > 0)
+    {
+      // Missed word: nothing is latched, nothing is shifted out
+      sim->n_slip--;
+      if (!sim->double_bits && sim->chip_id == RHD_SIM_RHD2164)
+      {
+        rx[2 * i] = 0;
+        rx[2 * i + 1] = 0;
+      }
+      else
+      {
+        rx[i] = 0;
+      }
+      continue;
+    }
+
+    if (sim->double_bits)
+    {
+      if (!sim->has_carry)
+      {
+        // First half: shift out the high byte of the pending result
+        rx[i] = rhd_sim_interleave(sim->pipe_a[0] >> 8, sim->pipe_b[0] >> 8);
+        sim->carry = tx[i];
+        sim->has_carry = true;
+        continue;
+      }
+      rx[i] = rhd_sim_interleave(sim->pipe_a[0] & 0xFF, sim->pipe_b[0] & 0xFF);
+      sim->has_carry = false;
+      cmd = ((uint16_t)rhd_sim_undouble(sim->carry) << 8) |
+            rhd_sim_undouble(tx[i]);
+    }
+    else if (sim->chip_id == RHD_SIM_RHD2164)
+    {
+      // Hardware flip-flop: MISO A and MISO B words for each command
+      rx[2 * i] = sim->pipe_a[0];
+      rx[2 * i + 1] = sim->pipe_b[0];
+      cmd = tx[i];
+    }
+    else
+    {
+      rx[i] = sim->pipe_a[0];
+      cmd = tx[i];
+    }
+
+    sim->pipe_a[0] = sim->pipe_a[1];
+    sim->pipe_b[0] = sim->pipe_b[1];
+    sim->pipe_a[1] = rhd_sim_command(sim, cmd, &sim->pipe_b[1]);
+  }
+  return len;
+}
+
+void rhd_sim_bind(rhd_sim_t *sim) { rhd_sim_bound = sim; }
+
+int rhd_sim_rw(uint16_t *tx_buf, uint16_t *rx_buf, size_t len)
+{
+  if (rhd_sim_bound == NULL)
+  {
+    return -1;
+  }
+  return rhd_sim_xfer(rhd_sim_bound, tx_buf, rx_buf, len);
+}
+
+static void rhd_sim_zcheck(rhd_sim_t *sim, uint8_t old_dac, uint8_t new_dac)
+{
+  // Zcheck scale [4:3]: 0.1 pF, 1 pF, reserved, 10 pF
+  static const double cap[4] = {0.1e-12, 1e-12, 0, 10e-12};
+  uint8_t ctrl = sim->regs[IMP_CHK_CTRL];
+  int ch = sim->regs[IMP_CHK_AMP_SEL] & 0x3F;
+
+  // Zcheck enable [0] and DAC power [6]
+  if (!(ctrl & 0x01) || !(ctrl & 0x40) || sim->z_fs <= 0)
+  {
+    sim->z_vout = 0;
+    return;
+  }
+
+  // Average current over one DAC update period
+  double i = cap[(ctrl >> 3) & 0x3] * ((int)new_dac - (int)old_dac) *
+             RHD_ZCHECK_DAC_STEP * sim->z_fs;
+  double tau = sim->z_rp[ch] * sim->z_cp[ch];
+  double a = tau > 0 ? exp(-1.0 / (sim->z_fs * tau)) : 0;
+
+  sim->z_vp[ch] = a * sim->z_vp[ch] + (1 - a) * sim->z_rp[ch] * i;
+  sim->z_vout = sim->z_rs[ch] * i + sim->z_vp[ch];
+}
+
+static uint16_t rhd_sim_interleave(uint8_t a, uint8_t b)
+{
+  uint16_t out = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    out |= (((a >> i) & 1) << (2 * i + 1)) | (((b >> i) & 1) << (2 * i));
+  }
+  return out;
+}
+
+static uint8_t rhd_sim_undouble(uint16_t word)
+{
+  uint8_t out = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    out |= ((word >> (2 * i + 1)) & 1) << i;
+  }
+  return out;
+}
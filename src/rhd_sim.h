@@ -0,0 +1,148 @@
+/** @file rhd_sim.h
+ *
+ * @brief Software model of an RHD2000 chip, usable as an `rhd_rw_t` transport
+ * for tests and benchmarks without hardware.
+ *
+ * It models the register file, the ROM registers, the 2-command result
+ * pipeline, RHD2164's second MISO line and the DDR bit doubling.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_SIM_H
+#define RHD_SIM_H
+
+#include "rhd.h"
+
+#define RHD_SIM_RHD2132 1
+#define RHD_SIM_RHD2216 2
+#define RHD_SIM_RHD2164 4
+
+/**
+ * @brief Simulated ADC signal source.
+ *
+ * @param ctx user context
+ * @param ch amplifier channel being converted, [0-63] for RHD2164, MISO B
+ * channels being `ch + 32`
+ * @return 16-bit ADC result
+ */
+typedef uint16_t (*rhd_sim_signal_t)(void *ctx, int ch);
+
+typedef struct
+{
+  uint8_t chip_id;
+  bool double_bits;
+  uint8_t regs[64];
+
+  /** Results of the last 2 commands, [0] being shifted out next */
+  uint16_t pipe_a[2];
+  uint16_t pipe_b[2];
+  /** DDR half-command waiting for its second word */
+  uint16_t carry;
+  bool has_carry;
+
+  rhd_sim_signal_t signal;
+  void *ctx;
+
+  /** Electrode models for impedance checks, see @ref rhd_sim_set_electrode */
+  double z_fs;
+  double z_rs[64];
+  double z_rp[64];
+  double z_cp[64];
+  double z_vp[64];
+  /** Voltage across the selected electrode since the last DAC update [V] */
+  double z_vout;
+
+  /** Transmitted words the chip will miss, see @ref rhd_sim_slip */
+  uint32_t n_slip;
+
+  uint32_t n_cmd;
+  uint32_t n_convert;
+  uint32_t n_write;
+  uint32_t n_read;
+  uint32_t n_calib;
+} rhd_sim_t;
+
+/**
+ * @brief Initialize a simulated chip.
+ *
+ * @param sim pointer to rhd_sim_t instance
+ * @param chip_id one of `RHD_SIM_RHD2132`, `RHD_SIM_RHD2216`, `RHD_SIM_RHD2164`
+ * @param double_bits true if the driver's transport doubles the bits, see
+ * @ref rhd_init
+ */
+void rhd_sim_init(rhd_sim_t *sim, uint8_t chip_id, bool double_bits);
+
+/**
+ * @brief Set the signal returned by CONVERT commands. By default, channel
+ * `ch` returns `ch << 8`.
+ *
+ * @param sim pointer to rhd_sim_t instance
+ * @param signal signal callback
+ * @param ctx context passed to `signal`
+ */
+void rhd_sim_set_signal(rhd_sim_t *sim, rhd_sim_signal_t signal, void *ctx);
+
+/**
+ * @brief Model electrode `ch` as `rs` in series with `rp || cp`, driven by
+ * the impedance check DAC. The DAC is assumed to be updated once per sample
+ * of the selected channel, at `fs`.
+ *
+ * @param sim pointer to rhd_sim_t instance
+ * @param ch amplifier channel [0-63]
+ * @param rs series resistance [Ohm]
+ * @param rp parallel resistance [Ohm]
+ * @param cp parallel capacitance [F], 0 for a purely resistive electrode
+ * @param fs DAC update rate [Hz]
+ */
+void rhd_sim_set_electrode(rhd_sim_t *sim, int ch, double rs, double rp,
+                           double cp, double fs);
+
+/**
+ * @brief Inject a transport glitch: the chip misses the next transmitted
+ * word. In DDR mode, this shifts the pairing of every following command's
+ * halves until the driver resynchronizes.
+ *
+ * @param sim pointer to rhd_sim_t instance
+ */
+void rhd_sim_slip(rhd_sim_t *sim);
+
+/**
+ * @brief Execute a single 16-bit command.
+ *
+ * @param sim pointer to rhd_sim_t instance
+ * @param cmd command
+ * @param res_b MISO B result of `cmd`, can be NULL
+ * @return MISO A result of `cmd`
+ */
+uint16_t rhd_sim_command(rhd_sim_t *sim, uint16_t cmd, uint16_t *res_b);
+
+/**
+ * @brief Clock a transfer through the simulated chip, with the same semantics
+ * as @ref rhd_rw_t. In non-doubled mode, RHD2164 behaves like a hardware
+ * flip-flop and returns 2 words (MISO A, MISO B) per command, other chips
+ * return one.
+ *
+ * @param sim pointer to rhd_sim_t instance
+ * @param tx write buffer
+ * @param rx receive buffer, `2 * len` words long for RHD2164 in non-doubled
+ * mode
+ * @param len number of 16-bit words
+ * @return int `len`
+ */
+int rhd_sim_xfer(rhd_sim_t *sim, const uint16_t *tx, uint16_t *rx, size_t len);
+
+/**
+ * @brief Select the instance used by @ref rhd_sim_rw.
+ *
+ * @param sim pointer to rhd_sim_t instance
+ */
+void rhd_sim_bind(rhd_sim_t *sim);
+
+/**
+ * @brief `rhd_rw_t` transport to the bound simulated chip.
+ */
+int rhd_sim_rw(uint16_t *tx_buf, uint16_t *rx_buf, size_t len);
+
+#endif /* RHD_SIM_H */
@@ -0,0 +1,269 @@
+/** @file rhd_snapshot.c
+ *
+ * @brief Configuration snapshots and warm start.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_snapshot.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RHD_SNAPSHOT_VERSION 1
+
+static const uint8_t RHD_SNAPSHOT_MAGIC[4] = {'R', 'H', 'D', 'S'};
+
+/**
+ * @brief Read registers `regs[0..n-1]` in one pipelined burst.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @param rhd2164 true if the chip returns both MISO lines
+ * @param regs registers to read
+ * @param vals register values
+ * @param n number of registers, at most `RHD_BURST_LEN - 2`
+ * @return int `rw` return code
+ */
+static int rhd_snapshot_read(rhd_device_t *dev, bool rhd2164,
+                             const uint8_t *regs, uint8_t *vals, size_t n)
+{
+  uint16_t cmds[RHD_BURST_LEN] = {0};
+  uint16_t rx_a[RHD_BURST_LEN];
+  uint16_t rx_b[RHD_BURST_LEN];
+
+  for (size_t i = 0; i < n + 2; i++)
+  {
+    // 2 dummy reads flush the pipeline
+    cmds[i] = (0xC0 | (i < n ? regs[i] : CHIP_ID)) << 8;
+  }
+  int ret = rhd_send_burst(dev, cmds, rx_a, rhd2164 ? rx_b : NULL, n + 2);
+  for (size_t i = 0; i < n; i++)
+  {
+    vals[i] = rx_a[i + 2] & 0xFF;
+  }
+  return ret;
+}
+
+static void rhd_snapshot_put_u32(uint8_t *buf, uint32_t val)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    buf[i] = (val >> (8 * i)) & 0xFF;
+  }
+}
+
+static uint32_t rhd_snapshot_get_u32(const uint8_t *buf)
+{
+  uint32_t val = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    val |= (uint32_t)buf[i] << (8 * i);
+  }
+  return val;
+}
+
+static void rhd_snapshot_put_f32(uint8_t *buf, float val)
+{
+  uint32_t u;
+  memcpy(&u, &val, sizeof(u));
+  rhd_snapshot_put_u32(buf, u);
+}
+
+static float rhd_snapshot_get_f32(const uint8_t *buf)
+{
+  uint32_t u = rhd_snapshot_get_u32(buf);
+  float val;
+  memcpy(&val, &u, sizeof(val));
+  return val;
+}
+
+/**
+ * @brief FNV-1a hash, used as the image checksum.
+ */
+static uint32_t rhd_snapshot_fnv1a(const uint8_t *buf, size_t len)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+  {
+    h = (h ^ buf[i]) * 16777619u;
+  }
+  return h;
+}
+
+int rhd_snapshot_capture(rhd_device_t *dev, float fs, float fl, float fh,
+                         bool dsp, float fdsp, rhd_snapshot_t *snap)
+{
+  uint8_t regs[RHD_SNAPSHOT_MAX_REGS];
+
+  memset(snap, 0, sizeof(*snap));
+  snap->double_bits = dev->double_bits;
+  snap->chip_id = rhd_read_force(dev, CHIP_ID);
+  snap->n_regs =
+      snap->chip_id == RHD_CHIP_RHD2164 ? RHD_SNAPSHOT_MAX_REGS : 18;
+  snap->fs = fs;
+  snap->fl = fl;
+  snap->fh = fh;
+  snap->dsp = dsp;
+  snap->fdsp = fdsp;
+
+  for (int i = 0; i < snap->n_regs; i++)
+  {
+    regs[i] = i;
+  }
+  return rhd_snapshot_read(dev, snap->chip_id == RHD_CHIP_RHD2164, regs,
+                           snap->regs, snap->n_regs);
+}
+
+int rhd_snapshot_verify(rhd_device_t *dev, const rhd_snapshot_t *snap)
+{
+  // INTAN ROM, CHIP_ID, then the register image
+  uint8_t regs[6 + RHD_SNAPSHOT_MAX_REGS];
+  uint8_t expected[6 + RHD_SNAPSHOT_MAX_REGS];
+  uint8_t vals[6 + RHD_SNAPSHOT_MAX_REGS];
+  size_t n = 0;
+
+  if (snap->n_regs > RHD_SNAPSHOT_MAX_REGS)
+  {
+    return -1;
+  }
+  for (int i = 0; i < 5; i++, n++)
+  {
+    regs[n] = INTAN_0 + i;
+    expected[n] = "INTAN"[i];
+  }
+  regs[n] = CHIP_ID;
+  expected[n++] = snap->chip_id;
+  for (int i = 0; i < snap->n_regs; i++, n++)
+  {
+    regs[n] = i;
+    expected[n] = snap->regs[i];
+  }
+
+  int ret =
+      rhd_snapshot_read(dev, snap->chip_id == RHD_CHIP_RHD2164, regs, vals, n);
+  if (ret < 0)
+  {
+    return ret;
+  }
+
+  int n_bad = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    n_bad += vals[i] != expected[i];
+  }
+  return n_bad;
+}
+
+size_t rhd_snapshot_serialize(const rhd_snapshot_t *snap, uint8_t *buf)
+{
+  // Little-endian layout:
+  // [0:4] magic, [4] version, [5] flags, [6] chip id, [7] n_regs,
+  // [8:30] regs, [30:32] reserved, [32:48] fs, fl, fh, fdsp, [48:52] checksum
+  memset(buf, 0, RHD_SNAPSHOT_SIZE);
+  memcpy(buf, RHD_SNAPSHOT_MAGIC, 4);
+  buf[4] = RHD_SNAPSHOT_VERSION;
+  buf[5] = ((int)snap->double_bits) | (((int)snap->dsp) << 1);
+  buf[6] = snap->chip_id;
+  buf[7] = snap->n_regs;
+  memcpy(&buf[8], snap->regs, RHD_SNAPSHOT_MAX_REGS);
+  rhd_snapshot_put_f32(&buf[32], snap->fs);
+  rhd_snapshot_put_f32(&buf[36], snap->fl);
+  rhd_snapshot_put_f32(&buf[40], snap->fh);
+  rhd_snapshot_put_f32(&buf[44], snap->fdsp);
+  rhd_snapshot_put_u32(&buf[48], rhd_snapshot_fnv1a(buf, 48));
+  return RHD_SNAPSHOT_SIZE;
+}
+
+int rhd_snapshot_deserialize(rhd_snapshot_t *snap, const uint8_t *buf,
+                             size_t len)
+{
+  if (len < RHD_SNAPSHOT_SIZE || memcmp(buf, RHD_SNAPSHOT_MAGIC, 4) != 0 ||
+      buf[4] != RHD_SNAPSHOT_VERSION || buf[7] > RHD_SNAPSHOT_MAX_REGS ||
+      rhd_snapshot_get_u32(&buf[48]) != rhd_snapshot_fnv1a(buf, 48))
+  {
+    return -1;
+  }
+
+  memset(snap, 0, sizeof(*snap));
+  snap->double_bits = buf[5] & 0x01;
+  snap->dsp = (buf[5] >> 1) & 0x01;
+  snap->chip_id = buf[6];
+  snap->n_regs = buf[7];
+  memcpy(snap->regs, &buf[8], snap->n_regs);
+  snap->fs = rhd_snapshot_get_f32(&buf[32]);
+  snap->fl = rhd_snapshot_get_f32(&buf[36]);
+  snap->fh = rhd_snapshot_get_f32(&buf[40]);
+  snap->fdsp = rhd_snapshot_get_f32(&buf[44]);
+  return 0;
+}
+
+int rhd_snapshot_save(const rhd_snapshot_t *snap, const char *path)
+{
+  uint8_t buf[RHD_SNAPSHOT_SIZE];
+  size_t len = rhd_snapshot_serialize(snap, buf);
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL)
+  {
+    return -1;
+  }
+  int ret = fwrite(buf, 1, len, f) == len ? 0 : -1;
+  if (fclose(f) != 0)
+  {
+    ret = -1;
+  }
+  return ret;
+}
+
+int rhd_snapshot_load(rhd_snapshot_t *snap, const char *path)
+{
+  uint8_t buf[RHD_SNAPSHOT_SIZE];
+
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+  {
+    return -1;
+  }
+  size_t len = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+  return rhd_snapshot_deserialize(snap, buf, len);
+}
+
+int rhd_warm_start(rhd_device_t *dev, bool mode, rhd_rw_t rw, float fs,
+                   float fl, float fh, bool dsp, float fdsp,
+                   rhd_snapshot_t *snap, bool *warm)
+{
+  dev->double_bits = mode;
+  dev->rw = rw;
+  dev->engine = NULL;
+
+  bool same_cfg = snap != NULL && snap->double_bits == mode &&
+                  snap->fs == fs && snap->fl == fl && snap->fh == fh &&
+                  snap->dsp == dsp && snap->fdsp == fdsp;
+  if (same_cfg && rhd_snapshot_verify(dev, snap) == 0)
+  {
+    // CHIP_ID was just verified
+    dev->engine = rhd_engine_find(snap->chip_id, mode);
+    if (warm != NULL)
+    {
+      *warm = true;
+    }
+    return 0;
+  }
+
+  if (warm != NULL)
+  {
+    *warm = false;
+  }
+  int ret = rhd_init(dev, mode, rw);
+  if (ret != 0)
+  {
+    return ret;
+  }
+  ret = rhd_setup(dev, fs, fl, fh, dsp, fdsp);
+  if (ret != 0 || snap == NULL)
+  {
+    return ret;
+  }
+  int r = rhd_snapshot_capture(dev, fs, fl, fh, dsp, fdsp, snap);
+  return r < 0 ? r : 0;
+}
@@ -0,0 +1,132 @@
+/** @file rhd_snapshot.h
+ *
+ * @brief Configuration snapshots and warm start.
+ *
+ * A snapshot holds what `rhd_setup` applied to the chip: the writable
+ * register image, the SPI mode and the setup parameters. On the next start,
+ * @ref rhd_warm_start verifies the chip against the snapshot with a single
+ * pipelined burst of reads, and only runs the full `rhd_init` / `rhd_setup`
+ * sequence (register writes, calibration, sanity checks) when something
+ * differs.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_SNAPSHOT_H
+#define RHD_SNAPSHOT_H
+
+#include "rhd.h"
+
+/** Number of writable registers, RHD2164 included */
+#define RHD_SNAPSHOT_MAX_REGS 22
+/** Size of a serialized snapshot [bytes] */
+#define RHD_SNAPSHOT_SIZE 52
+
+typedef struct
+{
+  /** SPI mode, see @ref rhd_init */
+  bool double_bits;
+  /** CHIP_ID register (63) */
+  uint8_t chip_id;
+  /** Number of valid entries in `regs`: 22 for RHD2164, 18 otherwise */
+  uint8_t n_regs;
+  /** Register image, registers 0 to `n_regs - 1` */
+  uint8_t regs[RHD_SNAPSHOT_MAX_REGS];
+
+  /** @ref rhd_setup parameters */
+  float fs;
+  float fl;
+  float fh;
+  bool dsp;
+  float fdsp;
+} rhd_snapshot_t;
+
+/**
+ * @brief Read back the chip configuration into a snapshot.
+ *
+ * @param dev pointer to rhd_device_t instance, configured with `rhd_setup`
+ * @param fs `rhd_setup` sampling rate [Hz]
+ * @param fl `rhd_setup` amplifier lowpass frequency [Hz]
+ * @param fh `rhd_setup` amplifier highpass frequency [Hz]
+ * @param dsp `rhd_setup` dsp enable
+ * @param fdsp `rhd_setup` DSP cutoff frequency [Hz]
+ * @param snap snapshot to fill
+ * @return int `rw` return code, negative on transport failure
+ */
+int rhd_snapshot_capture(rhd_device_t *dev, float fs, float fl, float fh,
+                         bool dsp, float fdsp, rhd_snapshot_t *snap);
+
+/**
+ * @brief Compare the chip against a snapshot: INTAN ROM, CHIP_ID and the
+ * register image are read back in a single pipelined burst.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @param snap snapshot to compare against
+ * @return int number of mismatching registers, 0 if the chip matches,
+ * negative on transport failure
+ */
+int rhd_snapshot_verify(rhd_device_t *dev, const rhd_snapshot_t *snap);
+
+/**
+ * @brief Serialize a snapshot into a portable, checksummed byte image.
+ *
+ * @param snap snapshot to serialize
+ * @param buf destination, at least `RHD_SNAPSHOT_SIZE` bytes
+ * @return size_t number of bytes written, `RHD_SNAPSHOT_SIZE`
+ */
+size_t rhd_snapshot_serialize(const rhd_snapshot_t *snap, uint8_t *buf);
+
+/**
+ * @brief Deserialize a snapshot written by @ref rhd_snapshot_serialize.
+ *
+ * @param snap snapshot to fill
+ * @param buf source
+ * @param len source length [bytes]
+ * @return int 0 for success, -1 if the image is truncated, has a wrong
+ * magic/version or a bad checksum
+ */
+int rhd_snapshot_deserialize(rhd_snapshot_t *snap, const uint8_t *buf,
+                             size_t len);
+
+/**
+ * @brief Save a snapshot to a file.
+ *
+ * @return int 0 for success, -1 on I/O error
+ */
+int rhd_snapshot_save(const rhd_snapshot_t *snap, const char *path);
+
+/**
+ * @brief Load a snapshot from a file.
+ *
+ * @return int 0 for success, -1 on I/O error or invalid image
+ */
+int rhd_snapshot_load(rhd_snapshot_t *snap, const char *path);
+
+/**
+ * @brief Bring the device up, skipping `rhd_setup` if the chip already
+ * matches `snap`.
+ *
+ * The warm path costs one burst of reads. If `snap` is missing, was taken
+ * with other parameters or another SPI mode, or the chip does not match it,
+ * the device goes through `rhd_init` and `rhd_setup`, and `snap` is
+ * refreshed from the chip, ready to be saved.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @param mode see @ref rhd_init
+ * @param rw see @ref rhd_init
+ * @param fs see @ref rhd_setup
+ * @param fl see @ref rhd_setup
+ * @param fh see @ref rhd_setup
+ * @param dsp see @ref rhd_setup
+ * @param fdsp see @ref rhd_setup
+ * @param snap previous snapshot, can be NULL. Updated on a cold start.
+ * @param warm set to true if setup was skipped, can be NULL
+ * @return int sanity check result, 0 for success, see @ref rhd_setup.
+ * Negative on transport failure.
+ */
+int rhd_warm_start(rhd_device_t *dev, bool mode, rhd_rw_t rw, float fs,
+                   float fl, float fh, bool dsp, float fdsp,
+                   rhd_snapshot_t *snap, bool *warm);
+
+#endif /* RHD_SNAPSHOT_H */
@@ -0,0 +1,283 @@
+/** @file rhd_spatial.c
+ *
+ * @brief Spatial filters for electrode grids.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_spatial.h"
+#include <string.h>
+
+/**
+ * @brief Frame channel at `(r, c)`, -1 outside the grid or without
+ * electrode.
+ */
+static int rhd_spatial_at(const rhd_spatial_grid_t *grid, int r, int c)
+{
+  if (r < 0 || c < 0 || r >= grid->rows || c >= grid->cols)
+  {
+    return -1;
+  }
+  return grid->ch[r * grid->cols + c];
+}
+
+/**
+ * @brief Compile output `o` for the current bad channels.
+ */
+static void rhd_spatial_build(rhd_spatial_t *sf, size_t o)
+{
+  const rhd_spatial_grid_t *grid = &sf->grid;
+  const int r = sf->out_pos[o] / grid->cols;
+  const int c = sf->out_pos[o] % grid->cols;
+  const int center = grid->ch[sf->out_pos[o]];
+  int ch[RHD_SPATIAL_MAX_TAPS];
+  float w[RHD_SPATIAL_MAX_TAPS];
+  int n_taps = 0;
+  bool ok = true;
+
+  ch[n_taps] = center;
+  w[n_taps++] = 1;
+  switch (sf->op)
+  {
+  case RHD_SPATIAL_MONO:
+    break;
+  case RHD_SPATIAL_BIPOLAR_ROW:
+  case RHD_SPATIAL_BIPOLAR_COL:
+  {
+    bool row = sf->op == RHD_SPATIAL_BIPOLAR_ROW;
+    ch[n_taps] = rhd_spatial_at(grid, r + !row, c + row);
+    w[0] = -1;
+    w[n_taps++] = 1;
+    break;
+  }
+  case RHD_SPATIAL_LAPLACIAN:
+  {
+    const int dr[4] = {-1, 1, 0, 0};
+    const int dc[4] = {0, 0, -1, 1};
+    w[0] = 0;
+    for (int i = 0; i < 4; i++)
+    {
+      int nb = rhd_spatial_at(grid, r + dr[i], c + dc[i]);
+      if (nb < 0)
+      {
+        continue;
+      }
+      sf->foot[o] |= (uint64_t)1 << nb;
+      if ((sf->bad >> nb) & 1)
+      {
+        continue;
+      }
+      ch[n_taps] = nb;
+      w[n_taps++] = -1;
+      w[0] += 1;
+    }
+    ok = n_taps > 1;
+    break;
+  }
+  }
+
+  float sum = 0;
+  for (int i = 0; i < n_taps; i++)
+  {
+    sf->foot[o] |= (uint64_t)1 << ch[i];
+    ok = ok && !((sf->bad >> ch[i]) & 1);
+  }
+  for (int i = 0; i < RHD_SPATIAL_MAX_TAPS; i++)
+  {
+    // Unused taps read the center with a null weight
+    sf->tap_ch[o][i] = i < n_taps ? ch[i] : center;
+    sf->tap_w[o][i] = ok && i < n_taps ? w[i] : 0;
+    sum += sf->tap_w[o][i];
+  }
+  sf->car_coef[o] = sf->car ? sum : 0;
+  if (ok)
+  {
+    sf->valid |= (uint64_t)1 << o;
+  }
+  else
+  {
+    sf->valid &= ~((uint64_t)1 << o);
+  }
+}
+
+/**
+ * @brief Weights of the mean over the good channels of the grid.
+ */
+static void rhd_spatial_build_mean(rhd_spatial_t *sf)
+{
+  uint64_t good = 0;
+  for (int i = 0; i < sf->grid.rows * sf->grid.cols; i++)
+  {
+    if (sf->grid.ch[i] >= 0)
+    {
+      good |= (uint64_t)1 << sf->grid.ch[i];
+    }
+  }
+  good &= ~sf->bad;
+
+  int n_good = __builtin_popcountll(good);
+  for (int ch = 0; ch < RHD_SPATIAL_MAX_CH; ch++)
+  {
+    sf->mean_w[ch] = (good >> ch) & 1 ? 1.0f / n_good : 0;
+  }
+}
+
+void rhd_spatial_grid_init(rhd_spatial_grid_t *grid, uint8_t rows,
+                           uint8_t cols, int first_ch, bool legacy_order)
+{
+  grid->rows = rows;
+  grid->cols = cols;
+  for (int i = 0; i < RHD_SPATIAL_MAX_CH; i++)
+  {
+    int ch = first_ch + i;
+    // rhd2164_sample_all stores channel 30 at index 31 and vice versa
+    if (legacy_order && ch % 32 >= 30)
+    {
+      ch ^= 1;
+    }
+    grid->ch[i] = i < rows * cols ? ch : -1;
+  }
+}
+
+int rhd_spatial_init(rhd_spatial_t *sf, const rhd_spatial_grid_t *grid,
+                     rhd_spatial_op_t op, bool car, bool twos_comp)
+{
+  const int n_pos = grid->rows * grid->cols;
+  if (n_pos == 0 || n_pos > RHD_SPATIAL_MAX_CH || op < RHD_SPATIAL_MONO ||
+      op > RHD_SPATIAL_LAPLACIAN)
+  {
+    return -1;
+  }
+
+  memset(sf, 0, sizeof(*sf));
+  sf->grid = *grid;
+  sf->op = op;
+  sf->car = car;
+  sf->flip = twos_comp ? 0 : 0x8000;
+
+  for (int pos = 0; pos < n_pos; pos++)
+  {
+    int ch = grid->ch[pos];
+    if (ch < 0)
+    {
+      continue;
+    }
+    if (ch >= RHD_SPATIAL_MAX_CH)
+    {
+      return -1;
+    }
+    if ((size_t)ch + 1 > sf->n_in)
+    {
+      sf->n_in = ch + 1;
+    }
+
+    int r = pos / grid->cols;
+    int c = pos % grid->cols;
+    if ((op == RHD_SPATIAL_BIPOLAR_ROW && rhd_spatial_at(grid, r, c + 1) < 0) ||
+        (op == RHD_SPATIAL_BIPOLAR_COL && rhd_spatial_at(grid, r + 1, c) < 0))
+    {
+      continue;
+    }
+    sf->out_pos[sf->n_out++] = pos;
+  }
+
+  for (size_t o = 0; o < sf->n_out; o++)
+  {
+    rhd_spatial_build(sf, o);
+  }
+  rhd_spatial_build_mean(sf);
+  return 0;
+}
+
+int rhd_spatial_set_bad(rhd_spatial_t *sf, int ch, bool bad)
+{
+  if (ch < 0 || (size_t)ch >= sf->n_in)
+  {
+    return -1;
+  }
+  const uint64_t bit = (uint64_t)1 << ch;
+  if (((sf->bad & bit) != 0) == bad)
+  {
+    return 0;
+  }
+  sf->bad ^= bit;
+
+  for (size_t o = 0; o < sf->n_out; o++)
+  {
+    if (sf->foot[o] & bit)
+    {
+      rhd_spatial_build(sf, o);
+    }
+  }
+  if (sf->car)
+  {
+    rhd_spatial_build_mean(sf);
+  }
+  return 0;
+}
+
+void rhd_spatial_apply(const rhd_spatial_t *sf, const uint16_t *frames,
+                       size_t frame_len, size_t n_frames, float *out)
+{
+  float xt[RHD_SPATIAL_MAX_CH][RHD_SPATIAL_BLOCK];
+  float yt[RHD_SPATIAL_MAX_CH][RHD_SPATIAL_BLOCK];
+  float mean[RHD_SPATIAL_BLOCK];
+
+  for (size_t off = 0; off < n_frames; off += RHD_SPATIAL_BLOCK)
+  {
+    const size_t nb = n_frames - off < RHD_SPATIAL_BLOCK ? n_frames - off
+                                                         : RHD_SPATIAL_BLOCK;
+    const uint16_t *block = &frames[off * frame_len];
+
+    // Transpose, so the kernels below vectorize across frames
+    for (size_t ch = 0; ch < sf->n_in; ch++)
+    {
+      for (size_t f = 0; f < nb; f++)
+      {
+        xt[ch][f] = (int16_t)(block[f * frame_len + ch] ^ sf->flip);
+      }
+    }
+
+    for (size_t f = 0; f < nb; f++)
+    {
+      mean[f] = 0;
+    }
+    if (sf->car)
+    {
+      for (size_t ch = 0; ch < sf->n_in; ch++)
+      {
+        const float w = sf->mean_w[ch];
+        for (size_t f = 0; f < nb; f++)
+        {
+          mean[f] += w * xt[ch][f];
+        }
+      }
+    }
+
+    for (size_t o = 0; o < sf->n_out; o++)
+    {
+      const uint8_t *tc = sf->tap_ch[o];
+      const float *tw = sf->tap_w[o];
+      const float *x0 = xt[tc[0]];
+      const float *x1 = xt[tc[1]];
+      const float *x2 = xt[tc[2]];
+      const float *x3 = xt[tc[3]];
+      const float *x4 = xt[tc[4]];
+      const float cc = sf->car_coef[o];
+      for (size_t f = 0; f < nb; f++)
+      {
+        yt[o][f] = tw[0] * x0[f] + tw[1] * x1[f] + tw[2] * x2[f] +
+                   tw[3] * x3[f] + tw[4] * x4[f] - cc * mean[f];
+      }
+    }
+
+    for (size_t f = 0; f < nb; f++)
+    {
+      float *row = &out[(off + f) * sf->n_out];
+      for (size_t o = 0; o < sf->n_out; o++)
+      {
+        row[o] = yt[o][f];
+      }
+    }
+  }
+}
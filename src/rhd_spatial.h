@@ -0,0 +1,133 @@
+/** @file rhd_spatial.h
+ *
+ * @brief Spatial filters for electrode grids: common average reference
+ * (CAR), bipolar and Laplacian.
+ *
+ * A grid maps each electrode position to a frame index, the channel in the
+ * frames of `rhd_sample_all`. The frames of `rhd2164_sample_all` store
+ * channels 30 and 31 (62 and 63) swapped, which `rhd_spatial_grid_init`
+ * follows with `legacy_order`. Every operator is compiled to at most
+ * `RHD_SPATIAL_MAX_TAPS` weighted channels per output; CAR is fused into it
+ * as a correction proportional to the frame's mean, since referencing then
+ * filtering is `sum(w * (x - mean)) = sum(w * x) - sum(w) * mean`. Frames are
+ * processed in blocks, transposed so the kernels vectorize across frames.
+ *
+ * Bad channels are excluded from the mean and from the outputs that use
+ * them: a Laplacian uses its remaining neighbours, and outputs left without
+ * a valid value are 0. Marking a channel only recompiles the outputs
+ * around it.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_SPATIAL_H
+#define RHD_SPATIAL_H
+
+#include "rhd.h"
+
+#define RHD_SPATIAL_MAX_CH 64
+/** Center and 4 neighbours */
+#define RHD_SPATIAL_MAX_TAPS 5
+/** Frames per processing block */
+#define RHD_SPATIAL_BLOCK 32
+
+typedef enum
+{
+  /** Each electrode, referenced to the chip or to the average with CAR */
+  RHD_SPATIAL_MONO = 0,
+  /** Next electrode in the row minus this one */
+  RHD_SPATIAL_BIPOLAR_ROW = 1,
+  /** Next electrode in the column minus this one */
+  RHD_SPATIAL_BIPOLAR_COL = 2,
+  /** This electrode times the number of neighbours minus the neighbours */
+  RHD_SPATIAL_LAPLACIAN = 3,
+} rhd_spatial_op_t;
+
+typedef struct
+{
+  uint8_t rows;
+  uint8_t cols;
+  /** Frame channel of each position, row-major, -1 for no electrode */
+  int8_t ch[RHD_SPATIAL_MAX_CH];
+} rhd_spatial_grid_t;
+
+typedef struct
+{
+  rhd_spatial_grid_t grid;
+  rhd_spatial_op_t op;
+  bool car;
+  uint16_t flip;
+  /** Bad frame channels */
+  uint64_t bad;
+  /** Frame channels read, up to the grid's highest one */
+  size_t n_in;
+
+  /** Number of outputs, fixed by the grid and operator */
+  size_t n_out;
+  /** Grid position of each output */
+  uint8_t out_pos[RHD_SPATIAL_MAX_CH];
+  /** Outputs with a value, the others are 0 */
+  uint64_t valid;
+
+  /** Frame channels each output uses when no channel is bad */
+  uint64_t foot[RHD_SPATIAL_MAX_CH];
+  uint8_t tap_ch[RHD_SPATIAL_MAX_CH][RHD_SPATIAL_MAX_TAPS];
+  float tap_w[RHD_SPATIAL_MAX_CH][RHD_SPATIAL_MAX_TAPS];
+  /** Sum of each output's weights, times the mean with CAR */
+  float car_coef[RHD_SPATIAL_MAX_CH];
+  /** Weight of each frame channel in the mean */
+  float mean_w[RHD_SPATIAL_MAX_CH];
+} rhd_spatial_t;
+
+/**
+ * @brief Row-major grid over consecutive channels.
+ *
+ * @param grid grid to fill
+ * @param rows number of rows
+ * @param cols number of columns, `rows * cols` at most `RHD_SPATIAL_MAX_CH`
+ * @param first_ch channel of the first position
+ * @param legacy_order frames from `rhd2164_sample_all`, false for
+ * `rhd_sample_all`
+ */
+void rhd_spatial_grid_init(rhd_spatial_grid_t *grid, uint8_t rows,
+                           uint8_t cols, int first_ch, bool legacy_order);
+
+/**
+ * @brief Compile a filter.
+ *
+ * @param sf pointer to rhd_spatial_t instance
+ * @param grid electrode grid, copied
+ * @param op spatial operator
+ * @param car apply the common average reference first
+ * @param twos_comp true if samples are two's complement, see `rhd_cfg_dsp`
+ * @return int 0 for success, -1 for an invalid grid
+ */
+int rhd_spatial_init(rhd_spatial_t *sf, const rhd_spatial_grid_t *grid,
+                     rhd_spatial_op_t op, bool car, bool twos_comp);
+
+/**
+ * @brief Mark a frame channel bad or good again, recompiling the outputs
+ * that use it.
+ *
+ * @param sf pointer to rhd_spatial_t instance
+ * @param ch frame channel
+ * @param bad true to exclude the channel
+ * @return int 0 for success, -1 for a channel outside the filter's `n_in`
+ */
+int rhd_spatial_set_bad(rhd_spatial_t *sf, int ch, bool bad);
+
+/**
+ * @brief Filter frames.
+ *
+ * @param sf pointer to rhd_spatial_t instance
+ * @param frames `n_frames` frames of `frame_len` samples, in the order of
+ * the grid
+ * @param frame_len samples per frame, covering every channel of the grid
+ * @param n_frames number of frames
+ * @param out `n_frames` rows of `n_out` outputs [ADC steps]
+ */
+void rhd_spatial_apply(const rhd_spatial_t *sf, const uint16_t *frames,
+                       size_t frame_len, size_t n_frames, float *out);
+
+#endif /* RHD_SPATIAL_H */
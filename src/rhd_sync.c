@@ -0,0 +1,239 @@
+/** @file rhd_sync.c
+ *
+ * @brief Online frame integrity check and command pipeline resync.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_sync.h"
+
+/** Probe frame: 32 CONVERTs, the probe READ, then CONVERT 30 and 31 again */
+#define RHD_SYNC_PROBE_LEN 35
+
+static rhd_sync_t *rhd_sync_bound = NULL;
+
+/**
+ * @brief Count the samples at the ADC rails.
+ */
+static uint32_t rhd_sync_n_rail(const uint16_t *sample_buf, bool twos_comp)
+{
+  // Rails are 0x7FFF/0x8000 in two's complement, 0xFFFF/0x0000 otherwise,
+  // ignoring the alignment LSB
+  const uint16_t hi = twos_comp ? 0x7FFE : 0xFFFE;
+  const uint16_t lo = twos_comp ? 0x8000 : 0x0000;
+  uint32_t n = 0;
+  for (int i = 0; i < 64; i++)
+  {
+    uint16_t v = sample_buf[i] & 0xFFFE;
+    n += (v == hi) | (v == lo);
+  }
+  return n;
+}
+
+/**
+ * @brief Check the INTAN ROM with a single pipelined burst.
+ */
+static bool rhd_sync_rom_ok(rhd_device_t *dev)
+{
+  static const uint16_t cmds[7] = {
+      (0xC0 | INTAN_0) << 8, (0xC0 | INTAN_1) << 8, (0xC0 | INTAN_2) << 8,
+      (0xC0 | INTAN_3) << 8, (0xC0 | INTAN_4) << 8, (0xC0 | CHIP_ID) << 8,
+      (0xC0 | CHIP_ID) << 8};
+  uint16_t rx_a[7];
+  uint16_t rx_b[7];
+
+  if (rhd_send_burst(dev, cmds, rx_a, rx_b, 7) < 0)
+  {
+    return false;
+  }
+  for (int i = 0; i < 5; i++)
+  {
+    if (rx_a[i + 2] != "INTAN"[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Acquire a probe frame, see `RHD_SYNC_PROBE_LEN`.
+ *
+ * @param reg ROM register to read
+ * @param ok set to true if the probe read returned the ROM's value
+ * @return int `rw` return code
+ */
+static int rhd_sync_probe_frame(rhd_device_t *dev, uint16_t *sample_buf,
+                                int reg, bool *ok)
+{
+  uint16_t cmds[RHD_SYNC_PROBE_LEN];
+  uint16_t rx_a[RHD_SYNC_PROBE_LEN];
+  uint16_t rx_b[RHD_SYNC_PROBE_LEN];
+
+  for (int ch = 0; ch < 32; ch++)
+  {
+    cmds[ch] = ch << 8;
+  }
+  cmds[32] = (0xC0 | reg) << 8;
+  // Leave the pipeline as a regular frame does
+  cmds[33] = 30 << 8;
+  cmds[34] = 31 << 8;
+  int ret = rhd_send_burst(dev, cmds, rx_a, rx_b, RHD_SYNC_PROBE_LEN);
+
+  uint16_t lsb = dev->double_bits ? 1 : 0;
+  for (int ch = 0; ch < 32; ch++)
+  {
+    int rx_ch = ch < 2 ? 31 - ch : ch - 2;
+    sample_buf[rx_ch] = rx_a[ch] | lsb;
+    sample_buf[rx_ch + 32] = rx_b[ch] | lsb;
+  }
+  // Alignment
+  sample_buf[0] &= 0xFFFE;
+
+  // Result of the READ arrives 2 commands later
+  uint16_t expected = "INTAN"[reg - INTAN_0];
+  *ok = rx_a[34] == expected && rx_b[34] == expected;
+  return ret;
+}
+
+void rhd_sync_init(rhd_sync_t *sync, uint32_t probe_period, bool twos_comp)
+{
+  sync->probe_period = probe_period;
+  sync->twos_comp = twos_comp;
+  sync->max_rail = 16;
+  sync->n_since_probe = 0;
+  sync->probe_idx = 0;
+  sync->probe_next = false;
+  sync->flags = 0;
+  sync->n_unverified = 0;
+  sync->n_suspect = 0;
+  sync->n_frames = 0;
+  sync->n_probes = 0;
+  sync->n_probe_fail = 0;
+  sync->n_implausible = 0;
+  sync->n_resync = 0;
+  sync->n_resync_fail = 0;
+  sync->n_suspect_total = 0;
+}
+
+uint32_t rhd_sync_check_frame(const rhd_sync_t *sync,
+                              const uint16_t *sample_buf)
+{
+  uint32_t flags = 0;
+
+  // Channel 0's LSB is 0, all others are 1
+  uint16_t lsb_and = 1;
+  for (int i = 1; i < 64; i++)
+  {
+    lsb_and &= sample_buf[i];
+  }
+  if ((sample_buf[0] & 1) != 0 || lsb_and == 0)
+  {
+    flags |= RHD_SYNC_ALIGN;
+  }
+  if (rhd_sync_n_rail(sample_buf, sync->twos_comp) > sync->max_rail)
+  {
+    flags |= RHD_SYNC_RANGE;
+  }
+  return flags;
+}
+
+int rhd_sync_resync(rhd_device_t *dev)
+{
+  // Frame and probe commands have a null low byte, so misaligned pairs
+  // decode as CONVERTs of channel 0 and never write a register
+  bool ok = rhd_sync_rom_ok(dev);
+  if (!ok && dev->double_bits)
+  {
+    // One pad word swaps the pairing of command halves
+    uint16_t pad = 0;
+    uint16_t rx[2];
+    dev->rw(&pad, rx, 1);
+    ok = rhd_sync_rom_ok(dev);
+  }
+  if (!ok)
+  {
+    return -1;
+  }
+
+  uint16_t prime[2] = {30 << 8, 31 << 8};
+  return rhd_send_burst(dev, prime, NULL, NULL, 2) < 0 ? -1 : 0;
+}
+
+int rhd_sync_sample_all(rhd_device_t *dev, rhd_sync_t *sync,
+                        uint16_t *sample_buf)
+{
+  bool probe = sync->probe_next ||
+               (sync->probe_period != 0 &&
+                ++sync->n_since_probe >= sync->probe_period);
+  bool probe_ok = true;
+  int ret;
+
+  if (probe)
+  {
+    int reg = INTAN_0 + sync->probe_idx;
+    sync->probe_idx = (sync->probe_idx + 1) % 5;
+    sync->n_since_probe = 0;
+    sync->n_probes++;
+    ret = rhd_sync_probe_frame(dev, sample_buf, reg, &probe_ok);
+  }
+  else
+  {
+    ret = rhd2164_sample_all_burst(dev, sample_buf);
+  }
+  sync->n_frames++;
+
+  // The driver sets the alignment bits itself, only the range is meaningful
+  sync->flags = rhd_sync_n_rail(sample_buf, sync->twos_comp) > sync->max_rail
+                    ? RHD_SYNC_RANGE
+                    : 0;
+  if (sync->flags & RHD_SYNC_RANGE)
+  {
+    sync->n_implausible++;
+  }
+  // A probed frame can legitimately saturate, do not probe it again
+  sync->probe_next = (sync->flags & RHD_SYNC_RANGE) && !probe;
+
+  if (!probe)
+  {
+    sync->n_unverified++;
+  }
+  else if (probe_ok)
+  {
+    sync->n_unverified = 0;
+  }
+  else
+  {
+    // The slip happened after the last passed probe, anywhere since
+    sync->n_suspect = sync->n_unverified;
+    sync->n_suspect_total += sync->n_unverified;
+    sync->n_unverified = 0;
+    sync->flags |= RHD_SYNC_PROBE;
+    sync->n_probe_fail++;
+    if (rhd_sync_resync(dev) == 0)
+    {
+      sync->flags |= RHD_SYNC_RESYNC;
+      sync->n_resync++;
+    }
+    else
+    {
+      sync->flags |= RHD_SYNC_FAIL;
+      sync->n_resync_fail++;
+      // Keep probing until the chip answers again
+      sync->probe_next = true;
+    }
+    ret = RHD_SYNC_LOST;
+  }
+  return ret;
+}
+
+void rhd_sync_bind(rhd_sync_t *sync) { rhd_sync_bound = sync; }
+
+int rhd_sync_sample(rhd_device_t *dev, uint16_t *sample_buf)
+{
+  if (rhd_sync_bound == NULL)
+  {
+    return -1;
+  }
+  return rhd_sync_sample_all(dev, rhd_sync_bound, sample_buf);
+}
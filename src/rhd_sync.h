@@ -0,0 +1,141 @@
+/** @file rhd_sync.h
+ *
+ * @brief Online frame integrity check and command pipeline resync.
+ *
+ * A dropped or extra word on the transport silently shifts the stream: in
+ * DDR mode, the chip pairs the halves of every following command wrongly
+ * and decodes garbage. This module detects it and realigns the pipeline
+ * without reconfiguring the chip:
+ *
+ * - every `probe_period` frames, a probe frame appends a READ of one of the
+ * INTAN ROM registers to the 32 CONVERT commands and checks the result;
+ * - every frame is checked for plausible values (too many channels at the
+ * rails triggers a probe on the next frame);
+ * - on a failed probe, @ref rhd_sync_resync realigns the command pairing
+ * with a pad word if needed, flushes the pipeline and checks the ROM again.
+ *
+ * A slip is only caught by the next probe: the frames sampled since the last
+ * passed probe, up to `probe_period` of them, may already be shifted and
+ * were delivered as good. `n_unverified` counts them as they go; on a failed
+ * probe, `n_suspect` tells how many frames before the lost one to discard.
+ * Consumers that cannot tolerate shifted channels should hold back that many
+ * frames, or use a short `probe_period`.
+ *
+ * @ref rhd_sync_check_frame also checks the alignment bits set by
+ * `rhd2164_sample_all`, for consumers of a serialized frame stream.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_SYNC_H
+#define RHD_SYNC_H
+
+#include "rhd.h"
+
+/** Alignment bits broken: channel 0's LSB is 1 or another channel's is 0 */
+#define RHD_SYNC_ALIGN 0x01
+/** More than `max_rail` channels at the ADC rails */
+#define RHD_SYNC_RANGE 0x02
+/** The probe read returned an unexpected value */
+#define RHD_SYNC_PROBE 0x04
+/** The pipeline was realigned after this frame */
+#define RHD_SYNC_RESYNC 0x08
+/** The resync failed, the chip does not answer its ROM */
+#define RHD_SYNC_FAIL 0x10
+
+/** @ref rhd_sync_sample_all return code for a frame lost to misalignment */
+#define RHD_SYNC_LOST -2
+
+typedef struct
+{
+  /** Frames between probes, 0 to only probe on implausible frames */
+  uint32_t probe_period;
+  /** Samples are two's complement, see `rhd_cfg_dsp` */
+  bool twos_comp;
+  /** Channels allowed at the rails before the frame is implausible */
+  uint32_t max_rail;
+
+  uint32_t n_since_probe;
+  uint32_t probe_idx;
+  bool probe_next;
+  /** `RHD_SYNC_*` flags of the last frame */
+  uint32_t flags;
+  /** Frames delivered since the last passed probe, not verified yet */
+  uint32_t n_unverified;
+  /** Frames delivered before the last failed probe which may be shifted */
+  uint32_t n_suspect;
+
+  uint64_t n_frames;
+  uint64_t n_probes;
+  uint64_t n_probe_fail;
+  uint64_t n_implausible;
+  uint64_t n_resync;
+  uint64_t n_resync_fail;
+  /** Sum of `n_suspect` over all failed probes */
+  uint64_t n_suspect_total;
+} rhd_sync_t;
+
+/**
+ * @brief Initialize the monitor.
+ *
+ * @param sync pointer to rhd_sync_t instance
+ * @param probe_period frames between probes, 0 to disable periodic probes
+ * @param twos_comp true if samples are two's complement
+ */
+void rhd_sync_init(rhd_sync_t *sync, uint32_t probe_period, bool twos_comp);
+
+/**
+ * @brief Check a frame produced by `rhd2164_sample_all` in DDR mode, which
+ * sets the alignment bits. Non-DDR frames always fail the alignment check.
+ *
+ * Branch-free over the 64 samples so it vectorizes.
+ *
+ * @param sync monitor configuration
+ * @param sample_buf 64 samples
+ * @return uint32_t `RHD_SYNC_ALIGN` and/or `RHD_SYNC_RANGE`, 0 if plausible
+ */
+uint32_t rhd_sync_check_frame(const rhd_sync_t *sync,
+                              const uint16_t *sample_buf);
+
+/**
+ * @brief Realign the command pipeline. The chip's configuration and
+ * calibration are kept.
+ *
+ * Checks the INTAN ROM; in DDR mode, if it does not answer, sends one pad
+ * word to restore the pairing of command halves and checks again. Finally
+ * sends the CONVERTs of channels 30 and 31, so the next frame starts as
+ * after a regular frame.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @return int 0 for success, -1 if the chip still does not answer
+ */
+int rhd_sync_resync(rhd_device_t *dev);
+
+/**
+ * @brief Sample all RHD2164 channels, checking the frame and resyncing when
+ * needed. Same output as `rhd2164_sample_all`.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @param sync monitor
+ * @param sample_buf 64 samples reception buffer
+ * @return int `rw` return code, `RHD_SYNC_LOST` if the frame was acquired
+ * misaligned, in which case the `sync->n_suspect` frames before it may be
+ * too. See `sync->flags` for details.
+ */
+int rhd_sync_sample_all(rhd_device_t *dev, rhd_sync_t *sync,
+                        uint16_t *sample_buf);
+
+/**
+ * @brief Select the monitor used by @ref rhd_sync_sample.
+ */
+void rhd_sync_bind(rhd_sync_t *sync);
+
+/**
+ * @brief @ref rhd_sync_sample_all with the bound monitor, usable as a
+ * `rhd_sample_fn_t` (see `rhd_frame.h`). Frames lost to misalignment are
+ * flagged `RHD_FRAME_RW_ERR`.
+ */
+int rhd_sync_sample(rhd_device_t *dev, uint16_t *sample_buf);
+
+#endif /* RHD_SYNC_H */
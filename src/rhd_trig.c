@@ -0,0 +1,210 @@
+/** @file rhd_trig.c
+ *
+ * @brief Triggered capture with a pre-trigger history.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_trig.h"
+
+/** No trigger on this frame */
+#define RHD_TRIG_NONE -2
+
+/**
+ * @brief Check a condition against the previous frame's sample.
+ */
+static bool rhd_trig_cond_hit(const rhd_trig_t *trig,
+                              const rhd_trig_cond_t *cond, uint16_t prev,
+                              uint16_t cur)
+{
+  int16_t p = (int16_t)(prev ^ trig->flip);
+  int16_t c = (int16_t)(cur ^ trig->flip);
+  switch (cond->kind)
+  {
+  case RHD_TRIG_RISING:
+    return p < cond->level && c >= cond->level;
+  case RHD_TRIG_FALLING:
+    return p > cond->level && c <= cond->level;
+  case RHD_TRIG_DIGITAL:
+    return (prev & cond->mask) == 0 && (cur & cond->mask) != 0;
+  }
+  return false;
+}
+
+int rhd_trig_init(rhd_trig_t *trig, uint16_t *frames, rhd_frame_hdr_t *hdrs,
+                  size_t frame_len, uint32_t capacity, uint32_t pre,
+                  uint32_t post, bool twos_comp)
+{
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+      (uint64_t)pre + post >= capacity)
+  {
+    return -1;
+  }
+
+  trig->frames = frames;
+  trig->hdrs = hdrs;
+  trig->frame_len = frame_len;
+  trig->capacity = capacity;
+  trig->pre = pre;
+  trig->post = post;
+  trig->flip = twos_comp ? 0 : 0x8000;
+  trig->n_conds = 0;
+  trig->head = 0;
+  trig->n_hist = 0;
+  trig->fire = false;
+  trig->open = false;
+  trig->w_head = 0;
+  trig->w_tail = 0;
+  trig->n_missed = 0;
+  trig->n_in_window = 0;
+  return 0;
+}
+
+int rhd_trig_add(rhd_trig_t *trig, const rhd_trig_cond_t *cond)
+{
+  if (trig->n_conds == RHD_TRIG_MAX_CONDS || cond->ch >= trig->frame_len)
+  {
+    return -1;
+  }
+  trig->conds[trig->n_conds] = *cond;
+  trig->prev[trig->n_conds] = 0;
+  if (trig->head > 0)
+  {
+    uint32_t last = (trig->head - 1) & (trig->capacity - 1);
+    trig->prev[trig->n_conds] = trig->frames[last * trig->frame_len + cond->ch];
+  }
+  return trig->n_conds++;
+}
+
+void rhd_trig_fire(rhd_trig_t *trig)
+{
+  __atomic_store_n(&trig->fire, true, __ATOMIC_RELEASE);
+}
+
+uint16_t *rhd_trig_claim(rhd_trig_t *trig, rhd_frame_hdr_t **hdr)
+{
+  uint32_t head = trig->head;
+  uint32_t w_tail = __atomic_load_n(&trig->w_tail, __ATOMIC_ACQUIRE);
+
+  // The oldest window not released yet, pending or being filled, is kept
+  const rhd_trig_window_t *oldest = NULL;
+  if (w_tail != trig->w_head)
+  {
+    oldest = &trig->windows[w_tail & (RHD_TRIG_MAX_WINDOWS - 1)];
+  }
+  else if (trig->open)
+  {
+    oldest = &trig->cur;
+  }
+  if (oldest != NULL && head - oldest->start >= trig->capacity)
+  {
+    return NULL;
+  }
+
+  uint32_t slot = head & (trig->capacity - 1);
+  if (hdr != NULL)
+  {
+    *hdr = &trig->hdrs[slot];
+  }
+  return &trig->frames[slot * trig->frame_len];
+}
+
+int rhd_trig_publish(rhd_trig_t *trig)
+{
+  const uint32_t seq = trig->head;
+  const uint16_t *buf =
+      &trig->frames[(seq & (trig->capacity - 1)) * trig->frame_len];
+
+  int source = RHD_TRIG_NONE;
+  if (__atomic_exchange_n(&trig->fire, false, __ATOMIC_ACQ_REL))
+  {
+    source = RHD_TRIG_SOFTWARE;
+  }
+  for (int i = 0; i < trig->n_conds; i++)
+  {
+    uint16_t cur = buf[trig->conds[i].ch];
+    // Conditions need a previous frame
+    if (seq > 0 && rhd_trig_cond_hit(trig, &trig->conds[i], trig->prev[i], cur) &&
+        source == RHD_TRIG_NONE)
+    {
+      source = i;
+    }
+    trig->prev[i] = cur;
+  }
+  trig->head = seq + 1;
+
+  if (trig->open && source != RHD_TRIG_NONE)
+  {
+    trig->n_in_window++;
+  }
+  else if (source != RHD_TRIG_NONE)
+  {
+    uint32_t w_tail = __atomic_load_n(&trig->w_tail, __ATOMIC_ACQUIRE);
+    if (trig->w_head - w_tail == RHD_TRIG_MAX_WINDOWS)
+    {
+      trig->n_missed++;
+    }
+    else
+    {
+      trig->open = true;
+      trig->cur.start = seq - trig->n_hist;
+      trig->cur.trigger = seq;
+      trig->cur.len = trig->n_hist + 1 + trig->post;
+      trig->cur.source = source;
+    }
+  }
+  if (trig->n_hist < trig->pre)
+  {
+    trig->n_hist++;
+  }
+
+  if (trig->open && trig->head - trig->cur.start == trig->cur.len)
+  {
+    trig->windows[trig->w_head & (RHD_TRIG_MAX_WINDOWS - 1)] = trig->cur;
+    trig->open = false;
+    __atomic_store_n(&trig->w_head, trig->w_head + 1, __ATOMIC_RELEASE);
+    return 1;
+  }
+  return 0;
+}
+
+int rhd_trig_sample(rhd_trig_t *trig, rhd_device_t *dev, rhd_pacer_t *pacer,
+                    rhd_sample_fn_t fn)
+{
+  rhd_frame_hdr_t *hdr;
+  uint16_t *buf = rhd_trig_claim(trig, &hdr);
+  if (buf == NULL)
+  {
+    return RHD_TRIG_FULL;
+  }
+  int ret = rhd_frame_sample(dev, pacer, fn, buf, hdr);
+  rhd_trig_publish(trig);
+  return ret;
+}
+
+const rhd_trig_window_t *rhd_trig_get(rhd_trig_t *trig)
+{
+  uint32_t w_tail = trig->w_tail;
+  if (w_tail == __atomic_load_n(&trig->w_head, __ATOMIC_ACQUIRE))
+  {
+    return NULL;
+  }
+  return &trig->windows[w_tail & (RHD_TRIG_MAX_WINDOWS - 1)];
+}
+
+const uint16_t *rhd_trig_frame(const rhd_trig_t *trig,
+                               const rhd_trig_window_t *win, uint32_t i,
+                               const rhd_frame_hdr_t **hdr)
+{
+  uint32_t slot = (win->start + i) & (trig->capacity - 1);
+  if (hdr != NULL)
+  {
+    *hdr = &trig->hdrs[slot];
+  }
+  return &trig->frames[slot * trig->frame_len];
+}
+
+void rhd_trig_release(rhd_trig_t *trig)
+{
+  __atomic_store_n(&trig->w_tail, trig->w_tail + 1, __ATOMIC_RELEASE);
+}
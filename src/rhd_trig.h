@@ -0,0 +1,192 @@
+/** @file rhd_trig.h
+ *
+ * @brief Triggered capture with a pre-trigger history.
+ *
+ * Frames are sampled straight into a circular buffer which always holds the
+ * last `pre` frames. A trigger (software, a channel crossing a level, or a
+ * digital input sampled in the frame) opens a window of `pre` frames before
+ * the trigger frame, the trigger frame and `post` frames after it. Once
+ * complete, the window is handed to the consumer in place: its slots are not
+ * overwritten until it is released. Memory is bounded by the buffer, sized
+ * for the window.
+ *
+ * Triggers do not retrigger: one occurring while a window is being filled
+ * opens no window of its own, its frame being part of the current one. Such
+ * triggers are counted in `n_in_window`, so a consumer can tell that events
+ * were folded into a window.
+ *
+ * The producer and the consumer must each be driven by a single thread.
+ * @ref rhd_trig_fire can be called from any thread.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_TRIG_H
+#define RHD_TRIG_H
+
+#include "rhd.h"
+#include "rhd_frame.h"
+
+#define RHD_TRIG_MAX_CONDS 4
+/** Completed windows waiting for the consumer, a power of 2 */
+#define RHD_TRIG_MAX_WINDOWS 4
+
+/** @ref rhd_trig_claim failed, unreleased windows fill the buffer */
+#define RHD_TRIG_FULL -2
+
+/** Window source of @ref rhd_trig_fire */
+#define RHD_TRIG_SOFTWARE -1
+
+typedef enum
+{
+  /** Sample goes from below `level` to `level` or above */
+  RHD_TRIG_RISING = 0,
+  /** Sample goes from above `level` to `level` or below */
+  RHD_TRIG_FALLING = 1,
+  /** Any bit of `mask` goes from 0 to 1, eg an aux or digital input word */
+  RHD_TRIG_DIGITAL = 2,
+} rhd_trig_kind_t;
+
+typedef struct
+{
+  rhd_trig_kind_t kind;
+  /** Index of the sample in the frame */
+  uint16_t ch;
+  /** Level of `RHD_TRIG_RISING` and `RHD_TRIG_FALLING`, two's complement */
+  int16_t level;
+  /** Bits of `RHD_TRIG_DIGITAL`, the raw sample is used */
+  uint16_t mask;
+} rhd_trig_cond_t;
+
+typedef struct
+{
+  /** Sequence number of the first frame */
+  uint32_t start;
+  /** Sequence number of the trigger frame */
+  uint32_t trigger;
+  /** Number of frames, `pre + 1 + post` unless the history was short */
+  uint32_t len;
+  /** Condition index, or `RHD_TRIG_SOFTWARE` */
+  int source;
+} rhd_trig_window_t;
+
+typedef struct
+{
+  uint16_t *frames;
+  rhd_frame_hdr_t *hdrs;
+  size_t frame_len;
+  uint32_t capacity;
+  uint32_t pre;
+  uint32_t post;
+  uint16_t flip;
+
+  rhd_trig_cond_t conds[RHD_TRIG_MAX_CONDS];
+  int n_conds;
+  /** Previous value of each condition's sample */
+  uint16_t prev[RHD_TRIG_MAX_CONDS];
+
+  /** Number of frames published */
+  uint32_t head;
+  /** Frames available before the next one, up to `pre` */
+  uint32_t n_hist;
+  bool fire;
+  /** Window being filled */
+  bool open;
+  rhd_trig_window_t cur;
+
+  rhd_trig_window_t windows[RHD_TRIG_MAX_WINDOWS];
+  uint32_t w_head;
+  uint32_t w_tail;
+
+  /** Triggers ignored because `RHD_TRIG_MAX_WINDOWS` windows were pending */
+  uint64_t n_missed;
+  /** Triggers ignored because a window was being filled */
+  uint64_t n_in_window;
+} rhd_trig_t;
+
+/**
+ * @brief Initialize a triggered capture over caller-provided storage.
+ *
+ * @param trig pointer to rhd_trig_t instance
+ * @param frames sample storage, `capacity * frame_len` samples
+ * @param hdrs header storage, `capacity` headers
+ * @param frame_len samples per frame
+ * @param capacity number of slots, a power of 2 above `pre + post`. Twice
+ * that lets the producer go on while the consumer holds a window.
+ * @param pre frames kept before the trigger frame
+ * @param post frames captured after the trigger frame
+ * @param twos_comp true if samples are two's complement, see `rhd_cfg_dsp`
+ * @return int 0 for success, -1 for an invalid capacity
+ */
+int rhd_trig_init(rhd_trig_t *trig, uint16_t *frames, rhd_frame_hdr_t *hdrs,
+                  size_t frame_len, uint32_t capacity, uint32_t pre,
+                  uint32_t post, bool twos_comp);
+
+/**
+ * @brief Add a trigger condition, evaluated on every published frame.
+ *
+ * @return int condition index, -1 if `RHD_TRIG_MAX_CONDS` are set
+ */
+int rhd_trig_add(rhd_trig_t *trig, const rhd_trig_cond_t *cond);
+
+/**
+ * @brief Software trigger: the next published frame is a trigger frame.
+ */
+void rhd_trig_fire(rhd_trig_t *trig);
+
+/**
+ * @brief Producer: get the next slot to fill, in place.
+ *
+ * @param trig pointer to rhd_trig_t instance
+ * @param hdr set to the slot's header, can be NULL
+ * @return uint16_t* slot samples, NULL if the slot belongs to a window not
+ * released yet
+ */
+uint16_t *rhd_trig_claim(rhd_trig_t *trig, rhd_frame_hdr_t **hdr);
+
+/**
+ * @brief Producer: publish the claimed frame, evaluate the triggers and hand
+ * off the window it completes, if any.
+ *
+ * @return int 1 if the frame completed a window, 0 otherwise
+ */
+int rhd_trig_publish(rhd_trig_t *trig);
+
+/**
+ * @brief Producer: acquire a frame straight into the buffer with
+ * @ref rhd_frame_sample, and publish it.
+ *
+ * @return int `fn` return code, or `RHD_TRIG_FULL`
+ */
+int rhd_trig_sample(rhd_trig_t *trig, rhd_device_t *dev, rhd_pacer_t *pacer,
+                    rhd_sample_fn_t fn);
+
+/**
+ * @brief Consumer: get the oldest completed window. Call
+ * @ref rhd_trig_release once done with it.
+ *
+ * @return const rhd_trig_window_t* window, NULL if none
+ */
+const rhd_trig_window_t *rhd_trig_get(rhd_trig_t *trig);
+
+/**
+ * @brief Consumer: frame `i` of a window, in place.
+ *
+ * @param trig pointer to rhd_trig_t instance
+ * @param win window from @ref rhd_trig_get
+ * @param i frame index in the window, below `win->len`
+ * @param hdr set to the frame's header, can be NULL
+ * @return const uint16_t* frame samples
+ */
+const uint16_t *rhd_trig_frame(const rhd_trig_t *trig,
+                               const rhd_trig_window_t *win, uint32_t i,
+                               const rhd_frame_hdr_t **hdr);
+
+/**
+ * @brief Consumer: release the window returned by @ref rhd_trig_get, so its
+ * slots can be reused.
+ */
+void rhd_trig_release(rhd_trig_t *trig);
+
+#endif /* RHD_TRIG_H */
@@ -0,0 +1,198 @@
+/** @file rhd_zcheck.c
+ *
+ * @brief Electrode impedance measurement engine.
+ *
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML.  All rights reserved.
+ */
+
+#include "rhd_zcheck.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define RHD_ZCHECK_MAX_PERIOD 1024
+
+typedef struct
+{
+  const rhd_zcheck_cfg_t *cfg;
+  bool dual_miso;
+  int ch;
+  int n_per;
+  size_t n_slots;
+  size_t n_settle;
+  const uint8_t *dac;
+  const float *cos_lut;
+  const float *sin_lut;
+  double re;
+  double im;
+} rhd_zcheck_ch_t;
+
+/**
+ * @brief Command `g` of a channel's measurement stream: select the channel,
+ * then `[DAC write, CONVERT]` pairs, then 2 dummy reads to flush the pipeline.
+ */
+static uint16_t rhd_zcheck_cmd(const rhd_zcheck_ch_t *z, size_t g)
+{
+  if (g == 0)
+  {
+    return ((0x80 | IMP_CHK_AMP_SEL) << 8) | z->ch;
+  }
+  g--;
+  if (g < 2 * z->n_slots)
+  {
+    size_t n = g / 2;
+    if (g % 2 == 0)
+    {
+      return ((0x80 | IMP_CHK_DAC) << 8) | z->dac[n % z->n_per];
+    }
+    return (z->ch & 0x1F) << 8;
+  }
+  return (0xC0 | CHIP_ID) << 8;
+}
+
+/**
+ * @brief Accumulate the result of command `g` into the channel's DFT bin.
+ */
+static void rhd_zcheck_acc(rhd_zcheck_ch_t *z, size_t g, uint16_t code)
+{
+  if (g == 0 || g > 2 * z->n_slots || (g - 1) % 2 == 0)
+  {
+    return;
+  }
+  size_t n = (g - 1) / 2;
+  if (n < z->n_settle)
+  {
+    return;
+  }
+
+  float v = (z->cfg->twos_comp ? (float)(int16_t)code : (float)code - 32768.0f) *
+            (float)RHD_ADC_STEP;
+  z->re += v * z->cos_lut[n % z->n_per];
+  z->im -= v * z->sin_lut[n % z->n_per];
+}
+
+/**
+ * @brief Run a channel's measurement stream through `rhd_send_burst`.
+ */
+static int rhd_zcheck_stream(rhd_device_t *dev, rhd_zcheck_ch_t *z)
+{
+  uint16_t cmds[RHD_BURST_LEN];
+  uint16_t rx_a[RHD_BURST_LEN];
+  uint16_t rx_b[RHD_BURST_LEN];
+  size_t n_cmd = 1 + 2 * z->n_slots + 2;
+  bool miso_b = z->ch >= 32;
+
+  for (size_t off = 0; off < n_cmd; off += RHD_BURST_LEN)
+  {
+    size_t len = n_cmd - off < RHD_BURST_LEN ? n_cmd - off : RHD_BURST_LEN;
+    for (size_t i = 0; i < len; i++)
+    {
+      cmds[i] = rhd_zcheck_cmd(z, off + i);
+    }
+
+    // RHD2164 returns both MISO lines, even when only MISO A is needed
+    int ret = rhd_send_burst(dev, cmds, rx_a, z->dual_miso ? rx_b : NULL, len);
+    if (ret < 0)
+    {
+      return ret;
+    }
+
+    // Result of command g arrives with command g + 2
+    for (size_t i = 0; i < len; i++)
+    {
+      if (off + i >= 2)
+      {
+        rhd_zcheck_acc(z, off + i - 2, miso_b ? rx_b[i] : rx_a[i]);
+      }
+    }
+  }
+  return 0;
+}
+
+void rhd_zcheck_default_cfg(rhd_zcheck_cfg_t *cfg)
+{
+  cfg->freq = 1000;
+  cfg->fs = 30000;
+  cfg->scale = RHD_ZCHECK_1PF;
+  cfg->amplitude = 127;
+  cfg->settle_periods = 2;
+  cfg->periods = 10;
+  cfg->twos_comp = true;
+}
+
+int rhd_zcheck_run(rhd_device_t *dev, const rhd_zcheck_cfg_t *cfg,
+                   uint64_t ch_mask, rhd_zcheck_result_t *res)
+{
+  static const double cap_lut[4] = {0.1e-12, 1e-12, 0, 10e-12};
+  uint8_t dac[RHD_ZCHECK_MAX_PERIOD];
+  float cos_lut[RHD_ZCHECK_MAX_PERIOD];
+  float sin_lut[RHD_ZCHECK_MAX_PERIOD];
+
+  int n_per = (int)lroundf(cfg->fs / cfg->freq);
+  if (n_per < 4 || n_per > RHD_ZCHECK_MAX_PERIOD || cfg->periods == 0 ||
+      cap_lut[cfg->scale & 0x3] == 0)
+  {
+    return -1;
+  }
+
+  // DAC sine and its current phasor, i = C * dV/dt averaged over a sample
+  double i_re = 0;
+  double i_im = 0;
+  for (int k = 0; k < n_per; k++)
+  {
+    double w = 2 * M_PI * k / n_per;
+    dac[k] = (uint8_t)lround(128 + cfg->amplitude * sin(w));
+    cos_lut[k] = (float)cos(w);
+    sin_lut[k] = (float)sin(w);
+  }
+  for (int k = 0; k < n_per; k++)
+  {
+    double w = 2 * M_PI * k / n_per;
+    double i = cap_lut[cfg->scale & 0x3] *
+               ((int)dac[k] - (int)dac[(k + n_per - 1) % n_per]) *
+               RHD_ZCHECK_DAC_STEP * cfg->fs;
+    i_re += i * cos(w);
+    i_im -= i * sin(w);
+  }
+  i_re *= cfg->periods;
+  i_im *= cfg->periods;
+  double i_mag2 = i_re * i_re + i_im * i_im;
+
+  // An undetected chip is driven as an RHD2164
+  bool dual_miso = dev->engine == NULL || dev->engine->miso_b;
+
+  // Zcheck DAC power [6], scale [4:3], enable [0]
+  rhd_w(dev, IMP_CHK_CTRL, 0x40 | ((cfg->scale & 0x3) << 3) | 0x01);
+
+  int n_ch = 0;
+  int ret = 0;
+  for (int ch = 0; ch < 64; ch++)
+  {
+    if (!((ch_mask >> ch) & 1))
+    {
+      continue;
+    }
+
+    rhd_zcheck_ch_t z = {cfg, dual_miso, ch, n_per,
+                         (size_t)(cfg->settle_periods + cfg->periods) * n_per,
+                         (size_t)cfg->settle_periods * n_per,
+                         dac, cos_lut, sin_lut, 0, 0};
+    ret = rhd_zcheck_stream(dev, &z);
+    if (ret < 0)
+    {
+      break;
+    }
+
+    // Z = V / I
+    double z_re = (z.re * i_re + z.im * i_im) / i_mag2;
+    double z_im = (z.im * i_re - z.re * i_im) / i_mag2;
+    res[ch].mag = (float)sqrt(z_re * z_re + z_im * z_im);
+    res[ch].phase = (float)(atan2(z_im, z_re) * 180 / M_PI);
+    n_ch++;
+  }
+
+  rhd_w(dev, IMP_CHK_CTRL, 0);
+  rhd_w(dev, IMP_CHK_DAC, 0);
+  rhd_w(dev, IMP_CHK_AMP_SEL, 0);
+
+  return ret < 0 ? ret : n_ch;
+}
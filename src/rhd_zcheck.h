@@ -0,0 +1,76 @@
+/** @file rhd_zcheck.h
+ *
+ * @brief Electrode impedance measurement engine.
+ *
+ * The on-chip impedance check DAC is driven with a sine wave, which injects a
+ * current into the selected electrode through a small capacitor. DAC writes
+ * are pipelined with the CONVERT commands of the selected channel
+ * (`[DAC write, CONVERT]` pairs streamed through @ref rhd_send_burst), and the
+ * response is reduced on the fly with a single-bin DFT at the test frequency.
+ * The impedance is the ratio of the voltage and current phasors.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2023 SBIOML. All rights reserved.
+ */
+
+#ifndef RHD_ZCHECK_H
+#define RHD_ZCHECK_H
+
+#include "rhd.h"
+
+typedef enum
+{
+  RHD_ZCHECK_0PF1 = 0,
+  RHD_ZCHECK_1PF = 1,
+  RHD_ZCHECK_10PF = 3,
+} rhd_zcheck_scale_t;
+
+typedef struct
+{
+  /** Test frequency [Hz], rounded so a period is a whole number of samples */
+  float freq;
+  /** Rate of `[DAC write, CONVERT]` pairs, ie half the command rate [Hz] */
+  float fs;
+  /** Injection capacitor */
+  rhd_zcheck_scale_t scale;
+  /** DAC sine amplitude [0-127] */
+  uint8_t amplitude;
+  /** Periods discarded after switching channels */
+  uint16_t settle_periods;
+  /** Periods measured per channel */
+  uint16_t periods;
+  /** True if the amplifier data is two's complement, see `rhd_cfg_dsp` */
+  bool twos_comp;
+} rhd_zcheck_cfg_t;
+
+typedef struct
+{
+  /** Impedance magnitude [Ohm] */
+  float mag;
+  /** Impedance phase [deg] */
+  float phase;
+} rhd_zcheck_result_t;
+
+/**
+ * @brief Sensible defaults: 1 kHz with 1 pF at 30 kHz, 10 measured periods.
+ *
+ * @param cfg configuration to fill
+ */
+void rhd_zcheck_default_cfg(rhd_zcheck_cfg_t *cfg);
+
+/**
+ * @brief Measure the impedance of the selected channels.
+ *
+ * The impedance check registers are cleared afterwards, as in `rhd_setup`.
+ *
+ * @param dev pointer to rhd_device_t instance
+ * @param cfg measurement configuration
+ * @param ch_mask channels to measure, bit `i` for channel `i` [0-63]
+ * @param res results, indexed by channel, only measured channels are written
+ * @return int number of channels measured, negative on transport failure or
+ * invalid configuration
+ */
+int rhd_zcheck_run(rhd_device_t *dev, const rhd_zcheck_cfg_t *cfg,
+                   uint64_t ch_mask, rhd_zcheck_result_t *res);
+
+#endif /* RHD_ZCHECK_H */
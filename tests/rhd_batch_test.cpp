@@ -0,0 +1,260 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_batch.h"
+#include "rhd_sim.h"
+#include <unistd.h>
+}
+
+static FILE *write_tmp(const void *data, size_t len) {
+  FILE *f = tmpfile();
+  EXPECT_NE(f, nullptr);
+  EXPECT_EQ(fwrite(data, 1, len, f), len);
+  fflush(f);
+  return f;
+}
+
+template <class T> static std::vector<T> read_all(FILE *f) {
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  std::vector<T> out(len / sizeof(T));
+  fseek(f, 0, SEEK_SET);
+  EXPECT_EQ(fread(out.data(), sizeof(T), out.size(), f), out.size());
+  return out;
+}
+
+static std::vector<float> run(const rhd_batch_cfg_t &cfg, FILE *in,
+                              rhd_batch_stats_t *stats) {
+  FILE *out = tmpfile();
+  EXPECT_EQ(rhd_batch_run(&cfg, fileno(in), fileno(out), stats), 0);
+  std::vector<float> res = read_all<float>(out);
+  fclose(out);
+  return res;
+}
+
+// Offset binary noise with a slow drift, 64 channels
+static std::vector<uint16_t> recording(size_t n_frames) {
+  std::vector<uint16_t> frames(n_frames * 64);
+  uint32_t seed = 1;
+  for (size_t t = 0; t < n_frames; t++) {
+    for (int c = 0; c < 64; c++) {
+      seed = seed * 1103515245 + 12345;
+      int drift = (int)(1000 * sin(t * 0.01 + c));
+      frames[t * 64 + c] = 0x8000 + drift + (int)((seed >> 16) % 401) - 200;
+    }
+  }
+  return frames;
+}
+
+TEST(RHDBatch, ParallelMatchesSerial) {
+  const size_t n_frames = 10007;
+  std::vector<uint16_t> frames = recording(n_frames);
+  FILE *in = write_tmp(frames.data(), frames.size() * sizeof(uint16_t));
+
+  float taps[101];
+  ASSERT_EQ(rhd_batch_fir_bandpass(taps, 101, 2000, 20, 450), 0);
+
+  rhd_batch_cfg_t cfg;
+  rhd_batch_default_cfg(&cfg);
+  cfg.twos_comp = false;
+  cfg.taps = taps;
+  cfg.n_taps = 101;
+  cfg.chunk_len = n_frames;
+  cfg.n_threads = 1;
+  rhd_batch_stats_t stats;
+  std::vector<float> serial = run(cfg, in, &stats);
+  ASSERT_EQ(serial.size(), n_frames * 64);
+  EXPECT_EQ(stats.n_chunks, 1);
+  EXPECT_EQ(stats.n_out, n_frames);
+
+  const uint32_t chunk_lens[] = {1000, 333, 4096, 50};
+  const int threads[] = {2, 4, 7};
+  for (uint32_t chunk_len : chunk_lens) {
+    for (int n_threads : threads) {
+      SCOPED_TRACE(chunk_len * 10 + n_threads);
+      cfg.chunk_len = chunk_len;
+      cfg.n_threads = n_threads;
+      std::vector<float> par = run(cfg, in, &stats);
+      EXPECT_EQ(stats.n_chunks, (n_frames + chunk_len - 1) / chunk_len);
+      EXPECT_EQ(stats.n_threads, std::min<int>(n_threads, stats.n_chunks));
+      ASSERT_EQ(par.size(), serial.size());
+      EXPECT_EQ(memcmp(par.data(), serial.data(), serial.size() * 4), 0);
+    }
+  }
+
+  // Features too, windows straddling the requested chunk length
+  cfg.feat_win = 48;
+  cfg.chunk_len = n_frames;
+  cfg.n_threads = 1;
+  std::vector<float> feat_serial = run(cfg, in, &stats);
+  EXPECT_EQ(stats.n_out, n_frames / 48);
+  cfg.chunk_len = 1000;
+  cfg.n_threads = 5;
+  std::vector<float> feat_par = run(cfg, in, &stats);
+  EXPECT_EQ(stats.n_chunks, (n_frames + 1007) / 1008);
+  ASSERT_EQ(feat_par.size(), feat_serial.size());
+  EXPECT_EQ(memcmp(feat_par.data(), feat_serial.data(), feat_par.size() * 4),
+            0);
+  fclose(in);
+}
+
+TEST(RHDBatch, Conversion) {
+  const uint16_t frames[2][4] = {{0x8000, 0x8001, 0x7FFF, 0x0000},
+                                 {0x0010, 0xFFFF, 0x8000, 0x7FFF}};
+  FILE *in = write_tmp(frames, sizeof(frames));
+
+  rhd_batch_cfg_t cfg;
+  rhd_batch_default_cfg(&cfg);
+  cfg.n_ch = 4;
+  cfg.scale = 0.5;
+  cfg.twos_comp = true;
+  std::vector<float> out = run(cfg, in, NULL);
+  const float ref[8] = {-16384, -16383.5, 16383.5, 0, 8, -0.5, -16384, 16383.5};
+  ASSERT_EQ(out.size(), 8);
+  for (int i = 0; i < 8; i++) {
+    EXPECT_EQ(out[i], ref[i]);
+  }
+
+  cfg.twos_comp = false;
+  out = run(cfg, in, NULL);
+  EXPECT_EQ(out[0], 0);
+  EXPECT_EQ(out[1], 0.5);
+  EXPECT_EQ(out[3], -16384);
+  fclose(in);
+}
+
+TEST(RHDBatch, Features) {
+  std::vector<int16_t> frames(1005 * 8);
+  for (size_t i = 0; i < frames.size(); i++) {
+    frames[i] = (i / 8) % 2 ? 30 : -30;
+  }
+  FILE *in = write_tmp(frames.data(), frames.size() * sizeof(int16_t));
+
+  rhd_batch_cfg_t cfg;
+  rhd_batch_default_cfg(&cfg);
+  cfg.n_ch = 8;
+  cfg.scale = 1;
+  cfg.feat_win = 10;
+  cfg.chunk_len = 64;
+  rhd_batch_stats_t stats;
+  std::vector<float> out = run(cfg, in, &stats);
+  EXPECT_EQ(stats.n_frames, 1005);
+  EXPECT_EQ(stats.n_out, 100);
+  ASSERT_EQ(out.size(), 100 * 8);
+  for (float v : out) {
+    EXPECT_FLOAT_EQ(v, 30);
+  }
+  fclose(in);
+}
+
+static rhd_sim_t *rec_sim;
+static std::vector<uint16_t> rec_rx;
+static int rec_rw(uint16_t *tx, uint16_t *rx, size_t len) {
+  int ret = rhd_sim_xfer(rec_sim, tx, rx, len);
+  rec_rx.insert(rec_rx.end(), rx, rx + (rec_sim->double_bits ? len : 2 * len));
+  return ret;
+}
+
+static uint16_t ramp(void *ctx, int ch) {
+  int *t = (int *)ctx;
+  return 0x8000 + 0x100 * ch + *t;
+}
+
+TEST(RHDBatch, RawDecode) {
+  for (int mode = 0; mode < 2; mode++) {
+    rhd_sim_t sim;
+    rhd_device_t dev;
+    int t = 0;
+    rhd_sim_init(&sim, RHD_SIM_RHD2164, mode);
+    rhd_sim_set_signal(&sim, ramp, &t);
+    rec_sim = &sim;
+    ASSERT_EQ(rhd_init(&dev, mode, rec_rw), 0);
+
+    // Record the raw transfers while decoding live
+    rec_rx.clear();
+    std::vector<uint16_t> live;
+    for (t = 0; t < 300; t++) {
+      uint16_t buf[64];
+      rhd_sample_all(&dev, buf);
+      live.insert(live.end(), buf, buf + 64);
+    }
+    ASSERT_EQ(rec_rx.size(), 300 * dev.engine->n_rx);
+    FILE *in = write_tmp(rec_rx.data(), rec_rx.size() * sizeof(uint16_t));
+
+    rhd_batch_cfg_t cfg;
+    rhd_batch_default_cfg(&cfg);
+    cfg.input = RHD_BATCH_RAW;
+    cfg.chip_id = RHD_CHIP_RHD2164;
+    cfg.double_bits = mode;
+    cfg.twos_comp = false;
+    cfg.scale = 1;
+    cfg.chunk_len = 37;
+    cfg.n_threads = 3;
+    rhd_batch_stats_t stats;
+    std::vector<float> out = run(cfg, in, &stats);
+    EXPECT_EQ(stats.n_ch, 64);
+    ASSERT_EQ(out.size(), live.size());
+    for (size_t i = 0; i < out.size(); i++) {
+      ASSERT_EQ(out[i], (float)(int16_t)(live[i] ^ 0x8000)) << i;
+    }
+    fclose(in);
+  }
+}
+
+TEST(RHDBatch, FirDesign) {
+  float lp[63], bp[63], hp[63];
+  ASSERT_EQ(rhd_batch_fir_bandpass(lp, 63, 1000, 0, 100), 0);
+  ASSERT_EQ(rhd_batch_fir_bandpass(bp, 63, 1000, 100, 200), 0);
+  ASSERT_EQ(rhd_batch_fir_bandpass(hp, 63, 1000, 50, 500), 0);
+
+  // Gain at DC and fs / 2
+  float lp_dc = 0, bp_dc = 0, hp_dc = 0, hp_ny = 0;
+  for (int i = 0; i < 63; i++) {
+    lp_dc += lp[i];
+    bp_dc += bp[i];
+    hp_dc += hp[i];
+    hp_ny += i % 2 ? -hp[i] : hp[i];
+  }
+  EXPECT_NEAR(lp_dc, 1, 0.01);
+  EXPECT_NEAR(bp_dc, 0, 0.01);
+  EXPECT_NEAR(hp_dc, 0, 0.01);
+  EXPECT_NEAR(std::fabs(hp_ny), 1, 0.01);
+
+  EXPECT_EQ(rhd_batch_fir_bandpass(lp, 64, 1000, 50, 500), -1);
+  EXPECT_EQ(rhd_batch_fir_bandpass(lp, 63, 1000, 100, 100), -1);
+  EXPECT_EQ(rhd_batch_fir_bandpass(lp, 63, 1000, 0, 600), -1);
+  EXPECT_EQ(rhd_batch_fir_bandpass(lp, 0, 1000, 0, 100), -1);
+}
+
+TEST(RHDBatch, Invalid) {
+  uint16_t frame[64] = {0};
+  FILE *in = write_tmp(frame, sizeof(frame));
+  FILE *out = tmpfile();
+
+  rhd_batch_cfg_t cfg;
+  rhd_batch_default_cfg(&cfg);
+  cfg.n_ch = 0;
+  EXPECT_EQ(rhd_batch_run(&cfg, fileno(in), fileno(out), NULL), -1);
+
+  rhd_batch_default_cfg(&cfg);
+  cfg.input = RHD_BATCH_RAW;
+  cfg.chip_id = 3;
+  EXPECT_EQ(rhd_batch_run(&cfg, fileno(in), fileno(out), NULL), -1);
+
+  float taps[1] = {1};
+  rhd_batch_default_cfg(&cfg);
+  cfg.taps = taps;
+  cfg.n_taps = RHD_BATCH_MAX_TAPS + 1;
+  EXPECT_EQ(rhd_batch_run(&cfg, fileno(in), fileno(out), NULL), -1);
+
+  rhd_batch_default_cfg(&cfg);
+  EXPECT_EQ(rhd_batch_file(&cfg, "/nonexistent/in.bin", "/tmp/out.bin", NULL),
+            -1);
+  fclose(in);
+  fclose(out);
+}
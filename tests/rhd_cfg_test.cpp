@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "rhd_cfg.hpp"
+
+extern "C" {
+#include "rhd_sim.h"
+}
+
+static rhd_sim_t *rec_sim;
+static std::vector<uint16_t> rec_tx;
+
+// Records the words sent to the simulated chip
+static int rec_rw(uint16_t *tx, uint16_t *rx, size_t len) {
+  rec_tx.insert(rec_tx.end(), tx, tx + len);
+  return rhd_sim_xfer(rec_sim, tx, rx, len);
+}
+
+struct Cfg {
+  float fs, fl, fh;
+  bool dsp;
+  float fdsp;
+};
+
+// A spread of configurations: both ends of the cutoff tables, DSP on and off,
+// and a few sample rates on `rhd_cfg_fs` boundaries (see FsBoundaries)
+static const Cfg cfgs[] = {
+    {1000, 20, 500, true, 20},     {1000, 0.1, 100, false, 0},
+    {3750, 0.25, 20000, true, 3700}, {4375, 500, 15000, true, 1},
+    {21875, 1, 7500, true, 0.2},   {10000, 7.5, 3000, true, 0.05},
+    {5000, 0.11, 260, true, 100},  {16000, 499, 101, false, 5},
+};
+
+// RHD2216 frames are 16 commands: the ADC biases follow 16 * fs
+static const Cfg cfgs_2216[] = {
+    {20000, 1, 7500, true, 1},
+    {30000, 0.1, 20000, false, 0},
+    {43750, 500, 100, true, 4000},
+};
+
+template <bool Ddr>
+void check_matches_runtime(const Cfg &c, uint8_t chip_id = RHD_SIM_RHD2164) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+
+  // Runtime reference
+  rhd_sim_init(&sim, chip_id, Ddr);
+  rec_sim = &sim;
+  rhd_init(&dev, Ddr, rec_rw);
+  ASSERT_NE(dev.engine, nullptr);
+  rec_tx.clear();
+  ASSERT_EQ(rhd_setup(&dev, c.fs, c.fl, c.fh, c.dsp, c.fdsp), 0);
+  const std::vector<uint16_t> ref_tx = rec_tx;
+  uint8_t ref_regs[64];
+  memcpy(ref_regs, sim.regs, sizeof(ref_regs));
+
+  const rhd::RegImage img =
+      rhd::reg_image(c.fs, c.fl, c.fh, c.dsp, c.fdsp, 0xFFFFFFFF, 0xFFFFFFFF,
+                     dev.engine->n_cmds);
+  // The chip model drops writes to absent amplifiers' power registers
+  const int n_regs = chip_id == RHD_SIM_RHD2164 ? 22 : IND_AMP_PWR_0;
+  for (int reg = 0; reg < n_regs; reg++) {
+    EXPECT_EQ(img[reg], ref_regs[reg]) << "reg " << reg;
+  }
+
+  const rhd::SetupCmds<Ddr> cmds = rhd::setup_cmds<Ddr>(img);
+  rhd_sim_init(&sim, chip_id, Ddr);
+  rhd_init(&dev, Ddr, rec_rw);
+  rec_tx.clear();
+  ASSERT_EQ(rhd::setup(&dev, cmds), 0);
+
+  // Same words on the wire, sanity check reads included
+  EXPECT_EQ(rec_tx, ref_tx);
+  EXPECT_EQ(memcmp(sim.regs, ref_regs, sizeof(ref_regs)), 0);
+  EXPECT_EQ(sim.n_calib, 1);
+}
+
+TEST(RHDCfg, MatchesRuntimeDdr) {
+  for (const Cfg &c : cfgs) {
+    SCOPED_TRACE(c.fs);
+    check_matches_runtime<true>(c);
+  }
+}
+
+TEST(RHDCfg, MatchesRuntimeFlipFlop) {
+  for (const Cfg &c : cfgs) {
+    SCOPED_TRACE(c.fs);
+    check_matches_runtime<false>(c);
+  }
+}
+
+TEST(RHDCfg, MatchesRuntimeRhd2216) {
+  for (const Cfg &c : cfgs) {
+    SCOPED_TRACE(c.fs);
+    check_matches_runtime<true>(c, RHD_SIM_RHD2216);
+    check_matches_runtime<false>(c, RHD_SIM_RHD2216);
+  }
+  for (const Cfg &c : cfgs_2216) {
+    SCOPED_TRACE(c.fs);
+    check_matches_runtime<true>(c, RHD_SIM_RHD2216);
+    check_matches_runtime<false>(c, RHD_SIM_RHD2216);
+  }
+  check_matches_runtime<true>(cfgs[4], RHD_SIM_RHD2132);
+}
+
+TEST(RHDCfg, FsBoundaries) {
+  // Every `rhd_cfg_fs` entry, just below, at and just past its aggregate
+  // rate, on 32 and 16 commands
+  const float msps[9] = {120000, 140000, 175000, 220000, 280000,
+                         350000, 440000, 525000, 700000};
+  for (float m : msps) {
+    for (float d : {-1.0f, 0.0f, 1.0f}) {
+      if (m + d > 700000) {
+        continue;
+      }
+      SCOPED_TRACE(m + d);
+      check_matches_runtime<true>({(m + d) / 32, 20, 500, false, 0});
+      check_matches_runtime<false>({(m + d) / 16, 20, 500, false, 0},
+                                   RHD_SIM_RHD2216);
+    }
+  }
+}
+
+TEST(RHDCfg, CompileTime) {
+  constexpr rhd::RegImage img = rhd::reg_image(1000, 20, 500, true, 20);
+  static_assert(img[SUPPLY_SENS_ADC_BUF_BIAS] == 32, "");
+  static_assert(img[AMP_BW_SEL_0] == 30 && img[AMP_BW_SEL_3] == 6, "");
+  static_assert(img[AMP_BW_SEL_4] == 54, "");
+  static_assert(img[ADC_OUT_FMT_DPS_OFF_RMVL] == 0xD4, "");
+  static_assert(img[IND_AMP_PWR_7] == 0xFF, "");
+
+  // 20 kS/s: 640 kS/s on 32 commands, 320 kS/s on RHD2216's 16
+  static_assert(rhd::reg_image(20000, 1, 7500, false, 0)[MUX_BIAS_CURR] == 7,
+                "");
+  static_assert(rhd::reg_image(20000, 1, 7500, false, 0, 0xFFFF, 0,
+                               16)[MUX_BIAS_CURR] == 26,
+                "");
+
+  constexpr rhd::SetupCmds<true> ddr = rhd::setup_cmds<true>(img);
+  static_assert(rhd::SetupCmds<true>::len == 68, "");
+  static_assert(ddr.tx[4] == rhd::duplicate_bits(0x80 | ADC_CFG), "");
+  static_assert(ddr.tx[5] == rhd::duplicate_bits(0b11011110), "");
+
+  constexpr rhd::SetupCmds<false> ff = rhd::setup_cmds<false>(
+      rhd::reg_image(1000, 20, 500, false, 0, 0x0000FFFF, 0));
+  static_assert(ff.tx[0] == 0xFF00, "");
+  static_assert(ff.tx[24] == 0x5500, "");
+  EXPECT_EQ(ff.tx[10], (0x80 | IND_AMP_PWR_0) << 8 | 0xFF);
+  EXPECT_EQ(ff.tx[12], (0x80 | IND_AMP_PWR_2) << 8);
+
+  // Out of range frequencies do not compile, eg:
+  // constexpr auto bad = rhd::reg_image(1000, 20, 50, false, 0);
+}
+
+struct SimTransport {
+  rhd_sim_t sim;
+  int rw(uint16_t *tx, uint16_t *rx, size_t len) {
+    return rhd_sim_xfer(&sim, tx, rx, len);
+  }
+};
+
+TEST(RHDCfg, Device) {
+  static constexpr rhd::SetupCmds<true> cmds =
+      rhd::setup_cmds<true>(rhd::reg_image(2000, 1, 1000, true, 1));
+  SimTransport t;
+  rhd_sim_init(&t.sim, RHD_SIM_RHD2164, true);
+  rhd::Device<SimTransport, true> dev(t);
+  EXPECT_EQ(rhd::setup(dev, cmds), 0);
+  EXPECT_EQ(t.sim.n_calib, 1);
+  EXPECT_EQ(dev.read_force(AMP_BW_SEL_0), 46);
+
+  // DDR mode mismatch
+  rhd_device_t c_dev = dev.c_device();
+  c_dev.double_bits = false;
+  EXPECT_EQ(rhd::setup(&c_dev, rhd::setup_cmds<true>(rhd::reg_image(
+                                   2000, 1, 1000, true, 1))),
+            -1);
+}
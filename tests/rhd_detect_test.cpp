@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_sim.h"
+#include "rhd_snapshot.h"
+}
+
+static uint16_t ramp(void *, int ch) { return 0x1000 + 0x100 * ch; }
+
+struct Variant {
+  uint8_t chip_id;
+  int n_amp;
+  int n_cmds;
+};
+
+static const Variant variants[] = {
+    {RHD_SIM_RHD2132, 32, 32},
+    {RHD_SIM_RHD2216, 16, 16},
+    {RHD_SIM_RHD2164, 64, 32},
+};
+
+// Second chip of a mixed rig, on its own transport
+static rhd_sim_t *other_sim;
+static int other_rw(uint16_t *tx, uint16_t *rx, size_t len) {
+  return rhd_sim_xfer(other_sim, tx, rx, len);
+}
+
+TEST(RHDDetect, Variants) {
+  for (const Variant &v : variants) {
+    for (int mode = 0; mode < 2; mode++) {
+      SCOPED_TRACE(v.chip_id * 10 + mode);
+      rhd_sim_t sim;
+      rhd_device_t dev;
+      rhd_sim_init(&sim, v.chip_id, mode);
+      rhd_sim_bind(&sim);
+      ASSERT_EQ(rhd_init(&dev, mode, rhd_sim_rw), 0);
+      ASSERT_NE(dev.engine, nullptr);
+      EXPECT_EQ(dev.engine, rhd_engine_find(v.chip_id, mode));
+      EXPECT_EQ(dev.engine->chip_id, v.chip_id);
+      EXPECT_EQ(dev.engine->n_amp, v.n_amp);
+      EXPECT_EQ(dev.engine->n_cmds, v.n_cmds);
+      EXPECT_EQ(dev.engine->n_tx, mode ? 2 * v.n_cmds : v.n_cmds);
+      EXPECT_EQ(dev.engine->bipolar, v.chip_id == RHD_SIM_RHD2216);
+      EXPECT_EQ(dev.engine->miso_b, v.chip_id == RHD_SIM_RHD2164);
+    }
+  }
+}
+
+TEST(RHDDetect, SampleAll) {
+  for (const Variant &v : variants) {
+    for (int mode = 0; mode < 2; mode++) {
+      SCOPED_TRACE(v.chip_id * 10 + mode);
+      rhd_sim_t sim;
+      rhd_device_t dev;
+      rhd_sim_init(&sim, v.chip_id, mode);
+      rhd_sim_set_signal(&sim, ramp, NULL);
+      rhd_sim_bind(&sim);
+      ASSERT_EQ(rhd_init(&dev, mode, rhd_sim_rw), 0);
+
+      uint16_t buf[64];
+      rhd_sample_all(&dev, buf);
+      uint32_t n_convert = sim.n_convert;
+      uint32_t n_cmd = sim.n_cmd;
+      EXPECT_EQ(rhd_sample_all(&dev, buf), dev.engine->n_tx);
+      EXPECT_EQ(sim.n_cmd - n_cmd, v.n_cmds);
+      EXPECT_EQ(sim.n_convert - n_convert, v.n_cmds);
+
+      // Every channel, including the 2 carried over from the last frame
+      EXPECT_EQ(buf[0], ramp(NULL, 0));
+      for (int ch = 1; ch < v.n_amp; ch++) {
+        EXPECT_EQ(buf[ch], ramp(NULL, ch) | mode) << "ch " << ch;
+      }
+
+      if (v.chip_id == RHD_SIM_RHD2164) {
+        // The legacy order swaps channels 30 and 31 of each MISO line
+        uint16_t ref[64];
+        rhd2164_sample_all_burst(&dev, ref);
+        for (int ch = 0; ch < 64; ch++) {
+          int legacy = ch % 32 == 30 ? ch + 1 : ch % 32 == 31 ? ch - 1 : ch;
+          EXPECT_EQ(ref[legacy], buf[ch]) << "ch " << ch;
+        }
+      }
+    }
+  }
+}
+
+TEST(RHDDetect, MatchesPerChannel) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2216, false);
+  rhd_sim_set_signal(&sim, ramp, NULL);
+  rhd_sim_bind(&sim);
+  ASSERT_EQ(rhd_init(&dev, false, rhd_sim_rw), 0);
+
+  // Slow path: one CONVERT per call, result 2 calls later
+  uint16_t ref[16];
+  for (int i = 0; i < 18; i++) {
+    uint16_t rx = rhd2000_sample(&dev, i % 16);
+    if (i >= 2) {
+      ref[i - 2] = rx;
+    }
+  }
+  uint16_t buf[16];
+  rhd_sample_all(&dev, buf);
+  rhd_sample_all(&dev, buf);
+  for (int ch = 1; ch < 16; ch++) {
+    EXPECT_EQ(buf[ch], ref[ch]);
+  }
+  EXPECT_EQ(buf[0], ref[0] & 0xFFFE);
+}
+
+TEST(RHDDetect, UnknownChip) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, 3, true);
+  rhd_sim_bind(&sim);
+  EXPECT_EQ(rhd_init(&dev, true, rhd_sim_rw), 0);
+  EXPECT_EQ(dev.engine, nullptr);
+  EXPECT_EQ(rhd_detect(&dev), CHIP_ID);
+  EXPECT_EQ(rhd_engine_find(3, true), nullptr);
+
+  // Falls back to an RHD2164 frame
+  uint16_t buf[64];
+  uint32_t n_convert = sim.n_convert;
+  EXPECT_EQ(rhd_sample_all(&dev, buf), 64);
+  EXPECT_EQ(sim.n_convert - n_convert, 32);
+}
+
+TEST(RHDDetect, UnreadableRom) {
+  // Blank variant registers: the legacy RHD2164 setup still works
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, false);
+  memset(&sim.regs[MISO_A_B], 0, 5);
+  rhd_sim_bind(&sim);
+  EXPECT_EQ(rhd_init(&dev, false, rhd_sim_rw), 0);
+  EXPECT_EQ(dev.engine, nullptr);
+  ASSERT_EQ(rhd_setup(&dev, 20000, 1, 7500, false, 0), 0);
+  EXPECT_EQ(sim.regs[MUX_BIAS_CURR], 7);
+}
+
+TEST(RHDDetect, InconsistentRom) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2132, false);
+  sim.regs[NB_AMP] = 16;
+  rhd_sim_bind(&sim);
+  EXPECT_EQ(rhd_init(&dev, false, rhd_sim_rw), 0);
+  EXPECT_EQ(rhd_detect(&dev), NB_AMP);
+  EXPECT_EQ(dev.engine, nullptr);
+
+  rhd_sim_init(&sim, RHD_SIM_RHD2216, false);
+  sim.regs[UNI_BIPLR_AMPS] = 0;
+  EXPECT_EQ(rhd_init(&dev, false, rhd_sim_rw), 0);
+  EXPECT_EQ(rhd_detect(&dev), UNI_BIPLR_AMPS);
+
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  sim.regs[MISO_A_B] = 0;
+  EXPECT_EQ(rhd_init(&dev, true, rhd_sim_rw), 0);
+  EXPECT_EQ(rhd_detect(&dev), MISO_A_B);
+}
+
+TEST(RHDDetect, SetupUsesFrameLength) {
+  // 16 channels at 20 kHz is 320 kS/s, 32 would be 640 kS/s
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2216, true);
+  rhd_sim_bind(&sim);
+  ASSERT_EQ(rhd_init(&dev, true, rhd_sim_rw), 0);
+  ASSERT_EQ(rhd_setup(&dev, 20000, 1, 7500, false, 0), 0);
+  EXPECT_EQ(sim.regs[SUPPLY_SENS_ADC_BUF_BIAS], 8);
+  EXPECT_EQ(sim.regs[MUX_BIAS_CURR], 26);
+
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  ASSERT_EQ(rhd_init(&dev, true, rhd_sim_rw), 0);
+  ASSERT_EQ(rhd_setup(&dev, 20000, 1, 7500, false, 0), 0);
+  EXPECT_EQ(sim.regs[SUPPLY_SENS_ADC_BUF_BIAS], 3);
+  EXPECT_EQ(sim.regs[MUX_BIAS_CURR], 7);
+}
+
+TEST(RHDDetect, MixedRig) {
+  rhd_sim_t sim_a, sim_b;
+  rhd_device_t dev_a, dev_b;
+  rhd_sim_init(&sim_a, RHD_SIM_RHD2164, true);
+  rhd_sim_init(&sim_b, RHD_SIM_RHD2216, false);
+  rhd_sim_set_signal(&sim_a, ramp, NULL);
+  rhd_sim_set_signal(&sim_b, ramp, NULL);
+  rhd_sim_bind(&sim_a);
+  other_sim = &sim_b;
+  ASSERT_EQ(rhd_init(&dev_a, true, rhd_sim_rw), 0);
+  ASSERT_EQ(rhd_init(&dev_b, false, other_rw), 0);
+
+  // Each chip runs its own frame: 32 commands for RHD2164, 16 for RHD2216
+  uint16_t buf_a[64], buf_b[16];
+  for (int i = 0; i < 3; i++) {
+    rhd_sample_all(&dev_a, buf_a);
+    rhd_sample_all(&dev_b, buf_b);
+  }
+  EXPECT_EQ(sim_a.n_convert, 3 * 32);
+  EXPECT_EQ(sim_b.n_convert, 3 * 16);
+  EXPECT_EQ(buf_a[40] & 0xFFFE, ramp(NULL, 40));
+  EXPECT_EQ(buf_b[15], ramp(NULL, 15));
+}
+
+TEST(RHDDetect, WarmStart) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_snapshot_t snap;
+  bool warm;
+  rhd_sim_init(&sim, RHD_SIM_RHD2132, true);
+  rhd_sim_bind(&sim);
+  ASSERT_EQ(rhd_warm_start(&dev, true, rhd_sim_rw, 1000, 20, 500, true, 20,
+                           &snap, &warm),
+            0);
+  EXPECT_FALSE(warm);
+  EXPECT_EQ(dev.engine, rhd_engine_find(RHD_SIM_RHD2132, true));
+
+  rhd_device_t dev2;
+  ASSERT_EQ(rhd_warm_start(&dev2, true, rhd_sim_rw, 1000, 20, 500, true, 20,
+                           &snap, &warm),
+            0);
+  EXPECT_TRUE(warm);
+  EXPECT_EQ(dev2.engine, dev.engine);
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+extern "C" {
+#include "rhd_event.h"
+}
+
+// Sum of 4 uniforms: sigma = 100, bounded to 3.46 sigma
+class Noise {
+public:
+  int16_t next() {
+    int s = 0;
+    for (int i = 0; i < 4; i++) {
+      state_ = state_ * 1103515245 + 12345;
+      s += (int)((state_ >> 16) % 173) - 86;
+    }
+    return (int16_t)s;
+  }
+
+private:
+  uint32_t state_ = 1;
+};
+
+class RHDEvent : public ::testing::Test {
+protected:
+  void SetUp() override {
+    rhd_event_default_cfg(&cfg);
+    cfg.tau = 500;
+    cfg.warmup = 2000;
+    cfg.refractory = 10;
+  }
+
+  // Feeds `n` noise frames, adding `spike` to channel `ch` from frame `at`
+  void run(size_t n, int ch = -1, uint64_t at = 0,
+           const std::vector<int> &spike = {}) {
+    uint16_t frame[64];
+    rhd_event_t ev[64];
+    int16_t snip[64 * RHD_EVENT_MAX_SNIP];
+    for (size_t i = 0; i < n; i++) {
+      uint64_t f = det.n_frames;
+      for (int c = 0; c < 64; c++) {
+        int v = noise.next();
+        if (c == ch && f >= at && f - at < spike.size()) {
+          v += spike[f - at];
+        }
+        input[f % 4096][c] = (int16_t)v;
+        frame[c] = cfg.twos_comp ? (uint16_t)(int16_t)v
+                                 : (uint16_t)(v + 32768);
+      }
+      size_t n_ev = rhd_event_process(&det, frame, ev, snip, max_events);
+      for (size_t e = 0; e < n_ev; e++) {
+        events.push_back(ev[e]);
+        snippets.push_back(std::vector<int16_t>(
+            snip + e * cfg.snip_len, snip + (e + 1) * cfg.snip_len));
+      }
+    }
+  }
+
+  rhd_event_cfg_t cfg;
+  rhd_event_det_t det;
+  Noise noise;
+  size_t max_events = 64;
+  int16_t input[4096][64];
+  std::vector<rhd_event_t> events;
+  std::vector<std::vector<int16_t>> snippets;
+};
+
+TEST_F(RHDEvent, NoiseOnly) {
+  ASSERT_EQ(rhd_event_init(&det, &cfg), 0);
+  run(4000);
+  EXPECT_EQ(events.size(), 0);
+  for (int c = 0; c < 64; c++) {
+    EXPECT_NEAR(rhd_event_noise(&det, c), 100, 15);
+  }
+}
+
+TEST_F(RHDEvent, Spike) {
+  cfg.snip_len = 16;
+  cfg.snip_pre = 8;
+  ASSERT_EQ(rhd_event_init(&det, &cfg), 0);
+  run(2500);
+  run(500, 5, 2600, {-800, -1500, -2000, -1200, -400});
+  ASSERT_EQ(events.size(), 1);
+  const rhd_event_t &e = events[0];
+  EXPECT_EQ(e.ch, 5);
+  EXPECT_EQ(e.frame, 2600);
+  EXPECT_EQ(e.peak_lag, 2);
+  EXPECT_EQ(e.peak, input[2602][5]);
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(snippets[0][i], input[2600 - 8 + i][5]) << i;
+  }
+  EXPECT_EQ(det.n_events, 1);
+}
+
+TEST_F(RHDEvent, RefractoryAndPolarity) {
+  cfg.polarity = RHD_EVENT_POS;
+  ASSERT_EQ(rhd_event_init(&det, &cfg), 0);
+  run(2500);
+  // Negative spikes are ignored
+  run(30, 7, 2510, {-2000, -2000});
+  EXPECT_EQ(events.size(), 0);
+  // A second crossing within the event too
+  float noise_before = rhd_event_noise(&det, 7);
+  run(10, 7, 2530, {2000, 0, 0, 0, 3000, 0, 0, 0, 0, 2000});
+  // Noise estimate frozen during the event
+  EXPECT_EQ(rhd_event_noise(&det, 7), noise_before);
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].frame, 2530);
+  EXPECT_EQ(events[0].peak_lag, 4);
+  run(10);
+  EXPECT_EQ(events.size(), 1);
+}
+
+TEST_F(RHDEvent, MadOffsetBinary) {
+  cfg.noise = RHD_EVENT_MAD;
+  cfg.twos_comp = false;
+  ASSERT_EQ(rhd_event_init(&det, &cfg), 0);
+  run(3000);
+  EXPECT_EQ(events.size(), 0);
+  EXPECT_NEAR(rhd_event_noise(&det, 0), 100, 20);
+  run(200, 63, 3100, {1500});
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].ch, 63);
+  EXPECT_EQ(events[0].peak, input[3100][63]);
+}
+
+TEST_F(RHDEvent, Dropped) {
+  cfg.refractory = 1;
+  cfg.k = 0.5;
+  max_events = 4;
+  ASSERT_EQ(rhd_event_init(&det, &cfg), 0);
+  run(2100);
+  EXPECT_GT(det.n_dropped, 0);
+  EXPECT_EQ(det.n_events, events.size());
+}
+
+TEST_F(RHDEvent, InvalidCfg) {
+  rhd_event_cfg_t bad = cfg;
+  bad.n_ch = 65;
+  EXPECT_EQ(rhd_event_init(&det, &bad), -1);
+  bad = cfg;
+  bad.refractory = 0;
+  EXPECT_EQ(rhd_event_init(&det, &bad), -1);
+  bad = cfg;
+  bad.snip_len = 32;
+  bad.snip_pre = 8;
+  EXPECT_EQ(rhd_event_init(&det, &bad), -1);
+  bad.snip_pre = 32;
+  EXPECT_EQ(rhd_event_init(&det, &bad), -1);
+  bad.snip_pre = 22;
+  EXPECT_EQ(rhd_event_init(&det, &bad), 0);
+}
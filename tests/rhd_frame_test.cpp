@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_frame.h"
+#include "rhd_sim.h"
+}
+
+static uint64_t fake_now = 0;
+static uint64_t fake_step = 0;
+
+static uint64_t fake_clock(void) {
+  fake_now += fake_step;
+  return fake_now;
+}
+
+static int fail_next = 0;
+
+static int flaky_rw(uint16_t *tx, uint16_t *rx, size_t len) {
+  int ret = rhd_sim_rw(tx, rx, len);
+  if (fail_next > 0) {
+    fail_next--;
+    return -1;
+  }
+  return ret;
+}
+
+TEST(RHDFrame, PacedHeaders) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, true, flaky_rw);
+
+  rhd_pacer_t pacer;
+  fake_now = 0;
+  fake_step = 100;
+  rhd_pacer_init(&pacer, 1000, fake_clock);
+
+  uint16_t buf[4][64];
+  rhd_frame_hdr_t hdr[4];
+  for (int i = 0; i < 4; i++) {
+    if (i == 2) {
+      fail_next = 1;
+    }
+    rhd_frame_sample(&dev, &pacer, rhd2164_sample_all, buf[i], &hdr[i]);
+  }
+
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(hdr[i].seq, i);
+    EXPECT_EQ(hdr[i].t_ns, hdr[0].t_ns + 1000 * i);
+    EXPECT_EQ(hdr[i].late_ns, 0);
+    EXPECT_EQ(hdr[i].flags, i == 2 ? RHD_FRAME_RW_ERR : 0);
+  }
+  EXPECT_EQ(buf[3][5] & 0xFFFE, 5 << 8);
+}
+
+TEST(RHDFrame, Overrun) {
+  rhd_pacer_t pacer;
+  rhd_frame_hdr_t hdr;
+  fake_now = 0;
+  fake_step = 10;
+  rhd_pacer_init(&pacer, 1000, fake_clock);
+  rhd_pacer_begin(&pacer, &hdr);
+
+  // Stall for 2.5 periods
+  fake_now += 2500;
+  rhd_pacer_begin(&pacer, &hdr);
+  EXPECT_EQ(hdr.seq, 1);
+  EXPECT_EQ(hdr.late_ns, 1510);
+  EXPECT_EQ(hdr.flags, RHD_FRAME_OVERRUN);
+
+  // Fixed schedule, the next deadline is still t0 + 2 periods
+  rhd_pacer_begin(&pacer, &hdr);
+  EXPECT_EQ(hdr.late_ns, 520);
+  EXPECT_EQ(hdr.flags, 0);
+}
+
+TEST(RHDFrame, GapDetector) {
+  rhd_gap_detector_t det;
+  rhd_gap_init(&det, 1000, 200);
+
+  rhd_frame_hdr_t hdr[6] = {
+      {0, 0, 0, 0},
+      {1000, 0, 1, 0},
+      {4000, 0, 4, 0},                     // 2 frames lost
+      {6500, 1500, 5, RHD_FRAME_OVERRUN},  // stall
+      {7000, 0, 6, RHD_FRAME_RW_ERR},
+      {8100, 100, 7, 0},
+  };
+
+  uint32_t missing;
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[0], &missing), 0);
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[1], &missing), 0);
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[2], &missing), RHD_GAP_SEQ);
+  EXPECT_EQ(missing, 2);
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[3], &missing),
+            RHD_GAP_STALL | RHD_GAP_OVERRUN);
+  EXPECT_EQ(rhd_gap_feed(&det, &hdr[4], 2), 1);
+
+  EXPECT_EQ(det.n_frames, 6);
+  EXPECT_EQ(det.n_missing, 2);
+  EXPECT_EQ(det.n_stalls, 1);
+  EXPECT_EQ(det.n_overruns, 1);
+  EXPECT_EQ(det.n_rw_err, 1);
+  EXPECT_EQ(det.max_late_ns, 1500);
+  EXPECT_EQ(det.max_dt_ns, 3000);
+}
+
+TEST(RHDFrame, GapReorder) {
+  rhd_gap_detector_t det;
+  rhd_gap_init(&det, 1000, 200);
+
+  // Frame 2 arrives after 3, then 3 again
+  rhd_frame_hdr_t hdr[6] = {
+      {0, 0, 0, 0},    {1000, 0, 1, 0},
+      {3000, 0, 3, 0}, {2000, 0, 2, RHD_FRAME_RW_ERR},
+      {3000, 0, 3, 0}, {4000, 0, 4, 0},
+  };
+
+  uint32_t missing;
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[0], &missing), 0);
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[1], &missing), 0);
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[2], &missing), RHD_GAP_SEQ);
+  EXPECT_EQ(missing, 1);
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[3], &missing),
+            RHD_GAP_REORDER | RHD_GAP_RW_ERR);
+  EXPECT_EQ(missing, 0);
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[4], &missing), RHD_GAP_REORDER);
+  EXPECT_EQ(rhd_gap_check(&det, &hdr[5], &missing), 0);
+
+  EXPECT_EQ(det.n_frames, 6);
+  EXPECT_EQ(det.n_missing, 1);
+  EXPECT_EQ(det.n_reordered, 2);
+  EXPECT_EQ(det.n_stalls, 0);
+  EXPECT_EQ(det.next_seq, 5);
+
+  // Wrap-around is still a forward step
+  rhd_gap_init(&det, 0, 0);
+  rhd_frame_hdr_t wrap[2] = {{0, 0, 0xFFFFFFFF, 0}, {0, 0, 1, 0}};
+  EXPECT_EQ(rhd_gap_feed(&det, wrap, 2), 1);
+  EXPECT_EQ(det.n_missing, 1);
+  EXPECT_EQ(det.n_reordered, 0);
+}
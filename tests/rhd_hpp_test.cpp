@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include "rhd.hpp"
+
+extern "C" {
+#include "rhd_sim.h"
+}
+
+struct SimTransport {
+  rhd_sim_t sim;
+  int rw(uint16_t *tx, uint16_t *rx, size_t len) {
+    return rhd_sim_xfer(&sim, tx, rx, len);
+  }
+};
+
+static uint16_t ramp(void *, int ch) { return 0x1000 + 0x100 * ch; }
+
+TEST(RHDHpp, BitOps) {
+  EXPECT_EQ(rhd::duplicate_bits(0xAA), 0xCCCC);
+  EXPECT_EQ(rhd::duplicate_bits(0x55), 0x3333);
+  EXPECT_EQ(rhd::compact_bits(0x3333), 0x55);
+  uint8_t a, b;
+  rhd::unsplit_u16(0xCCCC, a, b);
+  EXPECT_EQ(a, 0xAA);
+  EXPECT_EQ(b, 0xAA);
+  static_assert(rhd::duplicate_bits(0x53) == 0x330F, "");
+}
+
+template <bool Ddr> void check_device() {
+  SimTransport t;
+  rhd_sim_init(&t.sim, RHD_SIM_RHD2164, Ddr);
+  rhd_sim_set_signal(&t.sim, ramp, NULL);
+  rhd::Device<SimTransport, Ddr> dev(t);
+  EXPECT_EQ(dev.init(), 0);
+  EXPECT_EQ(dev.setup(1000, 20, 500, true, 20), 0);
+  EXPECT_EQ(t.sim.n_calib, 1);
+  EXPECT_EQ(dev.read_force(CHIP_ID), RHD_SIM_RHD2164);
+
+  // Same frames as the C API on an identical chip
+  rhd_sim_t ref_sim = t.sim;
+  rhd_device_t ref;
+  rhd_sim_bind(&ref_sim);
+  ref.rw = rhd_sim_rw;
+  ref.double_bits = Ddr;
+
+  uint16_t buf[64], ref_buf[64];
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(dev.sample_all(buf), Ddr ? 64 : 32);
+    rhd2164_sample_all(&ref, ref_buf);
+    for (int ch = 0; ch < 64; ch++) {
+      EXPECT_EQ(buf[ch], ref_buf[ch]);
+    }
+  }
+  EXPECT_EQ(buf[10] & 0xFFFE, ramp(NULL, 10));
+  EXPECT_EQ(buf[40] & 0xFFFE, ramp(NULL, 40));
+}
+
+TEST(RHDHpp, DeviceDdr) { check_device<true>(); }
+
+TEST(RHDHpp, DeviceFlipFlop) { check_device<false>(); }
+
+TEST(RHDHpp, FnTransport) {
+  rhd_sim_t sim;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_bind(&sim);
+  rhd::FnTransport<rhd_sim_rw> t;
+  rhd::Device<rhd::FnTransport<rhd_sim_rw>, true> dev(t);
+  EXPECT_EQ(dev.init(), 0);
+}
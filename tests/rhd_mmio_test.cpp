@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_mmio.h"
+#include "rhd_sim.h"
+}
+
+/**
+ * Fake peer process running a simulated RHD2164 behind a shared-memory FIFO
+ * region.
+ */
+class RHDMmio : public ::testing::Test {
+protected:
+  void start(uint8_t chip, bool mode) {
+    rhd_mmio_default_cfg(&cfg);
+    cfg.yield_polls = 16;
+    cfg.rx_per_tx = chip == RHD_SIM_RHD2164 && !mode ? 2 : 1;
+    size = rhd_mmio_region_size(&cfg) + sizeof(int);
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                -1, 0);
+    ASSERT_NE(base, MAP_FAILED);
+    stop = (volatile int *)((uint8_t *)base + size - sizeof(int));
+
+    peer = fork();
+    ASSERT_GE(peer, 0);
+    if (peer == 0) {
+      rhd_sim_t sim;
+      rhd_sim_init(&sim, chip, mode);
+      rhd_sim_bind(&sim);
+      rhd_mmio_serve(&cfg, base, rhd_sim_rw, stop);
+      _exit(0);
+    }
+
+    ASSERT_EQ(rhd_mmio_attach(&mmio, base, size, &cfg), 0);
+    rhd_mmio_bind(&mmio);
+  }
+
+  void TearDown() override {
+    if (peer > 0) {
+      *stop = 1;
+      waitpid(peer, NULL, 0);
+      rhd_mmio_close(&mmio);
+      munmap(base, size);
+    }
+  }
+
+  rhd_mmio_cfg_t cfg;
+  rhd_mmio_t mmio;
+  void *base = NULL;
+  size_t size = 0;
+  volatile int *stop = NULL;
+  pid_t peer = -1;
+};
+
+TEST_F(RHDMmio, RegionTooSmall) {
+  rhd_mmio_t m;
+  rhd_mmio_default_cfg(&cfg);
+  uint32_t region[16] = {0};
+  EXPECT_EQ(rhd_mmio_attach(&m, region, sizeof(region), &cfg), -1);
+}
+
+TEST_F(RHDMmio, SetupAndSample) {
+  start(RHD_SIM_RHD2164, true);
+  rhd_device_t dev;
+  EXPECT_EQ(rhd_init(&dev, true, rhd_mmio_rw), 0);
+  EXPECT_EQ(rhd_setup(&dev, 1000, 20, 500, true, 20), 0);
+
+  uint16_t buf[64];
+  rhd2164_sample_all_burst(&dev, buf);
+  uint64_t n_mmio = mmio.n_mmio;
+  uint64_t n_burst = mmio.n_burst;
+  EXPECT_EQ(rhd2164_sample_all_burst(&dev, buf), 64);
+  EXPECT_EQ(mmio.n_burst - n_burst, 1);
+  for (int ch = 2; ch < 30; ch++) {
+    EXPECT_EQ(buf[ch] & 0xFFFE, ch << 8);
+    EXPECT_EQ(buf[ch + 32] & 0xFFFE, (ch + 32) << 8);
+  }
+
+  // A single burst costs far fewer MMIO accesses than one per command
+  uint64_t burst_cost = mmio.n_mmio - n_mmio;
+  n_mmio = mmio.n_mmio;
+  rhd2164_sample_all(&dev, buf);
+  EXPECT_EQ(mmio.n_burst - n_burst - 1, 32);
+  EXPECT_LT(burst_cost, mmio.n_mmio - n_mmio);
+}
+
+TEST_F(RHDMmio, FlipFlop) {
+  start(RHD_SIM_RHD2164, false);
+  rhd_device_t dev;
+  EXPECT_EQ(rhd_init(&dev, false, rhd_mmio_rw), 0);
+
+  uint16_t buf[64];
+  rhd2164_sample_all_burst(&dev, buf);
+  EXPECT_EQ(rhd2164_sample_all_burst(&dev, buf), 32);
+  for (int ch = 2; ch < 30; ch++) {
+    EXPECT_EQ(buf[ch], ch << 8);
+    EXPECT_EQ(buf[ch + 32], (ch + 32) << 8);
+  }
+}
+
+TEST_F(RHDMmio, LongBurst) {
+  start(RHD_SIM_RHD2132, false);
+  rhd_device_t dev;
+  EXPECT_EQ(rhd_init(&dev, false, rhd_mmio_rw), 0);
+
+  // Longer than the FIFO, split in chunks
+  uint16_t cmds[600], rx[600];
+  for (int i = 0; i < 600; i++) {
+    cmds[i] = (0xC0 | (INTAN_0 + i % 5)) << 8;
+  }
+  uint64_t n_burst = mmio.n_burst;
+  EXPECT_EQ(rhd_mmio_xfer(&mmio, cmds, rx, 600), 600);
+  EXPECT_EQ(mmio.n_burst - n_burst, 3);
+  for (int i = 2; i < 600; i++) {
+    EXPECT_EQ(rx[i], "INTAN"[(i - 2) % 5]);
+  }
+}
@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+extern "C" {
+#include "rhd_frame.h"
+#include "rhd_net.h"
+#include <arpa/inet.h>
+#include <unistd.h>
+}
+
+struct Received {
+  std::vector<rhd_frame_hdr_t> hdrs;
+  std::vector<uint16_t> samples;
+};
+
+static void on_frame(void *ctx, const rhd_frame_hdr_t *hdr,
+                     const uint16_t *samples, size_t frame_len) {
+  Received *rec = (Received *)ctx;
+  rec->hdrs.push_back(*hdr);
+  rec->samples.insert(rec->samples.end(), samples, samples + frame_len);
+}
+
+static void push_frames(rhd_net_tx_t *tx, uint32_t first, uint32_t n) {
+  uint16_t buf[64];
+  for (uint32_t i = first; i < first + n; i++) {
+    for (int ch = 0; ch < 64; ch++) {
+      buf[ch] = (ch << 8) | (i & 0xFF);
+    }
+    rhd_frame_hdr_t hdr = {1000ULL * i, 0, i, i % 5 == 0 ? 1u : 0u};
+    ASSERT_GE(rhd_net_tx_push(tx, &hdr, buf), 0);
+  }
+}
+
+static void receive(rhd_net_rx_t *rx, Received *rec, size_t n) {
+  for (int tries = 0; rec->hdrs.size() < n && tries < 100; tries++) {
+    ASSERT_GE(rhd_net_rx_poll(rx, on_frame, rec, 100), 0);
+  }
+}
+
+static void check_frames(const Received &rec, size_t k0, uint32_t first,
+                         uint32_t n) {
+  for (uint32_t i = first; i < first + n; i++) {
+    size_t k = k0 + i - first;
+    EXPECT_EQ(rec.hdrs[k].seq, i);
+    EXPECT_EQ(rec.hdrs[k].t_ns, 1000ULL * i);
+    EXPECT_EQ(rec.hdrs[k].flags, i % 5 == 0 ? 1u : 0u);
+    EXPECT_EQ(rec.samples[64 * k + 40], (40 << 8) | (i & 0xFF));
+  }
+}
+
+TEST(RHDNet, UdpBatched) {
+  rhd_net_rx_t rx;
+  rhd_net_tx_t tx;
+  ASSERT_EQ(rhd_net_rx_udp(&rx, 7, 0), 0);
+  ASSERT_EQ(rhd_net_tx_init(&tx, 7, 64, 8, 4), 0);
+  ASSERT_EQ(rhd_net_tx_udp(&tx, "127.0.0.1", rhd_net_rx_port(&rx)), 0);
+
+  // 64 frames, 8 per packet, 4 packets per sendmmsg
+  push_frames(&tx, 0, 64);
+  EXPECT_EQ(tx.n_pkts, 8);
+  EXPECT_EQ(tx.n_syscalls, 2);
+
+  Received rec;
+  receive(&rx, &rec, 64);
+  ASSERT_EQ(rec.hdrs.size(), 64);
+  check_frames(rec, 0, 0, 64);
+  EXPECT_EQ(rx.n_pkts, 8);
+  EXPECT_EQ(rx.n_lost_pkts, 0);
+  EXPECT_EQ(rx.gap.n_missing, 0);
+
+  rhd_net_tx_close(&tx);
+  rhd_net_rx_close(&rx);
+}
+
+TEST(RHDNet, UdpLoss) {
+  rhd_net_rx_t rx, other;
+  rhd_net_tx_t tx;
+  ASSERT_EQ(rhd_net_rx_udp(&rx, 7, 0), 0);
+  ASSERT_EQ(rhd_net_rx_udp(&other, 8, 0), 0);
+  ASSERT_EQ(rhd_net_tx_init(&tx, 7, 64, 8, 4), 0);
+  ASSERT_EQ(rhd_net_tx_udp(&tx, "127.0.0.1", rhd_net_rx_port(&rx)), 0);
+
+  push_frames(&tx, 0, 8);
+  EXPECT_EQ(rhd_net_tx_flush(&tx), 1);
+  // Packet 1, frames 8-15, is lost on the way
+  tx.pkt_seq++;
+  push_frames(&tx, 16, 11);
+  EXPECT_EQ(rhd_net_tx_flush(&tx), 2);
+
+  Received rec;
+  receive(&rx, &rec, 19);
+  ASSERT_EQ(rec.hdrs.size(), 19);
+  check_frames(rec, 0, 0, 8);
+  check_frames(rec, 8, 16, 11);
+  EXPECT_EQ(rx.n_lost_pkts, 1);
+  EXPECT_EQ(rx.gap.n_missing, 8);
+
+  // Another device's stream
+  rhd_net_tx_t tx_other;
+  ASSERT_EQ(rhd_net_tx_init(&tx_other, 7, 64, 8, 4), 0);
+  ASSERT_EQ(rhd_net_tx_udp(&tx_other, "127.0.0.1", rhd_net_rx_port(&other)),
+            0);
+  push_frames(&tx_other, 0, 8);
+  rhd_net_tx_flush(&tx_other);
+  Received none;
+  EXPECT_EQ(rhd_net_rx_poll(&other, on_frame, &none, 1000), 0);
+  EXPECT_EQ(other.n_bad_pkts, 1);
+
+  rhd_net_tx_close(&tx);
+  rhd_net_tx_close(&tx_other);
+  rhd_net_rx_close(&rx);
+  rhd_net_rx_close(&other);
+}
+
+TEST(RHDNet, UdpReorder) {
+  rhd_net_rx_t rx;
+  rhd_net_tx_t tx;
+  ASSERT_EQ(rhd_net_rx_udp(&rx, 7, 0), 0);
+  ASSERT_EQ(rhd_net_tx_init(&tx, 7, 64, 8, 4), 0);
+  ASSERT_EQ(rhd_net_tx_udp(&tx, "127.0.0.1", rhd_net_rx_port(&rx)), 0);
+
+  // Packets 0, 2, then 1 late, then 1 again
+  push_frames(&tx, 0, 8);
+  rhd_net_tx_flush(&tx);
+  tx.pkt_seq = 2;
+  push_frames(&tx, 16, 8);
+  rhd_net_tx_flush(&tx);
+  for (int i = 0; i < 2; i++) {
+    tx.pkt_seq = 1;
+    push_frames(&tx, 8, 8);
+    rhd_net_tx_flush(&tx);
+  }
+  tx.pkt_seq = 3;
+  push_frames(&tx, 24, 8);
+  rhd_net_tx_flush(&tx);
+
+  Received rec;
+  receive(&rx, &rec, 40);
+  ASSERT_EQ(rec.hdrs.size(), 40);
+  check_frames(rec, 8, 16, 8);
+  check_frames(rec, 16, 8, 8);
+  check_frames(rec, 32, 24, 8);
+  EXPECT_EQ(rx.n_lost_pkts, 1);
+  EXPECT_EQ(rx.n_reordered_pkts, 2);
+  EXPECT_EQ(rx.next_pkt_seq, 4);
+  EXPECT_EQ(rx.gap.n_missing, 8);
+  EXPECT_EQ(rx.gap.n_reordered, 16);
+
+  rhd_net_tx_close(&tx);
+  rhd_net_rx_close(&rx);
+}
+
+TEST(RHDNet, TcpReassembly) {
+  rhd_net_rx_t rx;
+  rhd_net_tx_t tx;
+  ASSERT_EQ(rhd_net_tx_init(&tx, 3, 64, 7, 16), 0);
+  ASSERT_EQ(rhd_net_tx_tcp_listen(&tx, 0), 0);
+  ASSERT_EQ(rhd_net_rx_tcp(&rx, 3, "127.0.0.1", rhd_net_tx_tcp_port(&tx)), 0);
+
+  // Packets of 7 frames, flushed 16 at a time, plus a partial one
+  push_frames(&tx, 0, 1000);
+  rhd_net_tx_flush(&tx);
+  EXPECT_EQ(tx.n_pkts, 143);
+
+  Received rec;
+  receive(&rx, &rec, 1000);
+  ASSERT_EQ(rec.hdrs.size(), 1000);
+  check_frames(rec, 0, 0, 1000);
+  EXPECT_EQ(rx.n_lost_pkts, 0);
+  EXPECT_EQ(rx.gap.n_missing, 0);
+
+  // Sender goes away
+  rhd_net_tx_close(&tx);
+  EXPECT_LT(rhd_net_rx_poll(&rx, on_frame, &rec, 1000), 0);
+  rhd_net_rx_close(&rx);
+}
+
+TEST(RHDNet, TcpSlowClient) {
+  rhd_net_rx_t fast, slow;
+  rhd_net_tx_t tx;
+  ASSERT_EQ(rhd_net_tx_init(&tx, 3, 64, 8, 8), 0);
+  ASSERT_EQ(rhd_net_tx_tcp_listen(&tx, 0), 0);
+  uint16_t port = rhd_net_tx_tcp_port(&tx);
+  ASSERT_EQ(rhd_net_rx_tcp(&fast, 3, "127.0.0.1", port), 0);
+  ASSERT_EQ(rhd_net_rx_tcp(&slow, 3, "127.0.0.1", port), 0);
+
+  // The slow client never reads: once its buffers are full it is dropped,
+  // without blocking the producer or the other client
+  Received rec;
+  uint32_t n = 0;
+  while (tx.n_slow_clients == 0 && n < 2000000) {
+    push_frames(&tx, n, 64);
+    n += 64;
+    ASSERT_GE(rhd_net_rx_poll(&fast, on_frame, &rec, 0), 0);
+  }
+  EXPECT_EQ(tx.n_slow_clients, 1);
+  push_frames(&tx, n, 64);
+  n += 64;
+  rhd_net_tx_flush(&tx);
+  receive(&fast, &rec, n);
+  ASSERT_EQ(rec.hdrs.size(), n);
+  check_frames(rec, 0, 0, n);
+
+  // What the slow client got is a lossless prefix, then the connection ends
+  Received rec_slow;
+  int ret;
+  while ((ret = rhd_net_rx_poll(&slow, on_frame, &rec_slow, 1000)) > 0) {
+  }
+  EXPECT_LT(ret, 0);
+  EXPECT_LT(rec_slow.hdrs.size(), n);
+  check_frames(rec_slow, 0, 0, rec_slow.hdrs.size());
+  EXPECT_EQ(slow.n_lost_pkts, 0);
+
+  rhd_net_tx_close(&tx);
+  rhd_net_rx_close(&fast);
+  rhd_net_rx_close(&slow);
+}
+
+TEST(RHDNet, InvalidSizes) {
+  rhd_net_tx_t tx;
+  EXPECT_EQ(rhd_net_tx_init(&tx, 0, 64, 1000, 4), -1);
+  EXPECT_EQ(rhd_net_tx_init(&tx, 0, 64, 8, RHD_NET_MAX_BATCH + 1), -1);
+}
+
+// Socket bound to an ephemeral port of the given type, without listening
+static int bound_socket(int type, uint16_t *port) {
+  struct sockaddr_in addr = {};
+  socklen_t len = sizeof(addr);
+  int fd = socket(AF_INET, type, 0);
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  EXPECT_EQ(bind(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  getsockname(fd, (struct sockaddr *)&addr, &len);
+  *port = ntohs(addr.sin_port);
+  return fd;
+}
+
+TEST(RHDNet, ReceiverSocketErrors) {
+  // A failed receiver is released, closing it again is harmless
+  rhd_net_rx_t rx;
+  uint16_t port;
+  int fd = bound_socket(SOCK_DGRAM, &port);
+  EXPECT_EQ(rhd_net_rx_udp(&rx, 7, port), -1);
+  EXPECT_EQ(rx.buf, nullptr);
+  EXPECT_EQ(rx.fd, -1);
+  rhd_net_rx_close(&rx);
+  close(fd);
+
+  fd = bound_socket(SOCK_STREAM, &port);
+  EXPECT_EQ(rhd_net_rx_tcp(&rx, 7, "127.0.0.1", port), -1);
+  EXPECT_EQ(rx.buf, nullptr);
+  EXPECT_EQ(rx.fd, -1);
+  rhd_net_rx_close(&rx);
+  close(fd);
+}
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+extern "C" {
+#include "rhd_psd.h"
+}
+
+// Gaussian-ish white noise, sigma = 1
+class Noise {
+public:
+  double next() {
+    double s = 0;
+    for (int i = 0; i < 12; i++) {
+      state_ = state_ * 6364136223846793005ull + 1442695040888963407ull;
+      s += (state_ >> 11) * (1.0 / 9007199254740992.0);
+    }
+    return s - 6;
+  }
+
+private:
+  uint64_t state_ = 1;
+};
+
+static uint16_t to_sample(double v, bool twos_comp = true) {
+  long s = std::lround(v);
+  return twos_comp ? (uint16_t)(int16_t)s : (uint16_t)(s + 32768);
+}
+
+TEST(RHDPsd, MatchesDirectDft) {
+  rhd_psd_cfg_t cfg;
+  rhd_psd_default_cfg(&cfg);
+  cfg.n_ch = 5;
+  cfg.nfft = 64;
+  cfg.hop = 64;
+  cfg.n_avg = 1;
+  rhd_psd_t psd;
+  ASSERT_EQ(rhd_psd_init(&psd, &cfg), 0);
+
+  std::vector<std::vector<double>> x(5, std::vector<double>(64));
+  Noise noise;
+  int published = 0;
+  for (int i = 0; i < 64; i++) {
+    uint16_t frame[5];
+    for (int c = 0; c < 5; c++) {
+      x[c][i] = std::lround(1000 * noise.next() + 300 * c);
+      frame[c] = to_sample(x[c][i]);
+    }
+    published += rhd_psd_push(&psd, frame);
+  }
+  ASSERT_EQ(published, 1);
+
+  double u = 0;
+  for (int i = 0; i < 64; i++) {
+    double w = 0.5 - 0.5 * cos(2 * M_PI * i / 64);
+    u += w * w;
+  }
+  for (int c = 0; c < 5; c++) {
+    const float *p = rhd_psd_channel(&psd, c);
+    for (int k = 0; k <= 32; k++) {
+      double re = 0, im = 0;
+      for (int i = 0; i < 64; i++) {
+        double w = (0.5 - 0.5 * cos(2 * M_PI * i / 64)) * x[c][i];
+        re += w * cos(2 * M_PI * k * i / 64);
+        im -= w * sin(2 * M_PI * k * i / 64);
+      }
+      double ref = (re * re + im * im) / (cfg.fs * u);
+      if (k != 0 && k != 32) {
+        ref *= 2;
+      }
+      EXPECT_NEAR(p[k], ref, 1e-3 * ref + 1e-2) << "ch " << c << " k " << k;
+    }
+  }
+  rhd_psd_free(&psd);
+}
+
+TEST(RHDPsd, LineNoiseAndFloor) {
+  rhd_psd_cfg_t cfg;
+  rhd_psd_default_cfg(&cfg);
+  cfg.twos_comp = false;
+  rhd_psd_t psd;
+  ASSERT_EQ(rhd_psd_init(&psd, &cfg), 0);
+
+  // Channel 10: 60 Hz + 180 Hz, channel 20: 37 Hz, all: white noise
+  const double sigma = 50;
+  const double a60 = 200, a180 = 100, a37 = 400;
+  Noise noise;
+  int published = 0;
+  for (int i = 0; published == 0; i++) {
+    uint16_t frame[64];
+    double t = i / 1000.0;
+    for (int c = 0; c < 64; c++) {
+      double v = sigma * noise.next();
+      if (c == 10) {
+        v += a60 * sin(2 * M_PI * 60 * t) + a180 * sin(2 * M_PI * 180 * t);
+      }
+      if (c == 20) {
+        v += a37 * sin(2 * M_PI * 37 * t);
+      }
+      frame[c] = to_sample(v, false);
+    }
+    published += rhd_psd_push(&psd, frame);
+  }
+  EXPECT_EQ(psd.n_published, 1);
+
+  const double floor_ref = 2 * sigma * sigma / 1000;
+  for (int c = 0; c < 64; c++) {
+    EXPECT_NEAR(psd.floor[c], floor_ref, 0.2 * floor_ref) << c;
+    // Total power (Parseval)
+    double var = sigma * sigma;
+    if (c == 10) {
+      var += (a60 * a60 + a180 * a180) / 2;
+    }
+    if (c == 20) {
+      var += a37 * a37 / 2;
+    }
+    EXPECT_NEAR(rhd_psd_band_power(&psd, c, 0, 500), var, 0.1 * var) << c;
+  }
+  const double line_ref = (a60 * a60 + a180 * a180) / 2;
+  EXPECT_NEAR(psd.line[10], line_ref, 0.05 * line_ref);
+  EXPECT_LT(psd.line[20], 0.01 * line_ref);
+  EXPECT_LT(psd.line[0], 0.01 * line_ref);
+  EXPECT_NEAR(rhd_psd_band_power(&psd, 20, 30, 45), a37 * a37 / 2,
+              0.05 * a37 * a37 / 2);
+
+  // Peak bin
+  const float *p = rhd_psd_channel(&psd, 20);
+  size_t peak = 1;
+  for (size_t k = 1; k < psd.n_bins; k++) {
+    if (p[k] > p[peak]) {
+      peak = k;
+    }
+  }
+  EXPECT_NEAR(rhd_psd_bin_freq(&psd, peak), 37, 1);
+  rhd_psd_free(&psd);
+}
+
+TEST(RHDPsd, Decimation) {
+  rhd_psd_cfg_t cfg;
+  rhd_psd_default_cfg(&cfg);
+  cfg.n_ch = 2;
+  cfg.fs = 20000;
+  cfg.decim = 20;
+  cfg.nfft = 256;
+  cfg.hop = 128;
+  cfg.n_avg = 2;
+  rhd_psd_t psd;
+  ASSERT_EQ(rhd_psd_init(&psd, &cfg), 0);
+  EXPECT_FLOAT_EQ(rhd_psd_bin_freq(&psd, 128), 500);
+
+  int published = 0;
+  for (int i = 0; published == 0; i++) {
+    double t = i / 20000.0;
+    uint16_t frame[2] = {to_sample(1000 * sin(2 * M_PI * 125 * t)),
+                         to_sample(1000 * sin(2 * M_PI * 250 * t))};
+    published += rhd_psd_push(&psd, frame);
+  }
+  EXPECT_EQ(psd.n_in, 256 + 128);
+  for (int c = 0; c < 2; c++) {
+    const float *p = rhd_psd_channel(&psd, c);
+    size_t peak = 1;
+    for (size_t k = 1; k < psd.n_bins; k++) {
+      if (p[k] > p[peak]) {
+        peak = k;
+      }
+    }
+    EXPECT_EQ(peak, 32 * (c + 1));
+  }
+  rhd_psd_free(&psd);
+}
+
+TEST(RHDPsd, Invalid) {
+  rhd_psd_cfg_t cfg;
+  rhd_psd_t psd;
+  rhd_psd_default_cfg(&cfg);
+  cfg.nfft = 1000;
+  EXPECT_EQ(rhd_psd_init(&psd, &cfg), -1);
+  rhd_psd_default_cfg(&cfg);
+  cfg.hop = 2048;
+  EXPECT_EQ(rhd_psd_init(&psd, &cfg), -1);
+  rhd_psd_default_cfg(&cfg);
+  cfg.n_ch = 65;
+  EXPECT_EQ(rhd_psd_init(&psd, &cfg), -1);
+}
@@ -0,0 +1,263 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_replay.h"
+#include "rhd_sim.h"
+#include <unistd.h>
+}
+
+static uint16_t varying(void *ctx, int ch) {
+  int *t = (int *)ctx;
+  return (uint16_t)(0x8000 + 0x100 * ch + 7 * *t);
+}
+
+// Frames read from a simulated chip whose signal changes every frame, with
+// rhd_sample_all or rhd2164_sample_all
+static std::vector<uint16_t> record(uint8_t chip_id, bool mode, int n_frames,
+                                    bool legacy = false) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  int t = 0;
+  rhd_sim_init(&sim, chip_id, mode);
+  rhd_sim_set_signal(&sim, varying, &t);
+  rhd_sim_bind(&sim);
+  EXPECT_EQ(rhd_init(&dev, mode, rhd_sim_rw), 0);
+
+  const int n_amp = dev.engine->n_amp;
+  std::vector<uint16_t> frames(n_frames * n_amp);
+  for (t = 0; t < n_frames; t++) {
+    if (legacy) {
+      rhd2164_sample_all(&dev, &frames[t * n_amp]);
+    } else {
+      rhd_sample_all(&dev, &frames[t * n_amp]);
+    }
+  }
+  return frames;
+}
+
+static rhd_replay_cfg_t asap_cfg(uint8_t chip_id, bool mode, bool loop) {
+  rhd_replay_cfg_t cfg;
+  rhd_replay_default_cfg(&cfg);
+  cfg.chip_id = chip_id;
+  cfg.double_bits = mode;
+  cfg.speed = 0;
+  cfg.loop = loop;
+  return cfg;
+}
+
+TEST(RHDReplay, ReproducesRecording) {
+  const uint8_t chips[] = {RHD_CHIP_RHD2132, RHD_CHIP_RHD2216,
+                           RHD_CHIP_RHD2164};
+  for (uint8_t chip_id : chips) {
+    for (int rec_mode = 0; rec_mode < 2; rec_mode++) {
+      for (int mode = 0; mode < 2; mode++) {
+        SCOPED_TRACE(chip_id * 100 + rec_mode * 10 + mode);
+        std::vector<uint16_t> rec = record(chip_id, rec_mode, 40);
+
+        rhd_replay_t rp;
+        rhd_replay_cfg_t cfg = asap_cfg(chip_id, mode, false);
+        ASSERT_EQ(rhd_replay_init(&rp, &cfg, rec.data(), 40), 0);
+        rhd_replay_bind(&rp);
+
+        // The chip model answers the driver's configuration consistently
+        rhd_device_t dev;
+        ASSERT_EQ(rhd_init(&dev, mode, rhd_replay_rw), 0);
+        EXPECT_EQ(dev.engine->chip_id, chip_id);
+        ASSERT_EQ(rhd_setup(&dev, 1000, 20, 500, true, 20), 0);
+
+        // The first frame's 2 carried-over results are not from the recording
+        const int n_amp = dev.engine->n_amp;
+        const int n_cmds = dev.engine->n_cmds;
+        uint16_t buf[64];
+        rhd_sample_all(&dev, buf);
+        for (int ch = 0; ch < n_amp; ch++) {
+          if (ch % n_cmds == n_cmds - 2 || ch % n_cmds == n_cmds - 1) {
+            continue;
+          }
+          uint16_t ref = rec[ch];
+          if (mode && ch != 0) {
+            ref |= 1;
+          }
+          ASSERT_EQ(buf[ch], ref) << "frame 0 ch " << ch;
+        }
+
+        // Frame k is read back as recorded, once the pipeline is primed
+        for (int k = 1; k < 40; k++) {
+          ASSERT_GE(rhd_sample_all(&dev, buf), 0);
+          for (int ch = 0; ch < n_amp; ch++) {
+            // Only DDR sets the LSb of recorded samples
+            uint16_t ref = rec[k * n_amp + ch];
+            if (mode && ch != 0) {
+              ref |= 1;
+            }
+            ASSERT_EQ(buf[ch], ref) << "frame " << k << " ch " << ch;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(RHDReplay, ReproducesLegacyRecording) {
+  for (int mode = 0; mode < 2; mode++) {
+    SCOPED_TRACE(mode);
+    std::vector<uint16_t> rec = record(RHD_CHIP_RHD2164, mode, 20, true);
+
+    rhd_replay_t rp;
+    rhd_replay_cfg_t cfg = asap_cfg(RHD_CHIP_RHD2164, mode, false);
+    cfg.legacy_order = true;
+    ASSERT_EQ(rhd_replay_init(&rp, &cfg, rec.data(), 20), 0);
+    rhd_replay_bind(&rp);
+    rhd_device_t dev;
+    ASSERT_EQ(rhd_init(&dev, mode, rhd_replay_rw), 0);
+
+    // rhd2164_sample_all reads back the recording in its own order
+    uint16_t buf[64];
+    rhd2164_sample_all(&dev, buf);
+    for (int k = 1; k < 20; k++) {
+      ASSERT_GE(rhd2164_sample_all(&dev, buf), 0);
+      for (int ch = 0; ch < 64; ch++) {
+        uint16_t ref = rec[k * 64 + ch];
+        if (mode && ch != 0) {
+          ref |= 1;
+        }
+        ASSERT_EQ(buf[ch], ref) << "frame " << k << " ch " << ch;
+      }
+    }
+  }
+}
+
+TEST(RHDReplay, Loop) {
+  std::vector<uint16_t> rec = record(RHD_CHIP_RHD2164, true, 10);
+  rhd_replay_t rp;
+  rhd_replay_cfg_t cfg = asap_cfg(RHD_CHIP_RHD2164, true, true);
+  ASSERT_EQ(rhd_replay_init(&rp, &cfg, rec.data(), 10), 0);
+  rhd_replay_bind(&rp);
+
+  rhd_device_t dev;
+  ASSERT_EQ(rhd_init(&dev, true, rhd_replay_rw), 0);
+  uint16_t buf[64];
+  rhd_sample_all(&dev, buf);
+  for (int k = 1; k < 35; k++) {
+    ASSERT_EQ(rhd_sample_all(&dev, buf), 64);
+    EXPECT_EQ(memcmp(buf, &rec[(k % 10) * 64], sizeof(buf)), 0) << k;
+  }
+  EXPECT_EQ(rp.n_loops, 3);
+  EXPECT_FALSE(rp.done);
+}
+
+TEST(RHDReplay, End) {
+  std::vector<uint16_t> rec = record(RHD_CHIP_RHD2132, false, 10);
+  rhd_replay_t rp;
+  rhd_replay_cfg_t cfg = asap_cfg(RHD_CHIP_RHD2132, false, false);
+  ASSERT_EQ(rhd_replay_init(&rp, &cfg, rec.data(), 10), 0);
+  rhd_replay_bind(&rp);
+
+  rhd_device_t dev;
+  ASSERT_EQ(rhd_init(&dev, false, rhd_replay_rw), 0);
+  uint16_t buf[32];
+  int n_ok = 0;
+  while (rhd_sample_all(&dev, buf) >= 0 && n_ok < 100) {
+    n_ok++;
+  }
+  EXPECT_EQ(n_ok, 10);
+  EXPECT_TRUE(rp.done);
+  EXPECT_EQ(rhd_replay_rw(NULL, NULL, 0), -1);
+}
+
+static uint64_t fake_ns;
+static uint64_t fake_clock(void) { return fake_ns += 1000; }
+
+TEST(RHDReplay, Pacing) {
+  std::vector<uint16_t> rec = record(RHD_CHIP_RHD2164, true, 30);
+  const float speeds[] = {1, 4, 0};
+  for (float speed : speeds) {
+    SCOPED_TRACE(speed);
+    rhd_replay_t rp;
+    rhd_replay_cfg_t cfg = asap_cfg(RHD_CHIP_RHD2164, true, false);
+    cfg.fs = 1000;
+    cfg.speed = speed;
+    cfg.clock = fake_clock;
+    ASSERT_EQ(rhd_replay_init(&rp, &cfg, rec.data(), 30), 0);
+    rhd_replay_bind(&rp);
+    rhd_device_t dev;
+    ASSERT_EQ(rhd_init(&dev, true, rhd_replay_rw), 0);
+
+    uint16_t buf[64];
+    fake_ns = 0;
+    rhd_sample_all(&dev, buf);
+    for (int k = 1; k < 21; k++) {
+      rhd_sample_all(&dev, buf);
+    }
+    // 20 frame periods of 1 ms / speed, up to one clock tick late each
+    uint64_t period = speed > 0 ? 1000000 / speed : 0;
+    EXPECT_GE(fake_ns, 20 * period);
+    EXPECT_LE(fake_ns, 20 * period + 40 * 1000);
+  }
+}
+
+TEST(RHDReplay, SetSpeed) {
+  std::vector<uint16_t> rec = record(RHD_CHIP_RHD2216, false, 30);
+  rhd_replay_t rp;
+  rhd_replay_cfg_t cfg = asap_cfg(RHD_CHIP_RHD2216, false, true);
+  cfg.clock = fake_clock;
+  ASSERT_EQ(rhd_replay_init(&rp, &cfg, rec.data(), 30), 0);
+  rhd_replay_bind(&rp);
+  rhd_device_t dev;
+  ASSERT_EQ(rhd_init(&dev, false, rhd_replay_rw), 0);
+
+  uint16_t buf[16];
+  rhd_replay_set_speed(&rp, 2);
+  fake_ns = 0;
+  for (int k = 0; k < 11; k++) {
+    rhd_sample_all(&dev, buf);
+  }
+  EXPECT_GE(fake_ns, 10 * 500000);
+  EXPECT_LE(fake_ns, 11 * 500000);
+}
+
+TEST(RHDReplay, File) {
+  std::vector<uint16_t> rec = record(RHD_CHIP_RHD2164, false, 20);
+  char path[] = "/tmp/rhd_replay_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  // A trailing partial frame is ignored
+  ASSERT_EQ(write(fd, rec.data(), rec.size() * 2 + 6), rec.size() * 2 + 6);
+  close(fd);
+
+  rhd_replay_t rp;
+  rhd_replay_cfg_t cfg = asap_cfg(RHD_CHIP_RHD2164, false, true);
+  ASSERT_EQ(rhd_replay_open(&rp, &cfg, path), 0);
+  EXPECT_EQ(rp.n_frames, 20);
+  rhd_replay_bind(&rp);
+  rhd_device_t dev;
+  ASSERT_EQ(rhd_init(&dev, false, rhd_replay_rw), 0);
+
+  uint16_t buf[64];
+  rhd_sample_all(&dev, buf);
+  rhd_sample_all(&dev, buf);
+  EXPECT_EQ(memcmp(buf, &rec[64], sizeof(buf)), 0);
+  rhd_replay_close(&rp);
+  unlink(path);
+}
+
+TEST(RHDReplay, Invalid) {
+  uint16_t frame[64] = {0};
+  rhd_replay_t rp;
+  rhd_replay_cfg_t cfg = asap_cfg(3, true, true);
+  EXPECT_EQ(rhd_replay_init(&rp, &cfg, frame, 1), -1);
+  cfg = asap_cfg(RHD_CHIP_RHD2164, true, true);
+  EXPECT_EQ(rhd_replay_init(&rp, &cfg, frame, 0), -1);
+  cfg.speed = 1;
+  cfg.fs = 0;
+  EXPECT_EQ(rhd_replay_init(&rp, &cfg, frame, 1), -1);
+  cfg = asap_cfg(RHD_CHIP_RHD2132, true, true);
+  cfg.legacy_order = true;
+  EXPECT_EQ(rhd_replay_init(&rp, &cfg, frame, 1), -1);
+  cfg = asap_cfg(RHD_CHIP_RHD2164, true, true);
+  EXPECT_EQ(rhd_replay_open(&rp, &cfg, "/nonexistent/session.raw"), -1);
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_frame.h"
+#include "rhd_ring.h"
+#include "rhd_sim.h"
+}
+
+static uint16_t frames[8 * 64];
+static rhd_frame_hdr_t hdrs[8];
+
+static void produce(rhd_ring_t *ring, uint16_t val) {
+  rhd_frame_hdr_t *hdr;
+  uint16_t *buf = rhd_ring_claim(ring, &hdr);
+  ASSERT_NE(buf, nullptr);
+  buf[0] = val;
+  hdr->seq = val;
+  rhd_ring_publish(ring);
+}
+
+TEST(RHDRing, InPlaceBroadcast) {
+  rhd_ring_t ring;
+  EXPECT_EQ(rhd_ring_init(&ring, frames, hdrs, 64, 6), -1);
+  ASSERT_EQ(rhd_ring_init(&ring, frames, hdrs, 64, 8), 0);
+  int a = rhd_ring_attach(&ring, RHD_RING_LOSSY);
+  int b = rhd_ring_attach(&ring, RHD_RING_BACKPRESSURE);
+
+  EXPECT_EQ(rhd_ring_read(&ring, a, NULL), nullptr);
+  produce(&ring, 100);
+  produce(&ring, 101);
+
+  const rhd_frame_hdr_t *hdr;
+  const uint16_t *fa = rhd_ring_read(&ring, a, &hdr);
+  const uint16_t *fb = rhd_ring_read(&ring, b, NULL);
+  EXPECT_EQ(fa, frames);
+  EXPECT_EQ(fa, fb);
+  EXPECT_EQ(fa[0], 100);
+  EXPECT_EQ(hdr->seq, 100);
+  EXPECT_TRUE(rhd_ring_release(&ring, a));
+  EXPECT_TRUE(rhd_ring_release(&ring, b));
+  EXPECT_EQ(rhd_ring_read(&ring, a, NULL), frames + 64);
+}
+
+TEST(RHDRing, Policies) {
+  rhd_ring_t ring;
+  rhd_ring_init(&ring, frames, hdrs, 64, 8);
+  int lossy = rhd_ring_attach(&ring, RHD_RING_LOSSY);
+  int slow = rhd_ring_attach(&ring, RHD_RING_BACKPRESSURE);
+
+  for (int i = 0; i < 8; i++) {
+    produce(&ring, i);
+  }
+  // Backpressure consumer has not released frame 0
+  EXPECT_EQ(rhd_ring_claim(&ring, NULL), nullptr);
+  EXPECT_EQ(rhd_ring_read(&ring, slow, NULL)[0], 0);
+  rhd_ring_release(&ring, slow);
+  produce(&ring, 8);
+  rhd_ring_detach(&ring, slow);
+  for (int i = 9; i < 12; i++) {
+    produce(&ring, i);
+  }
+
+  // Lossy consumer is 12 frames behind an 8-slot ring
+  EXPECT_EQ(rhd_ring_read(&ring, lossy, NULL)[0], 5);
+  EXPECT_EQ(ring.consumers[lossy].n_lost, 5);
+  EXPECT_TRUE(rhd_ring_release(&ring, lossy));
+
+  // Overwritten while reading
+  rhd_ring_read(&ring, lossy, NULL);
+  produce(&ring, 12);
+  produce(&ring, 13);
+  EXPECT_FALSE(rhd_ring_release(&ring, lossy));
+  EXPECT_EQ(ring.consumers[lossy].n_lost, 6);
+}
+
+TEST(RHDRing, Threads) {
+  static uint16_t storage[16 * 64];
+  static rhd_frame_hdr_t storage_hdr[16];
+  const int n_frames = 20000;
+
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, true, rhd_sim_rw);
+  rhd_pacer_t pacer;
+  rhd_pacer_init(&pacer, 0, NULL);
+
+  rhd_ring_t ring;
+  rhd_ring_init(&ring, storage, storage_hdr, 64, 16);
+  int ids[3];
+  for (int i = 0; i < 3; i++) {
+    ids[i] = rhd_ring_attach(&ring, RHD_RING_BACKPRESSURE);
+  }
+
+  std::vector<int> n_ok(3, 0);
+  std::vector<std::thread> consumers;
+  for (int i = 0; i < 3; i++) {
+    consumers.emplace_back([&, i] {
+      uint32_t next = 0;
+      while (next < (uint32_t)n_frames) {
+        const rhd_frame_hdr_t *hdr;
+        const uint16_t *f = rhd_ring_read(&ring, ids[i], &hdr);
+        if (f == nullptr) {
+          std::this_thread::yield();
+          continue;
+        }
+        n_ok[i] += hdr->seq == next && (f[5] & 0xFFFE) == 5 << 8;
+        rhd_ring_release(&ring, ids[i]);
+        next++;
+      }
+    });
+  }
+
+  for (int i = 0; i < n_frames;) {
+    if (rhd_ring_sample(&ring, &dev, &pacer, rhd2164_sample_all_burst) ==
+        RHD_RING_FULL) {
+      std::this_thread::yield();
+      continue;
+    }
+    i++;
+  }
+  for (auto &t : consumers) {
+    t.join();
+  }
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(n_ok[i], n_frames);
+    EXPECT_EQ(ring.consumers[ids[i]].n_lost, 0);
+  }
+}
+
+TEST(RHDRing, ConcurrentAttach) {
+  for (int round = 0; round < 50; round++) {
+    rhd_ring_t ring;
+    rhd_ring_init(&ring, frames, hdrs, 64, 8);
+
+    // More threads than slots: every slot is taken exactly once
+    int ids[2 * RHD_RING_MAX_CONSUMERS];
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2 * RHD_RING_MAX_CONSUMERS; i++) {
+      threads.emplace_back(
+          [&, i] { ids[i] = rhd_ring_attach(&ring, RHD_RING_LOSSY); });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    std::vector<int> n_owners(RHD_RING_MAX_CONSUMERS, 0);
+    int n_failed = 0;
+    for (int id : ids) {
+      if (id < 0) {
+        n_failed++;
+        continue;
+      }
+      n_owners[id]++;
+    }
+    EXPECT_EQ(n_failed, RHD_RING_MAX_CONSUMERS);
+    for (int n : n_owners) {
+      EXPECT_EQ(n, 1);
+    }
+
+    rhd_ring_detach(&ring, 3);
+    EXPECT_EQ(rhd_ring_attach(&ring, RHD_RING_BACKPRESSURE), 3);
+  }
+}
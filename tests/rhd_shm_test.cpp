@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_frame.h"
+#include "rhd_shm.h"
+#include "rhd_sim.h"
+}
+
+static std::string shm_name() {
+  return "/rhd_shm_test_" + std::to_string(getpid());
+}
+
+static void produce(rhd_shm_t *shm, uint32_t seq) {
+  rhd_frame_hdr_t *hdr;
+  uint16_t *buf = rhd_shm_claim(shm, &hdr);
+  for (int ch = 0; ch < 64; ch++) {
+    buf[ch] = (ch << 8) | (seq & 0xFF);
+  }
+  hdr->t_ns = 1000ULL * seq;
+  hdr->seq = seq;
+  hdr->flags = 0;
+  rhd_shm_publish(shm);
+}
+
+TEST(RHDShm, AttachAndRead) {
+  std::string name = shm_name();
+  EXPECT_EQ(rhd_shm_attach(name.c_str()), nullptr);
+  rhd_shm_t *w = rhd_shm_create(name.c_str(), 64, 16);
+  ASSERT_NE(w, nullptr);
+
+  produce(w, 0);
+  rhd_shm_t *r = rhd_shm_attach(name.c_str());
+  ASSERT_NE(r, nullptr);
+  EXPECT_EQ(rhd_shm_frame_len(r), 64);
+  EXPECT_EQ(rhd_shm_head(r), 1);
+  EXPECT_EQ(rhd_shm_wait(r, 0), 0);
+
+  uint16_t samples[4 * 64];
+  uint64_t t_ns[4];
+  uint32_t seq[4];
+  produce(w, 1);
+  produce(w, 2);
+  EXPECT_EQ(rhd_shm_wait(r, 1000), 1);
+  EXPECT_EQ(rhd_shm_read(r, samples, t_ns, seq, NULL, 4), 2);
+  EXPECT_EQ(seq[0], 1);
+  EXPECT_EQ(seq[1], 2);
+  EXPECT_EQ(t_ns[1], 2000);
+  EXPECT_EQ(samples[64 + 7], (7 << 8) | 2);
+  EXPECT_EQ(rhd_shm_read(r, samples, NULL, NULL, NULL, 4), 0);
+
+  // Reader 40 frames behind a 16-slot ring
+  for (uint32_t i = 3; i < 43; i++) {
+    produce(w, i);
+  }
+  EXPECT_EQ(rhd_shm_read(r, samples, NULL, seq, NULL, 4), 4);
+  EXPECT_EQ(seq[0], 27);
+  EXPECT_EQ(rhd_shm_lost(r), 24);
+
+  // Frame 32's slot being rewritten with frame 48
+  rhd_shm_read(r, samples, NULL, seq, NULL, 1);
+  for (uint32_t i = 43; i < 48; i++) {
+    produce(w, i);
+  }
+  rhd_shm_claim(w, NULL);
+  EXPECT_EQ(rhd_shm_read(r, samples, NULL, seq, NULL, 1), 1);
+  EXPECT_EQ(seq[0], 33);
+  EXPECT_EQ(rhd_shm_lost(r), 25);
+
+  rhd_shm_detach(r);
+  rhd_shm_destroy(w);
+  EXPECT_EQ(rhd_shm_attach(name.c_str()), nullptr);
+}
+
+TEST(RHDShm, CrossProcess) {
+  std::string name = shm_name();
+  const uint32_t n_frames = 5000;
+  rhd_shm_t *w = rhd_shm_create(name.c_str(), 64, 1024);
+  ASSERT_NE(w, nullptr);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Consumer process: every frame in order, no loss, no torn frame
+    rhd_shm_t *r = rhd_shm_attach(name.c_str());
+    uint16_t samples[64 * 64];
+    uint32_t seq[64];
+    uint32_t next = 0;
+    int bad = r == nullptr;
+    while (!bad && next < n_frames) {
+      if (!rhd_shm_wait(r, 2000000)) {
+        bad = 1;
+        break;
+      }
+      size_t n = rhd_shm_read(r, samples, NULL, seq, NULL, 64);
+      for (size_t i = 0; i < n; i++, next++) {
+        bad |= seq[i] != next;
+        bad |= (samples[64 * i + 5] & 0xFFFE) != 5 << 8;
+      }
+    }
+    bad |= rhd_shm_lost(r) != 0;
+    _exit(bad);
+  }
+
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, true, rhd_sim_rw);
+  rhd_pacer_t pacer;
+  rhd_pacer_init(&pacer, 20000, NULL);
+
+  // Give the consumer time to attach before the first frame
+  usleep(100000);
+  for (uint32_t i = 0; i < n_frames; i++) {
+    rhd_shm_sample(w, &dev, &pacer, rhd2164_sample_all_burst);
+  }
+
+  int status;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  rhd_shm_destroy(w);
+}
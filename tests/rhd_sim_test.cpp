@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_sim.h"
+}
+
+static uint16_t ramp(void *, int ch) { return 0x1000 + 0x100 * ch; }
+
+TEST(RHDSim, SanityCheck) {
+  for (int mode = 0; mode < 2; mode++) {
+    rhd_sim_t sim;
+    rhd_device_t dev;
+    rhd_sim_init(&sim, RHD_SIM_RHD2164, mode);
+    rhd_sim_bind(&sim);
+    EXPECT_EQ(rhd_init(&dev, mode, rhd_sim_rw), 0);
+    EXPECT_EQ(rhd_setup(&dev, 1000, 20, 500, true, 20), 0);
+    EXPECT_EQ(sim.n_calib, 1);
+    EXPECT_EQ(sim.regs[IND_AMP_PWR_7], 0xFF);
+    EXPECT_EQ(rhd_read_force(&dev, CHIP_ID), RHD_SIM_RHD2164);
+  }
+}
+
+TEST(RHDSim, SendBurst) {
+  for (int mode = 0; mode < 2; mode++) {
+    rhd_sim_t sim;
+    rhd_device_t dev;
+    rhd_sim_init(&sim, RHD_SIM_RHD2164, mode);
+    rhd_sim_bind(&sim);
+    rhd_init(&dev, mode, rhd_sim_rw);
+
+    uint16_t cmds[] = {(0xC0 | MISO_A_B) << 8, (0xC0 | NB_AMP) << 8,
+                       (0x80 | ADC_CFG) << 8 | 0x42, (0xC0 | INTAN_0) << 8,
+                       (0xC0 | CHIP_ID) << 8, (0xC0 | CHIP_ID) << 8};
+    uint16_t a[6], b[6];
+    EXPECT_EQ(rhd_send_burst(&dev, cmds, a, b, 6), mode ? 12 : 6);
+    EXPECT_EQ(a[2], 0x35);
+    EXPECT_EQ(a[3], 64);
+    EXPECT_EQ(a[4], 0xFF42);
+    EXPECT_EQ(a[5], 'I');
+    EXPECT_EQ(b[2], 0x3A);
+    EXPECT_EQ(b[3], 64);
+    EXPECT_EQ(sim.regs[ADC_CFG], 0x42);
+  }
+}
+
+TEST(RHDSim, SampleAllBurst) {
+  for (int mode = 0; mode < 2; mode++) {
+    rhd_sim_t sim;
+    rhd_device_t dev;
+    rhd_sim_init(&sim, RHD_SIM_RHD2164, mode);
+    rhd_sim_set_signal(&sim, ramp, NULL);
+    rhd_sim_bind(&sim);
+    rhd_init(&dev, mode, rhd_sim_rw);
+
+    uint16_t ref[64], burst[64];
+    rhd2164_sample_all(&dev, ref);
+    rhd2164_sample_all(&dev, ref);
+    uint32_t n_cmd = sim.n_cmd;
+    EXPECT_EQ(rhd2164_sample_all_burst(&dev, burst), mode ? 64 : 32);
+    EXPECT_EQ(sim.n_cmd - n_cmd, 32);
+
+    for (int ch = 1; ch < 30; ch++) {
+      EXPECT_EQ(burst[ch], ref[ch]);
+      EXPECT_EQ(burst[ch] & 0xFFFE, ramp(NULL, ch));
+    }
+    EXPECT_EQ(burst[0], ref[0]);
+    for (int ch = 32; ch < 62; ch++) {
+      EXPECT_EQ(burst[ch], ref[ch]);
+      EXPECT_EQ(burst[ch] & 0xFFFE, ramp(NULL, ch));
+    }
+  }
+}
+
+TEST(RHDSim, SingleMiso) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2132, false);
+  rhd_sim_set_signal(&sim, ramp, NULL);
+  rhd_sim_bind(&sim);
+  EXPECT_EQ(rhd_init(&dev, false, rhd_sim_rw), 0);
+  EXPECT_EQ(rhd_read_force(&dev, NB_AMP), 32);
+
+  uint16_t cmds[] = {5 << 8, 6 << 8, 7 << 8, 7 << 8};
+  uint16_t a[4];
+  EXPECT_EQ(rhd_send_burst(&dev, cmds, a, NULL, 4), 4);
+  EXPECT_EQ(a[2], ramp(NULL, 5));
+  EXPECT_EQ(a[3], ramp(NULL, 6));
+}
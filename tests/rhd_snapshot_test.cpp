@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_sim.h"
+#include "rhd_snapshot.h"
+}
+
+class RHDSnapshot : public ::testing::TestWithParam<bool> {};
+
+TEST_P(RHDSnapshot, WarmStart) {
+  bool mode = GetParam();
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, mode);
+  rhd_sim_bind(&sim);
+
+  // Cold start, no snapshot yet
+  rhd_snapshot_t snap;
+  bool warm = true;
+  EXPECT_EQ(rhd_warm_start(&dev, mode, rhd_sim_rw, 1000, 20, 500, true, 20,
+                           NULL, &warm),
+            0);
+  EXPECT_FALSE(warm);
+  EXPECT_EQ(rhd_snapshot_capture(&dev, 1000, 20, 500, true, 20, &snap),
+            mode ? 48 : 24);
+  EXPECT_EQ(snap.chip_id, RHD_SIM_RHD2164);
+  EXPECT_EQ(snap.n_regs, 22);
+  EXPECT_EQ(memcmp(snap.regs, sim.regs, 22), 0);
+
+  // Restart against the same chip: no writes, no calibration
+  uint32_t n_cmd = sim.n_cmd;
+  uint32_t n_write = sim.n_write;
+  uint32_t n_calib = sim.n_calib;
+  EXPECT_EQ(rhd_warm_start(&dev, mode, rhd_sim_rw, 1000, 20, 500, true, 20,
+                           &snap, &warm),
+            0);
+  EXPECT_TRUE(warm);
+  EXPECT_EQ(sim.n_write, n_write);
+  EXPECT_EQ(sim.n_calib, n_calib);
+  EXPECT_EQ(sim.n_cmd - n_cmd, 5 + 1 + 22 + 2);
+
+  // Chip was reconfigured behind our back
+  sim.regs[AMP_BW_SEL_4] ^= 1;
+  EXPECT_EQ(rhd_snapshot_verify(&dev, &snap), 1);
+  EXPECT_EQ(rhd_warm_start(&dev, mode, rhd_sim_rw, 1000, 20, 500, true, 20,
+                           &snap, &warm),
+            0);
+  EXPECT_FALSE(warm);
+  EXPECT_EQ(sim.n_calib, n_calib + 1);
+  EXPECT_EQ(rhd_snapshot_verify(&dev, &snap), 0);
+
+  // Other parameters
+  EXPECT_EQ(rhd_warm_start(&dev, mode, rhd_sim_rw, 1000, 20, 300, true, 20,
+                           &snap, &warm),
+            0);
+  EXPECT_FALSE(warm);
+  EXPECT_EQ(snap.fh, 300);
+  EXPECT_EQ(snap.regs[AMP_BW_SEL_0], sim.regs[AMP_BW_SEL_0]);
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, RHDSnapshot, ::testing::Bool());
+
+TEST(RHDSnapshotImage, Serialize) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2132, false);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, false, rhd_sim_rw);
+  rhd_setup(&dev, 20000, 1, 7500, false, 0);
+
+  rhd_snapshot_t snap, out;
+  rhd_snapshot_capture(&dev, 20000, 1, 7500, false, 0, &snap);
+  EXPECT_EQ(snap.n_regs, 18);
+
+  uint8_t buf[RHD_SNAPSHOT_SIZE];
+  EXPECT_EQ(rhd_snapshot_serialize(&snap, buf), RHD_SNAPSHOT_SIZE);
+  EXPECT_EQ(rhd_snapshot_deserialize(&out, buf, sizeof(buf)), 0);
+  EXPECT_EQ(out.double_bits, snap.double_bits);
+  EXPECT_EQ(out.chip_id, snap.chip_id);
+  EXPECT_EQ(out.n_regs, snap.n_regs);
+  EXPECT_EQ(memcmp(out.regs, snap.regs, snap.n_regs), 0);
+  EXPECT_EQ(out.fs, 20000);
+  EXPECT_EQ(out.fl, 1);
+  EXPECT_EQ(out.fh, 7500);
+  EXPECT_FALSE(out.dsp);
+  EXPECT_EQ(rhd_snapshot_verify(&dev, &out), 0);
+
+  EXPECT_EQ(rhd_snapshot_deserialize(&out, buf, sizeof(buf) - 1), -1);
+  buf[10] ^= 0x04;
+  EXPECT_EQ(rhd_snapshot_deserialize(&out, buf, sizeof(buf)), -1);
+}
+
+TEST(RHDSnapshotImage, File) {
+  rhd_snapshot_t snap = {true, 4, 22, {1, 2, 3}, 1000, 20, 500, true, 20};
+  rhd_snapshot_t out;
+  char path[] = "/tmp/rhd_snapshot_XXXXXX";
+  close(mkstemp(path));
+
+  EXPECT_EQ(rhd_snapshot_save(&snap, path), 0);
+  EXPECT_EQ(rhd_snapshot_load(&out, path), 0);
+  EXPECT_EQ(out.regs[2], 3);
+  EXPECT_EQ(out.fdsp, 20);
+  unlink(path);
+  EXPECT_EQ(rhd_snapshot_load(&out, path), -1);
+}
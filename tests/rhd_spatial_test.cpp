@@ -0,0 +1,228 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+extern "C" {
+#include "rhd_sim.h"
+#include "rhd_spatial.h"
+}
+
+class RHDSpatial : public ::testing::Test {
+protected:
+  void SetUp() override {
+    rhd_spatial_grid_init(&grid, 8, 8, 0, false);
+    uint32_t state = 7;
+    frames.resize(n_frames * 64);
+    for (auto &s : frames) {
+      state = state * 1103515245 + 12345;
+      s = (uint16_t)(state >> 16);
+    }
+  }
+
+  double x(size_t f, int ch, bool twos_comp = true) {
+    uint16_t v = frames[f * 64 + ch];
+    return twos_comp ? (int16_t)v : (int)v - 32768;
+  }
+
+  // Reference implementation, straight from the definitions
+  double ref(size_t f, int r, int c, rhd_spatial_op_t op, bool car,
+             uint64_t bad) {
+    auto good = [&](int rr, int cc) {
+      return rr >= 0 && cc >= 0 && rr < 8 && cc < 8 &&
+             !((bad >> (rr * 8 + cc)) & 1);
+    };
+    double mean = 0;
+    int n = 0;
+    for (int ch = 0; ch < 64; ch++) {
+      if (!((bad >> ch) & 1)) {
+        mean += x(f, ch);
+        n++;
+      }
+    }
+    mean = car ? mean / n : 0;
+    auto y = [&](int rr, int cc) { return x(f, rr * 8 + cc) - mean; };
+
+    if (!good(r, c)) {
+      return 0;
+    }
+    switch (op) {
+    case RHD_SPATIAL_MONO:
+      return y(r, c);
+    case RHD_SPATIAL_BIPOLAR_ROW:
+      return good(r, c + 1) ? y(r, c + 1) - y(r, c) : 0;
+    case RHD_SPATIAL_BIPOLAR_COL:
+      return good(r + 1, c) ? y(r + 1, c) - y(r, c) : 0;
+    case RHD_SPATIAL_LAPLACIAN: {
+      double sum = 0;
+      int n_nb = 0;
+      const int dr[4] = {-1, 1, 0, 0};
+      const int dc[4] = {0, 0, -1, 1};
+      for (int i = 0; i < 4; i++) {
+        if (good(r + dr[i], c + dc[i])) {
+          sum += y(r + dr[i], c + dc[i]);
+          n_nb++;
+        }
+      }
+      return n_nb * y(r, c) - sum;
+    }
+    }
+    return 0;
+  }
+
+  // Compares the filtered input with the reference on the fixture's frames,
+  // which hold the input's channels in grid order
+  void check(rhd_spatial_t &sf, bool car, uint64_t bad,
+             const uint16_t *input = NULL) {
+    std::vector<float> out(n_frames * sf.n_out);
+    rhd_spatial_apply(&sf, input != NULL ? input : frames.data(), 64,
+                      n_frames, out.data());
+    for (size_t f = 0; f < n_frames; f++) {
+      for (size_t o = 0; o < sf.n_out; o++) {
+        int r = sf.out_pos[o] / 8;
+        int c = sf.out_pos[o] % 8;
+        ASSERT_NEAR(out[f * sf.n_out + o], ref(f, r, c, sf.op, car, bad),
+                    0.05)
+            << "frame " << f << " r " << r << " c " << c;
+      }
+    }
+  }
+
+  rhd_spatial_grid_t grid;
+  // Not a multiple of the block
+  const size_t n_frames = 3 * RHD_SPATIAL_BLOCK + 5;
+  std::vector<uint16_t> frames;
+};
+
+TEST_F(RHDSpatial, Operators) {
+  const size_t n_out[4] = {64, 56, 56, 64};
+  for (int op = RHD_SPATIAL_MONO; op <= RHD_SPATIAL_LAPLACIAN; op++) {
+    for (bool car : {false, true}) {
+      SCOPED_TRACE(op * 2 + car);
+      rhd_spatial_t sf;
+      ASSERT_EQ(
+          rhd_spatial_init(&sf, &grid, (rhd_spatial_op_t)op, car, true), 0);
+      EXPECT_EQ(sf.n_out, n_out[op]);
+      check(sf, car, 0);
+    }
+  }
+}
+
+// Each channel of the simulated chip has its own level
+static uint16_t level(void *ctx, int ch) {
+  return ((const uint16_t *)ctx)[ch];
+}
+
+TEST_F(RHDSpatial, SimulatorOrder) {
+  // The grid puts each channel at its position in both sampling orders
+  uint16_t levels[64];
+  for (int ch = 0; ch < 64; ch++) {
+    levels[ch] = frames[ch] & 0xFFFE;
+  }
+  for (size_t f = 0; f < n_frames; f++) {
+    memcpy(&frames[f * 64], levels, sizeof(levels));
+  }
+
+  for (bool legacy : {false, true}) {
+    SCOPED_TRACE(legacy);
+    rhd_sim_t sim;
+    rhd_device_t dev;
+    rhd_sim_init(&sim, RHD_CHIP_RHD2164, false);
+    rhd_sim_set_signal(&sim, level, levels);
+    rhd_sim_bind(&sim);
+    ASSERT_EQ(rhd_init(&dev, false, rhd_sim_rw), 0);
+
+    // The first frame carries 2 results from the configuration
+    std::vector<uint16_t> input((n_frames + 1) * 64);
+    for (size_t f = 0; f <= n_frames; f++) {
+      if (legacy) {
+        rhd2164_sample_all(&dev, &input[f * 64]);
+      } else {
+        rhd_sample_all(&dev, &input[f * 64]);
+      }
+    }
+
+    rhd_spatial_grid_t g;
+    rhd_spatial_grid_init(&g, 8, 8, 0, legacy);
+    for (int op = RHD_SPATIAL_MONO; op <= RHD_SPATIAL_LAPLACIAN; op++) {
+      SCOPED_TRACE(op);
+      rhd_spatial_t sf;
+      ASSERT_EQ(rhd_spatial_init(&sf, &g, (rhd_spatial_op_t)op, true, true),
+                0);
+      check(sf, true, 0, &input[64]);
+    }
+  }
+}
+
+TEST_F(RHDSpatial, BadChannels) {
+  const uint64_t bad = (1ull << 0) | (1ull << 9) | (1ull << 10) |
+                       (1ull << 27) | (1ull << 63);
+  for (int op = RHD_SPATIAL_MONO; op <= RHD_SPATIAL_LAPLACIAN; op++) {
+    SCOPED_TRACE(op);
+    rhd_spatial_t sf;
+    ASSERT_EQ(rhd_spatial_init(&sf, &grid, (rhd_spatial_op_t)op, true, true),
+              0);
+    for (int ch = 0; ch < 64; ch++) {
+      if ((bad >> ch) & 1) {
+        rhd_spatial_set_bad(&sf, ch, true);
+      }
+    }
+    check(sf, true, bad);
+
+    // Back to the compiled state of a fresh filter
+    for (int ch = 0; ch < 64; ch++) {
+      rhd_spatial_set_bad(&sf, ch, false);
+    }
+    rhd_spatial_t fresh;
+    rhd_spatial_init(&fresh, &grid, (rhd_spatial_op_t)op, true, true);
+    EXPECT_EQ(memcmp(sf.tap_w, fresh.tap_w, sizeof(sf.tap_w)), 0);
+    EXPECT_EQ(memcmp(sf.mean_w, fresh.mean_w, sizeof(sf.mean_w)), 0);
+    EXPECT_EQ(sf.valid, fresh.valid);
+  }
+
+  // Laplacian at a corner with both neighbours bad has no value
+  rhd_spatial_t sf;
+  rhd_spatial_init(&sf, &grid, RHD_SPATIAL_LAPLACIAN, false, true);
+  rhd_spatial_set_bad(&sf, 1, true);
+  EXPECT_TRUE(sf.valid & 1);
+  rhd_spatial_set_bad(&sf, 8, true);
+  EXPECT_FALSE(sf.valid & 1);
+
+  // Channels outside the filter are rejected
+  rhd_spatial_grid_t half;
+  rhd_spatial_grid_init(&half, 4, 8, 0, false);
+  rhd_spatial_init(&sf, &half, RHD_SPATIAL_MONO, true, true);
+  EXPECT_EQ(rhd_spatial_set_bad(&sf, 31, true), 0);
+  EXPECT_EQ(rhd_spatial_set_bad(&sf, 32, true), -1);
+  EXPECT_EQ(rhd_spatial_set_bad(&sf, 64, true), -1);
+  EXPECT_EQ(rhd_spatial_set_bad(&sf, -1, true), -1);
+  EXPECT_EQ(sf.bad, 1ull << 31);
+}
+
+TEST_F(RHDSpatial, SecondGridOffsetBinary) {
+  // 4x8 grid on the second half of the frame
+  rhd_spatial_grid_t g;
+  rhd_spatial_grid_init(&g, 4, 8, 32, false);
+  rhd_spatial_t sf;
+  ASSERT_EQ(rhd_spatial_init(&sf, &g, RHD_SPATIAL_MONO, true, false), 0);
+  EXPECT_EQ(sf.n_in, 64);
+  std::vector<float> out(n_frames * 32);
+  rhd_spatial_apply(&sf, frames.data(), 64, n_frames, out.data());
+  for (size_t f = 0; f < n_frames; f++) {
+    double mean = 0;
+    for (int ch = 32; ch < 64; ch++) {
+      mean += x(f, ch, false) / 32;
+    }
+    for (int o = 0; o < 32; o++) {
+      ASSERT_NEAR(out[f * 32 + o], x(f, 32 + o, false) - mean, 0.05);
+    }
+  }
+}
+
+TEST_F(RHDSpatial, Invalid) {
+  rhd_spatial_t sf;
+  rhd_spatial_grid_t g;
+  rhd_spatial_grid_init(&g, 9, 8, 0, false);
+  EXPECT_EQ(rhd_spatial_init(&sf, &g, RHD_SPATIAL_MONO, false, true), -1);
+  rhd_spatial_grid_init(&g, 8, 8, 1, false);
+  EXPECT_EQ(rhd_spatial_init(&sf, &g, RHD_SPATIAL_MONO, false, true), -1);
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_frame.h"
+#include "rhd_sim.h"
+#include "rhd_sync.h"
+}
+
+static uint16_t frame_no = 0;
+
+// Channel in the high byte, frame number in the low byte
+static uint16_t tagged(void *, int ch) { return (ch << 8) | frame_no; }
+
+class RHDSync : public ::testing::TestWithParam<bool> {
+protected:
+  void SetUp() override {
+    mode = GetParam();
+    rhd_sim_init(&sim, RHD_SIM_RHD2164, mode);
+    rhd_sim_set_signal(&sim, tagged, NULL);
+    rhd_sim_bind(&sim);
+    rhd_init(&dev, mode, rhd_sim_rw);
+    rhd_setup(&dev, 1000, 20, 500, true, 20);
+    rhd_sync_init(&sync, 4, true);
+    frame_no = 0;
+  }
+
+  // Every channel of the frame must come from the expected conversion
+  bool frame_ok(const uint16_t *buf) {
+    for (int ch = 2; ch < 30; ch++) {
+      if ((buf[ch] & 0xFF00) != ch << 8 ||
+          (buf[ch + 32] & 0xFF00) != (ch + 32) << 8) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool mode;
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sync_t sync;
+};
+
+TEST_P(RHDSync, ProbeFrameMatchesSampleAll) {
+  uint16_t ref[64], buf[64];
+  rhd2164_sample_all(&dev, ref);
+  rhd2164_sample_all(&dev, ref);
+  for (int i = 0; i < 8; i++) {
+    EXPECT_GE(rhd_sync_sample_all(&dev, &sync, buf), 0);
+    EXPECT_EQ(memcmp(buf, ref, sizeof(buf)), 0) << "frame " << i;
+  }
+  EXPECT_EQ(sync.n_probes, 2);
+  EXPECT_EQ(sync.n_probe_fail, 0);
+}
+
+TEST_P(RHDSync, SlipRecovery) {
+  uint16_t buf[64];
+  for (int i = 0; i < 6; i++) {
+    rhd_sync_sample_all(&dev, &sync, buf);
+  }
+  uint32_t n_write = sim.n_write;
+  uint32_t n_calib = sim.n_calib;
+
+  rhd_sim_slip(&sim);
+  int n_lost = 0;
+  int n_bad = 0;
+  int first_bad = -1;
+  int i_lost = -1;
+  for (int i = 0; i < 20; i++) {
+    frame_no = i;
+    int ret = rhd_sync_sample_all(&dev, &sync, buf);
+    if (ret == RHD_SYNC_LOST) {
+      n_lost++;
+      i_lost = i;
+    } else if (!frame_ok(buf)) {
+      n_bad++;
+      first_bad = first_bad < 0 ? i : first_bad;
+    }
+  }
+
+  if (mode) {
+    // DDR pairing stays shifted until the next probe
+    EXPECT_EQ(sync.n_probe_fail, 1);
+    EXPECT_EQ(sync.n_resync, 1);
+    EXPECT_EQ(n_lost, 1);
+    EXPECT_LE(n_bad, 2);
+    // Every shifted frame delivered is within the suspect window
+    ASSERT_GE(i_lost, 0);
+    EXPECT_LE(sync.n_suspect, 3);
+    EXPECT_EQ(sync.n_suspect_total, sync.n_suspect);
+    if (n_bad > 0) {
+      EXPECT_GE(first_bad, i_lost - (int)sync.n_suspect);
+      EXPECT_LT(first_bad, i_lost);
+    }
+  } else {
+    // A missed command only disturbs the frame it belongs to
+    EXPECT_EQ(sync.n_probe_fail, 0);
+    EXPECT_LE(n_bad, 1);
+  }
+  EXPECT_EQ(sync.n_resync_fail, 0);
+  // Recovered without reconfiguring the chip
+  EXPECT_EQ(sim.n_write, n_write);
+  EXPECT_EQ(sim.n_calib, n_calib);
+
+  for (int i = 0; i < 8; i++) {
+    EXPECT_GE(rhd_sync_sample_all(&dev, &sync, buf), 0);
+    EXPECT_TRUE(frame_ok(buf));
+  }
+}
+
+TEST_P(RHDSync, UnverifiedWindow) {
+  uint16_t buf[64];
+  // Probe period 4: 3 regular frames, then a probe
+  for (int i = 0; i < 3; i++) {
+    rhd_sync_sample_all(&dev, &sync, buf);
+    EXPECT_EQ(sync.n_unverified, i + 1);
+  }
+  rhd_sync_sample_all(&dev, &sync, buf);
+  EXPECT_EQ(sync.n_probes, 1);
+  EXPECT_EQ(sync.n_unverified, 0);
+  EXPECT_EQ(sync.n_suspect, 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, RHDSync, ::testing::Bool());
+
+TEST(RHDSyncCheck, Frame) {
+  rhd_sync_t sync;
+  rhd_sync_init(&sync, 0, true);
+  uint16_t buf[64];
+  for (int ch = 0; ch < 64; ch++) {
+    buf[ch] = (ch << 4) | 1;
+  }
+  buf[0] &= 0xFFFE;
+  EXPECT_EQ(rhd_sync_check_frame(&sync, buf), 0);
+
+  // Stream shifted by one sample
+  uint16_t shifted[64];
+  memcpy(shifted, buf + 1, 63 * sizeof(uint16_t));
+  shifted[63] = buf[0];
+  EXPECT_EQ(rhd_sync_check_frame(&sync, shifted), RHD_SYNC_ALIGN);
+
+  for (int ch = 1; ch < 20; ch++) {
+    buf[ch] = ch % 2 ? 0x7FFF : 0x8001;
+  }
+  EXPECT_EQ(rhd_sync_check_frame(&sync, buf), RHD_SYNC_RANGE);
+  sync.twos_comp = false;
+  EXPECT_EQ(rhd_sync_check_frame(&sync, buf), 0);
+}
+
+TEST(RHDSyncCheck, ResyncDeadChip) {
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, true);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, true, rhd_sim_rw);
+  memset(&sim.regs[INTAN_0], 0, 5);
+  EXPECT_EQ(rhd_sync_resync(&dev), -1);
+}
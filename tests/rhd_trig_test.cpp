@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "rhd_sim.h"
+#include "rhd_trig.h"
+}
+
+#define FRAME_LEN 66
+#define CAPACITY 64
+
+class RHDTrig : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_EQ(rhd_trig_init(&trig, frames, hdrs, FRAME_LEN, CAPACITY, 8, 16,
+                            true),
+              0);
+  }
+
+  // Frame `n`: sample 0 holds n, sample 64 a ramp, sample 65 digital inputs
+  int push(uint16_t ramp = 0, uint16_t dig = 0) {
+    rhd_frame_hdr_t *hdr;
+    uint16_t *buf = rhd_trig_claim(&trig, &hdr);
+    if (buf == NULL) {
+      return RHD_TRIG_FULL;
+    }
+    buf[0] = n;
+    buf[64] = ramp;
+    buf[65] = dig;
+    hdr->seq = n++;
+    return rhd_trig_publish(&trig);
+  }
+
+  void check_window(const rhd_trig_window_t *w, uint32_t trigger,
+                    uint32_t len, int source) {
+    ASSERT_NE(w, nullptr);
+    EXPECT_EQ(w->trigger, trigger);
+    EXPECT_EQ(w->len, len);
+    EXPECT_EQ(w->source, source);
+    for (uint32_t i = 0; i < w->len; i++) {
+      const rhd_frame_hdr_t *hdr;
+      const uint16_t *f = rhd_trig_frame(&trig, w, i, &hdr);
+      EXPECT_EQ(f[0], w->start + i);
+      EXPECT_EQ(hdr->seq, w->start + i);
+    }
+    EXPECT_EQ(w->start + (w->len - 1 - 16), trigger);
+  }
+
+  uint16_t frames[CAPACITY * FRAME_LEN];
+  rhd_frame_hdr_t hdrs[CAPACITY];
+  rhd_trig_t trig;
+  uint16_t n = 0;
+};
+
+TEST_F(RHDTrig, Software) {
+  for (int i = 0; i < 100; i++) {
+    push();
+  }
+  EXPECT_EQ(rhd_trig_get(&trig), nullptr);
+  rhd_trig_fire(&trig);
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(push(), 0);
+  }
+  EXPECT_EQ(rhd_trig_get(&trig), nullptr);
+  EXPECT_EQ(push(), 1);
+  check_window(rhd_trig_get(&trig), 100, 25, RHD_TRIG_SOFTWARE);
+  rhd_trig_release(&trig);
+  EXPECT_EQ(rhd_trig_get(&trig), nullptr);
+}
+
+TEST_F(RHDTrig, NoRetrigger) {
+  for (int i = 0; i < 10; i++) {
+    push();
+  }
+  rhd_trig_fire(&trig);
+  push();
+  // Two more triggers while the window is filled
+  for (int i = 0; i < 16; i++) {
+    if (i == 3 || i == 15) {
+      rhd_trig_fire(&trig);
+    }
+    push();
+  }
+  check_window(rhd_trig_get(&trig), 10, 25, RHD_TRIG_SOFTWARE);
+  EXPECT_EQ(trig.n_in_window, 2);
+  EXPECT_EQ(trig.n_missed, 0);
+  rhd_trig_release(&trig);
+
+  // The next trigger after the window opens a new one
+  rhd_trig_fire(&trig);
+  push();
+  EXPECT_EQ(trig.cur.trigger, 27);
+  EXPECT_EQ(trig.n_in_window, 2);
+}
+
+TEST_F(RHDTrig, ShortHistory) {
+  push();
+  push();
+  rhd_trig_fire(&trig);
+  for (int i = 0; i < 17; i++) {
+    push();
+  }
+  const rhd_trig_window_t *w = rhd_trig_get(&trig);
+  check_window(w, 2, 19, RHD_TRIG_SOFTWARE);
+  EXPECT_EQ(w->start, 0);
+}
+
+TEST_F(RHDTrig, Conditions) {
+  rhd_trig_cond_t rising = {RHD_TRIG_RISING, 64, 100, 0};
+  rhd_trig_cond_t falling = {RHD_TRIG_FALLING, 64, -100, 0};
+  rhd_trig_cond_t dig = {RHD_TRIG_DIGITAL, 65, 0, 0x4};
+  EXPECT_EQ(rhd_trig_add(&trig, &rising), 0);
+  EXPECT_EQ(rhd_trig_add(&trig, &falling), 1);
+  EXPECT_EQ(rhd_trig_add(&trig, &dig), 2);
+
+  for (int i = 0; i < 20; i++) {
+    push(50, 0x3);
+  }
+  // Level reached while the digital input stays high: a single rising edge
+  push(100, 0x4);
+  for (int i = 0; i < 30; i++) {
+    push(200, 0x4);
+  }
+  check_window(rhd_trig_get(&trig), 20, 25, 0);
+  rhd_trig_release(&trig);
+  EXPECT_EQ(rhd_trig_get(&trig), nullptr);
+
+  // Falling edge, two's complement
+  push((uint16_t)-150, 0x4);
+  for (int i = 0; i < 16; i++) {
+    push((uint16_t)-150, 0);
+  }
+  check_window(rhd_trig_get(&trig), 51, 25, 1);
+  rhd_trig_release(&trig);
+
+  // Digital rising edge
+  push(0, 0x6);
+  for (int i = 0; i < 16; i++) {
+    push(0, 0x6);
+  }
+  check_window(rhd_trig_get(&trig), 68, 25, 2);
+  rhd_trig_release(&trig);
+}
+
+TEST_F(RHDTrig, HeldWindowsBlockTheProducer) {
+  for (int i = 0; i < 10; i++) {
+    push();
+  }
+  rhd_trig_fire(&trig);
+  int pushed = 0;
+  while (push() != RHD_TRIG_FULL) {
+    pushed++;
+  }
+  // The window starts at frame 2 and must not be overwritten
+  const rhd_trig_window_t *w = rhd_trig_get(&trig);
+  check_window(w, 10, 25, RHD_TRIG_SOFTWARE);
+  EXPECT_EQ(n, 2 + CAPACITY);
+  rhd_trig_release(&trig);
+  EXPECT_EQ(push(), 0);
+}
+
+TEST_F(RHDTrig, MissedWhenQueueFull) {
+  // Single frame windows
+  ASSERT_EQ(rhd_trig_init(&trig, frames, hdrs, FRAME_LEN, CAPACITY, 0, 0,
+                          true),
+            0);
+  for (int t = 0; t < RHD_TRIG_MAX_WINDOWS + 1; t++) {
+    rhd_trig_fire(&trig);
+    EXPECT_EQ(push(), t < RHD_TRIG_MAX_WINDOWS);
+  }
+  EXPECT_EQ(trig.n_missed, 1);
+  for (int t = 0; t < RHD_TRIG_MAX_WINDOWS; t++) {
+    const rhd_trig_window_t *w = rhd_trig_get(&trig);
+    ASSERT_NE(w, nullptr);
+    EXPECT_EQ(w->trigger, t);
+    EXPECT_EQ(w->len, 1);
+    rhd_trig_release(&trig);
+  }
+  EXPECT_EQ(rhd_trig_get(&trig), nullptr);
+}
+
+TEST_F(RHDTrig, Invalid) {
+  rhd_trig_t t;
+  EXPECT_EQ(rhd_trig_init(&t, frames, hdrs, FRAME_LEN, 48, 8, 16, true), -1);
+  EXPECT_EQ(rhd_trig_init(&t, frames, hdrs, FRAME_LEN, 16, 8, 8, true), -1);
+  rhd_trig_cond_t c = {RHD_TRIG_DIGITAL, FRAME_LEN, 0, 1};
+  EXPECT_EQ(rhd_trig_add(&trig, &c), -1);
+}
+
+static uint16_t level = 0;
+static uint16_t level_signal(void *, int ch) { return ch == 3 ? level : 0; }
+
+TEST(RHDTrigSim, Sample) {
+  static uint16_t frames[32 * 64];
+  static rhd_frame_hdr_t hdrs[32];
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, false);
+  rhd_sim_set_signal(&sim, level_signal, NULL);
+  rhd_sim_bind(&sim);
+  rhd_init(&dev, false, rhd_sim_rw);
+  rhd_pacer_t pacer;
+  rhd_pacer_init(&pacer, 0, NULL);
+
+  rhd_trig_t trig;
+  ASSERT_EQ(rhd_trig_init(&trig, frames, hdrs, 64, 32, 4, 4, true), 0);
+  rhd_trig_cond_t c = {RHD_TRIG_RISING, 3, 1000, 0};
+  rhd_trig_add(&trig, &c);
+  for (int i = 0; i < 20; i++) {
+    level = i >= 10 ? 2000 : 0;
+    EXPECT_GE(rhd_trig_sample(&trig, &dev, &pacer, rhd2164_sample_all), 0);
+  }
+  const rhd_trig_window_t *w = rhd_trig_get(&trig);
+  ASSERT_NE(w, nullptr);
+  EXPECT_EQ(w->len, 9);
+  const uint16_t *f = rhd_trig_frame(&trig, w, 4, NULL);
+  EXPECT_EQ(f[3] & 0xFFFE, 2000);
+  EXPECT_EQ(rhd_trig_frame(&trig, w, 3, NULL)[3] & 0xFFFE, 0);
+}
@@ -0,0 +1,79 @@
+#include <complex>
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "rhd.h"
+#include "rhd_sim.h"
+#include "rhd_zcheck.h"
+}
+
+static uint16_t zero(void *, int) { return 0; }
+
+/**
+ * Impedance of the simulated electrode, as sampled by the DAC update clock.
+ */
+static std::complex<double> sim_z(double rs, double rp, double cp, double f,
+                                  double fs) {
+  double a = rp * cp > 0 ? std::exp(-1 / (fs * rp * cp)) : 0;
+  std::complex<double> zi = std::polar(1.0, -2 * M_PI * f / fs);
+  return rs + (1 - a) * rp / (1.0 - a * zi);
+}
+
+class RHDZcheck : public ::testing::TestWithParam<bool> {};
+
+TEST_P(RHDZcheck, Electrodes) {
+  bool mode = GetParam();
+  rhd_sim_t sim;
+  rhd_device_t dev;
+  rhd_sim_init(&sim, RHD_SIM_RHD2164, mode);
+  rhd_sim_set_signal(&sim, zero, NULL);
+  rhd_sim_bind(&sim);
+  ASSERT_EQ(rhd_init(&dev, mode, rhd_sim_rw), 0);
+  ASSERT_EQ(rhd_setup(&dev, 1000, 20, 500, true, 20), 0);
+
+  rhd_zcheck_cfg_t cfg;
+  rhd_zcheck_default_cfg(&cfg);
+  cfg.scale = RHD_ZCHECK_10PF;
+
+  struct {
+    int ch;
+    double rs, rp, cp;
+  } el[] = {
+      {3, 10e3, 0, 0},
+      {40, 5e3, 50e3, 10e-9},
+      {63, 2e3, 200e3, 1e-9},
+  };
+  for (auto &e : el) {
+    rhd_sim_set_electrode(&sim, e.ch, e.rs, e.rp, e.cp, cfg.fs);
+  }
+
+  rhd_zcheck_result_t res[64] = {};
+  uint64_t mask = (1ULL << 3) | (1ULL << 40) | (1ULL << 63) | (1ULL << 7);
+  uint32_t n_convert = sim.n_convert;
+  EXPECT_EQ(rhd_zcheck_run(&dev, &cfg, mask, res), 4);
+  EXPECT_EQ(sim.n_convert - n_convert,
+            4 * (cfg.settle_periods + cfg.periods) * 30);
+
+  for (auto &e : el) {
+    std::complex<double> z = sim_z(e.rs, e.rp, e.cp, cfg.freq, cfg.fs);
+    EXPECT_NEAR(res[e.ch].mag, std::abs(z), 0.01 * std::abs(z)) << e.ch;
+    EXPECT_NEAR(res[e.ch].phase, std::arg(z) * 180 / M_PI, 1.0) << e.ch;
+  }
+  EXPECT_NEAR(res[3].phase, 0, 0.5);
+  EXPECT_LT(res[7].mag, 100);
+
+  // Impedance check disabled again
+  EXPECT_EQ(sim.regs[IMP_CHK_CTRL], 0);
+  EXPECT_EQ(sim.regs[IMP_CHK_DAC], 0);
+  EXPECT_EQ(sim.regs[IMP_CHK_AMP_SEL], 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, RHDZcheck, ::testing::Bool());
+
+TEST(RHDZcheckCfg, Invalid) {
+  rhd_device_t dev;
+  rhd_zcheck_cfg_t cfg;
+  rhd_zcheck_default_cfg(&cfg);
+  cfg.freq = 20000;
+  EXPECT_LT(rhd_zcheck_run(&dev, &cfg, 1, NULL), 0);
+}